@@ -0,0 +1,258 @@
+#include "blit.h"
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BLIT_X86 1
+#include <immintrin.h>
+#else
+#define BLIT_X86 0
+#endif
+
+static const char *format_names[BLIT_FORMAT_COUNT] = { "rgb332", "rgb565", "argb8888" };
+static const char *impl_names[BLIT_IMPL_COUNT] = { "auto", "table", "sse2", "avx2" };
+
+const char *
+blit_format_name ( enum blit_format format ) {
+    return format_names[format];
+}
+
+const char *
+blit_impl_name ( enum blit_impl impl ) {
+    return impl_names[impl];
+}
+
+int
+blit_format_find ( const char *name ) {
+    for ( int i = 0; i < BLIT_FORMAT_COUNT; i++ ) {
+        if ( strcmp( format_names[i], name ) == 0 ) { return i; }
+    }
+    return -1;
+}
+
+int
+blit_impl_find ( const char *name ) {
+    for ( int i = 0; i < BLIT_IMPL_COUNT; i++ ) {
+        if ( strcmp( impl_names[i], name ) == 0 ) { return i; }
+    }
+    return -1;
+}
+
+/* convert 0xRRGGBB to the target format */
+static uint32_t
+convert ( enum blit_format format, uint32_t rgb ) {
+    uint32_t r = (rgb >> 16) & 0xFF, g = (rgb >> 8) & 0xFF, b = rgb & 0xFF;
+
+    switch ( format ) {
+        case BLIT_RGB332:   return (r & 0xE0) | ((g >> 3) & 0x1C) | (b >> 6);
+        case BLIT_RGB565:   return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+        case BLIT_ARGB8888: return 0xFF000000 | rgb;
+        default:            return 0;
+    }
+}
+
+static void
+put ( u8 *dst, int bpp, uint32_t px ) {
+    switch ( bpp ) {
+        case 1: *dst = px; break;
+        case 2: { uint16_t p = px; memcpy( dst, &p, 2 ); break; }
+        case 4: memcpy( dst, &px, 4 ); break;
+    }
+}
+
+/* ---- table ---- */
+
+/* span is a constant in each expansion so the copies compile to plain moves */
+#define TABLE_EXPAND(span) \
+    for ( int i = 0; i < n; i++, dst += (span) ) { \
+        memcpy( dst, b->table + src[i] * (span), (span) ); \
+    }
+
+static void
+expand_table ( const struct blitter *b, const u8 *src, int n, u8 *dst ) {
+    switch ( b->bpp ) {
+        case 1: TABLE_EXPAND(8);  break;
+        case 2: TABLE_EXPAND(16); break;
+        case 4: TABLE_EXPAND(32); break;
+    }
+}
+
+#undef TABLE_EXPAND
+
+#if BLIT_X86
+
+/* ---- SSE2 ---- */
+
+/* 16 pixels from two bytes */
+__attribute__((target("sse2"))) static void
+expand_sse2_332 ( const struct blitter *b, const u8 *src, int n, u8 *dst ) {
+    const __m128i bits = _mm_set_epi8( 1, 2, 4, 8, 16, 32, 64, (char) 128,
+                                       1, 2, 4, 8, 16, 32, 64, (char) 128 );
+    const __m128i fg = _mm_set1_epi8( (char) b->fg ), bg = _mm_set1_epi8( (char) b->bg );
+    int i = 0;
+
+    for ( ; i + 2 <= n; i += 2, dst += 16 ) {
+        /* spread byte 0 over the low 8 lanes and byte 1 over the high 8 */
+        __m128i v = _mm_cvtsi32_si128( src[i] | (src[i + 1] << 8) );
+        v = _mm_unpacklo_epi8( v, v );
+        v = _mm_unpacklo_epi16( v, v );
+        v = _mm_unpacklo_epi32( v, v );
+        __m128i m = _mm_cmpeq_epi8( _mm_and_si128( v, bits ), bits );
+        __m128i px = _mm_or_si128( _mm_and_si128( m, fg ), _mm_andnot_si128( m, bg ) );
+        _mm_storeu_si128( (__m128i *) dst, px );
+    }
+    expand_table( b, src + i, n - i, dst );
+}
+
+/* 8 pixels from one byte */
+__attribute__((target("sse2"))) static void
+expand_sse2_565 ( const struct blitter *b, const u8 *src, int n, u8 *dst ) {
+    const __m128i bits = _mm_set_epi16( 1, 2, 4, 8, 16, 32, 64, 128 );
+    const __m128i fg = _mm_set1_epi16( (short) b->fg ), bg = _mm_set1_epi16( (short) b->bg );
+
+    for ( int i = 0; i < n; i++, dst += 16 ) {
+        __m128i v = _mm_set1_epi16( src[i] );
+        __m128i m = _mm_cmpeq_epi16( _mm_and_si128( v, bits ), bits );
+        __m128i px = _mm_or_si128( _mm_and_si128( m, fg ), _mm_andnot_si128( m, bg ) );
+        _mm_storeu_si128( (__m128i *) dst, px );
+    }
+}
+
+/* 8 pixels from one byte in two halves */
+__attribute__((target("sse2"))) static void
+expand_sse2_8888 ( const struct blitter *b, const u8 *src, int n, u8 *dst ) {
+    const __m128i hi = _mm_set_epi32( 16, 32, 64, 128 ), lo = _mm_set_epi32( 1, 2, 4, 8 );
+    const __m128i fg = _mm_set1_epi32( b->fg ), bg = _mm_set1_epi32( b->bg );
+
+    for ( int i = 0; i < n; i++, dst += 32 ) {
+        __m128i v = _mm_set1_epi32( src[i] );
+        __m128i m0 = _mm_cmpeq_epi32( _mm_and_si128( v, hi ), hi );
+        __m128i m1 = _mm_cmpeq_epi32( _mm_and_si128( v, lo ), lo );
+        _mm_storeu_si128( (__m128i *) dst,
+            _mm_or_si128( _mm_and_si128( m0, fg ), _mm_andnot_si128( m0, bg ) ) );
+        _mm_storeu_si128( (__m128i *) (dst + 16),
+            _mm_or_si128( _mm_and_si128( m1, fg ), _mm_andnot_si128( m1, bg ) ) );
+    }
+}
+
+/* ---- AVX2 ---- */
+
+/* 32 pixels from four bytes */
+__attribute__((target("avx2"))) static void
+expand_avx2_332 ( const struct blitter *b, const u8 *src, int n, u8 *dst ) {
+    const __m256i bits = _mm256_set1_epi64x( 0x0102040810204080LL );
+    const __m256i spread = _mm256_setr_epi8(
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+        2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3 );
+    const __m256i fg = _mm256_set1_epi8( (char) b->fg ), bg = _mm256_set1_epi8( (char) b->bg );
+    int i = 0;
+
+    for ( ; i + 4 <= n; i += 4, dst += 32 ) {
+        int32_t word;
+        memcpy( &word, src + i, 4 );
+        __m256i v = _mm256_shuffle_epi8( _mm256_set1_epi32( word ), spread );
+        __m256i m = _mm256_cmpeq_epi8( _mm256_and_si256( v, bits ), bits );
+        _mm256_storeu_si256( (__m256i *) dst, _mm256_blendv_epi8( bg, fg, m ) );
+    }
+    expand_table( b, src + i, n - i, dst );
+}
+
+/* 16 pixels from two bytes */
+__attribute__((target("avx2"))) static void
+expand_avx2_565 ( const struct blitter *b, const u8 *src, int n, u8 *dst ) {
+    const __m256i bits = _mm256_setr_epi16( 128, 64, 32, 16, 8, 4, 2, 1,
+                                            128, 64, 32, 16, 8, 4, 2, 1 );
+    const __m256i fg = _mm256_set1_epi16( (short) b->fg ), bg = _mm256_set1_epi16( (short) b->bg );
+    int i = 0;
+
+    for ( ; i + 2 <= n; i += 2, dst += 32 ) {
+        __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256( _mm_set1_epi16( src[i] ) ),
+            _mm_set1_epi16( src[i + 1] ), 1 );
+        __m256i m = _mm256_cmpeq_epi16( _mm256_and_si256( v, bits ), bits );
+        _mm256_storeu_si256( (__m256i *) dst, _mm256_blendv_epi8( bg, fg, m ) );
+    }
+    expand_table( b, src + i, n - i, dst );
+}
+
+/* 8 pixels from one byte. each pixel's bit is shifted up into the sign bit
+   which blendv_ps selects on directly */
+__attribute__((target("avx2"))) static void
+expand_avx2_8888 ( const struct blitter *b, const u8 *src, int n, u8 *dst ) {
+    const __m256i shifts = _mm256_setr_epi32( 24, 25, 26, 27, 28, 29, 30, 31 );
+    const __m256 fg = _mm256_castsi256_ps( _mm256_set1_epi32( b->fg ) );
+    const __m256 bg = _mm256_castsi256_ps( _mm256_set1_epi32( b->bg ) );
+
+    for ( int i = 0; i < n; i++, dst += 32 ) {
+        __m256i v = _mm256_sllv_epi32( _mm256_set1_epi32( src[i] ), shifts );
+        __m256 px = _mm256_blendv_ps( bg, fg, _mm256_castsi256_ps( v ) );
+        _mm256_storeu_ps( (float *) dst, px );
+    }
+}
+
+#endif
+
+int
+blit_init ( struct blitter *b, enum blit_format format,
+            uint32_t fg, uint32_t bg, enum blit_impl impl ) {
+    memset( b, 0, sizeof(struct blitter) );
+
+    b->format = format;
+    b->bpp = (format == BLIT_RGB332)? 1 : (format == BLIT_RGB565)? 2 : 4;
+    b->fg = convert( format, fg );
+    b->bg = convert( format, bg );
+
+    /* the table also finishes off odd tails for the vector versions */
+    for ( int v = 0; v < 256; v++ ) {
+        for ( int p = 0; p < 8; p++ ) {
+            put( b->table + (v * 8 + p) * b->bpp, b->bpp, (v & (0x80 >> p))? b->fg : b->bg );
+        }
+    }
+
+#if BLIT_X86
+    /* the wider formats are bound by stores and the table of 16 or 32 byte
+       rows stays in L1, so only rgb332 gains from the vector versions */
+    if ( impl == BLIT_IMPL_AUTO && format == BLIT_RGB332 ) {
+        impl = __builtin_cpu_supports( "avx2" )? BLIT_IMPL_AVX2 :
+               __builtin_cpu_supports( "sse2" )? BLIT_IMPL_SSE2 : BLIT_IMPL_TABLE;
+    }
+    if ( impl == BLIT_IMPL_AUTO ) { impl = BLIT_IMPL_TABLE; }
+    if ( impl == BLIT_IMPL_AVX2 && !__builtin_cpu_supports( "avx2" ) ) { return 0; }
+    if ( impl == BLIT_IMPL_SSE2 && !__builtin_cpu_supports( "sse2" ) ) { return 0; }
+#else
+    if ( impl == BLIT_IMPL_AUTO ) { impl = BLIT_IMPL_TABLE; }
+    if ( impl != BLIT_IMPL_TABLE ) { return 0; }
+#endif
+
+    b->name = impl_names[impl];
+    b->expand = expand_table;
+
+#if BLIT_X86
+    if ( impl == BLIT_IMPL_SSE2 ) {
+        b->expand = (format == BLIT_RGB332)? expand_sse2_332 :
+                    (format == BLIT_RGB565)? expand_sse2_565 : expand_sse2_8888;
+    }
+    if ( impl == BLIT_IMPL_AVX2 ) {
+        b->expand = (format == BLIT_RGB332)? expand_avx2_332 :
+                    (format == BLIT_RGB565)? expand_avx2_565 : expand_avx2_8888;
+    }
+#endif
+
+    return 1;
+}
+
+void
+blit_rows ( const struct blitter *b, const u8 *packed, int y0, int y1,
+            void *pixels, int pitch ) {
+    u8 *dst = (u8 *) pixels + y0 * pitch;
+    const u8 *src = packed + y0 * CHIP8_DISPLAY_BUF_WIDTH;
+
+    /* rows are contiguous when there is no padding, do them in one go */
+    if ( pitch == CHIP8_DISPLAY_WIDTH * b->bpp ) {
+        b->expand( b, src, (y1 - y0) * CHIP8_DISPLAY_BUF_WIDTH, dst );
+        return;
+    }
+
+    for ( int y = y0; y < y1; y++, dst += pitch, src += CHIP8_DISPLAY_BUF_WIDTH ) {
+        b->expand( b, src, CHIP8_DISPLAY_BUF_WIDTH, dst );
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef _BLIT_H_
+#define _BLIT_H_
+
+#include "chip8.h"
+
+/* expands the packed 1bpp display from chip8_display_pack into pixels */
+
+enum blit_format {
+	BLIT_RGB332,
+	BLIT_RGB565,
+	BLIT_ARGB8888,
+	BLIT_FORMAT_COUNT
+};
+
+enum blit_impl {
+	BLIT_IMPL_AUTO,   /* fastest measured one the cpu supports for the format */
+	BLIT_IMPL_TABLE,  /* lookup table of 8 expanded pixels per byte */
+	BLIT_IMPL_SSE2,
+	BLIT_IMPL_AVX2,
+	BLIT_IMPL_COUNT
+};
+
+struct blitter {
+	const char *name;
+	enum blit_format format;
+	int bpp;              /* bytes per pixel */
+	uint32_t fg, bg;      /* palette in the target format */
+
+	/* expand n packed bytes into n*8 pixels */
+	void (*expand) ( const struct blitter *b, const u8 *src, int n, u8 *dst );
+
+	/* 8 pixels for every byte value, used by the table implementation */
+	u8 table[256 * 8 * 4];
+};
+
+/* fg and bg are 0xRRGGBB. returns 0 if impl is not available on this cpu */
+int blit_init ( struct blitter *b, enum blit_format format,
+                uint32_t fg, uint32_t bg, enum blit_impl impl );
+
+/* expand display rows y0 up to but excluding y1 of a packed display into
+   pixels, which points at row 0 of a surface pitch bytes per row */
+void blit_rows ( const struct blitter *b, const u8 *packed, int y0, int y1,
+                 void *pixels, int pitch );
+
+const char *blit_format_name ( enum blit_format format );
+const char *blit_impl_name ( enum blit_impl impl );
+
+/* look up by name, returns -1 if there is no such format or implementation */
+int blit_format_find ( const char *name );
+int blit_impl_find ( const char *name );
+
+#endif
@@ -0,0 +1,467 @@
+#include "engine.h"
+#include "ops.h"
+#include "profile.h"
+#include <stdlib.h>
+#include <memory.h>
+
+/* pre-decoded interpreter. every address in mem gets a slot holding the
+   handler and operands of the instruction starting there. slots are decoded
+   lazily the first time they are executed and reset whenever the program
+   writes over either of their two bytes, so self-modifying code still works.
+   with gcc/clang the handlers are direct-threaded through computed goto,
+   other compilers get a plain switch over the handler index.
+
+   common pairs and triples are fused into superinstructions when their
+   first slot is decoded:
+
+       LD I, nnn; DRW Vx, Vy, n        set up and draw a sprite
+       LD Vx, kk; LD DT, Vx            start the delay timer
+       ADD Vx, kk; SE Vx, jj; JP nnn   counting loop, SNE as well
+       LD Vx, DT; SE Vx, jj; JP nnn    delay timer wait, SNE as well
+
+   a fused slot keeps the operands of its first instruction so it can fall
+   back to running only that one when the budget runs out part way, and
+   the loops keep going round in the handler while the jump comes back to
+   them. none of them writes memory or yields */
+
+#if defined(__GNUC__)
+#define CACHED_COMPUTED_GOTO 1
+#else
+#define CACHED_COMPUTED_GOTO 0
+#endif
+
+enum {
+    OP_DECODE, /* slot has not been decoded yet */
+    OP_NOP, OP_CLS, OP_RET, OP_SYS, OP_JP, OP_CALL,
+    OP_SE_VB, OP_SNE_VB, OP_SE_VV, OP_LD_VB, OP_ADD_VB,
+    OP_LD_VV, OP_OR, OP_AND, OP_XOR, OP_ADD_VV, OP_SUB, OP_SHR, OP_SUBN, OP_SHL,
+    OP_SNE_VV, OP_LD_I, OP_JP_V0, OP_RND, OP_DRW, OP_SKP, OP_SKNP,
+    OP_LD_VDT, OP_LD_VK, OP_LD_DTV, OP_LD_STV, OP_ADD_IV, OP_LD_FV,
+    OP_LD_BV, OP_LD_MEMV, OP_LD_VMEM,
+    OP_FUSE_LD_I_DRW, OP_FUSE_LD_DT, OP_FUSE_COUNT, OP_FUSE_WAIT,
+    OP_COUNT
+};
+
+/* first handler that is a superinstruction, counters are indexed from it */
+#define OP_FUSE_FIRST OP_FUSE_LD_I_DRW
+#define FUSE_KINDS    (OP_COUNT - OP_FUSE_FIRST)
+
+static const char *const fuse_names[FUSE_KINDS] = {
+    "fuse_ld_i_drw", "fuse_ld_dt", "fuse_count", "fuse_wait"
+};
+
+/* the longest superinstruction, in bytes */
+#define FUSE_MAX_LEN 6
+
+struct op {
+    u8  h;    /* handler index */
+    u8  x;
+    u8  y;    /* for the fused loops, 1 if the test is SNE rather than SE */
+    u8  n;
+    u8  byte;
+    u8  byte2; /* the test's kk in the fused loops */
+    u16 word;
+};
+
+struct cached {
+    struct op ops[CHIP8_MEMORY_CAPACITY];
+    /* times each superinstruction was taken, kept across flushes */
+    unsigned long long fired[FUSE_KINDS];
+};
+
+static u8
+decode_handler ( u16 opcode ) {
+    switch ( opcode & 0xF000 ) {
+        case 0x0000:
+            switch ( opcode & 0x0FFF ) {
+                case 0x00E0: return OP_CLS;
+                case 0x00EE: return OP_RET;
+                default:     return OP_SYS;
+            }
+        case 0x1000: return OP_JP;
+        case 0x2000: return OP_CALL;
+        case 0x3000: return OP_SE_VB;
+        case 0x4000: return OP_SNE_VB;
+        case 0x5000: return OP_SE_VV;
+        case 0x6000: return OP_LD_VB;
+        case 0x7000: return OP_ADD_VB;
+        case 0x8000:
+            switch ( opcode & 0x000F ) {
+                case 0x0000: return OP_LD_VV;
+                case 0x0001: return OP_OR;
+                case 0x0002: return OP_AND;
+                case 0x0003: return OP_XOR;
+                case 0x0004: return OP_ADD_VV;
+                case 0x0005: return OP_SUB;
+                case 0x0006: return OP_SHR;
+                case 0x0007: return OP_SUBN;
+                case 0x000E: return OP_SHL;
+            }
+            return OP_NOP;
+        case 0x9000: return OP_SNE_VV;
+        case 0xA000: return OP_LD_I;
+        case 0xB000: return OP_JP_V0;
+        case 0xC000: return OP_RND;
+        case 0xD000: return OP_DRW;
+        case 0xE000:
+            switch ( opcode & 0x00FF ) {
+                case 0x009E: return OP_SKP;
+                case 0x00A1: return OP_SKNP;
+            }
+            return OP_NOP;
+        case 0xF000:
+            switch ( opcode & 0x00FF ) {
+                case 0x0007: return OP_LD_VDT;
+                case 0x000A: return OP_LD_VK;
+                case 0x0015: return OP_LD_DTV;
+                case 0x0018: return OP_LD_STV;
+                case 0x001E: return OP_ADD_IV;
+                case 0x0029: return OP_LD_FV;
+                case 0x0033: return OP_LD_BV;
+                case 0x0055: return OP_LD_MEMV;
+                case 0x0065: return OP_LD_VMEM;
+            }
+            return OP_NOP;
+    }
+    return OP_NOP;
+}
+
+static u16
+fetch ( const u8 *mem, u16 addr ) {
+    return (mem[addr & CHIP8_ADDR_MASK] << 8) | mem[(addr + 1) & CHIP8_ADDR_MASK];
+}
+
+/* turn the slot at addr into a superinstruction if it starts one */
+static void
+fuse ( struct op *op, const u8 *mem, u16 addr ) {
+    u16 a = fetch( mem, addr );
+    u16 b = fetch( mem, addr + 2 );
+    u16 c = fetch( mem, addr + 4 );
+    u8  x = (a >> 8) & 0xF;
+
+    if ( (a & 0xF000) == 0xA000 && (b & 0xF000) == 0xD000 ) {
+        op->h = OP_FUSE_LD_I_DRW;
+        op->x = (b >> 8) & 0xF;
+        op->y = (b >> 4) & 0xF;
+        op->n = b & 0xF;
+        return;
+    }
+    if ( (a & 0xF000) == 0x6000 && b == (0xF015 | (x << 8)) ) {
+        op->h = OP_FUSE_LD_DT;
+        return;
+    }
+
+    /* the loops, both test and jump on the register the first one sets */
+    int test = b & 0xF000;
+    if ( (test != 0x3000 && test != 0x4000) || ((b >> 8) & 0xF) != x || (c & 0xF000) != 0x1000 ) { return; }
+    if ( (a & 0xF000) == 0x7000 ) {
+        op->h = OP_FUSE_COUNT;
+    } else if ( (a & 0xF0FF) == 0xF007 ) {
+        op->h = OP_FUSE_WAIT;
+    } else {
+        return;
+    }
+    op->y     = test == 0x4000;
+    op->byte2 = b & 0xFF;
+    op->word  = c & 0xFFF;
+}
+
+static void
+decode ( struct op *op, const u8 *mem, u16 addr ) {
+    u16 opcode = fetch( mem, addr );
+
+    op->h     = decode_handler( opcode );
+    op->byte  = opcode & 0xFF;
+    op->byte2 = 0;
+    op->word  = opcode & 0xFFF;
+    op->x     = (opcode >> 8) & 0xF;
+    op->y     = (opcode >> 4) & 0xF;
+    op->n     = (opcode >> 0) & 0xF;
+    fuse( op, mem, addr );
+}
+
+/* forget the slots overlapping len bytes written at addr */
+static void
+invalidate ( struct op *ops, u16 addr, int len ) {
+    /* instructions and superinstructions starting up to FUSE_MAX_LEN - 1
+       bytes earlier also cover addr */
+    for ( int i = 1 - FUSE_MAX_LEN; i < len; i++ ) {
+        ops[(addr + i) & CHIP8_ADDR_MASK].h = OP_DECODE;
+    }
+}
+
+static void *
+cached_create ( void ) {
+    /* OP_DECODE is zero so calloc leaves every slot undecoded */
+    return calloc( 1, sizeof(struct cached) );
+}
+
+static void
+cached_destroy ( void *ctx ) {
+    free( ctx );
+}
+
+static void
+cached_flush ( void *ctx ) {
+    struct cached *cached = ctx;
+    memset( cached->ops, 0, sizeof(cached->ops) );
+}
+
+static const char *
+cached_counter ( void *ctx, int i, unsigned long long *value ) {
+    if ( i < 0 || i >= FUSE_KINDS ) { return NULL; }
+    *value = ((struct cached *) ctx)->fired[i];
+    return fuse_names[i];
+}
+
+static unsigned long
+cached_run ( void *ctx, struct chip8 *c8, unsigned long cycles ) {
+    struct op *ops = ((struct cached *) ctx)->ops;
+    const struct op *op;
+    unsigned long budget = cycles;
+    u16 pc = c8->pc;
+    u8 *v = c8->v;
+
+    c8->yield = 0;
+
+#if CACHED_COMPUTED_GOTO
+    static const void *labels[OP_COUNT] = {
+        &&L_OP_DECODE,
+        &&L_OP_NOP, &&L_OP_CLS, &&L_OP_RET, &&L_OP_SYS, &&L_OP_JP, &&L_OP_CALL,
+        &&L_OP_SE_VB, &&L_OP_SNE_VB, &&L_OP_SE_VV, &&L_OP_LD_VB, &&L_OP_ADD_VB,
+        &&L_OP_LD_VV, &&L_OP_OR, &&L_OP_AND, &&L_OP_XOR, &&L_OP_ADD_VV,
+        &&L_OP_SUB, &&L_OP_SHR, &&L_OP_SUBN, &&L_OP_SHL,
+        &&L_OP_SNE_VV, &&L_OP_LD_I, &&L_OP_JP_V0, &&L_OP_RND, &&L_OP_DRW,
+        &&L_OP_SKP, &&L_OP_SKNP,
+        &&L_OP_LD_VDT, &&L_OP_LD_VK, &&L_OP_LD_DTV, &&L_OP_LD_STV,
+        &&L_OP_ADD_IV, &&L_OP_LD_FV,
+        &&L_OP_LD_BV, &&L_OP_LD_MEMV, &&L_OP_LD_VMEM,
+        &&L_OP_FUSE_LD_I_DRW, &&L_OP_FUSE_LD_DT, &&L_OP_FUSE_COUNT, &&L_OP_FUSE_WAIT
+    };
+#define CASE(h)        L_##h
+#define DISPATCH()     goto *labels[op->h]
+#define DISPATCH_AS(k) goto *labels[k]
+#else
+    u8 h;
+#define CASE(h)        case h
+#define DISPATCH()     do { h = op->h; goto dispatch; } while(0)
+#define DISPATCH_AS(k) do { h = (k); goto dispatch; } while(0)
+#endif
+
+/* fetch the next slot, advance program counter and jump to its handler */
+#define NEXT() do {                                \
+    if ( cycles == 0 ) { goto done; }              \
+    cycles--;                                      \
+    PROFILE_OP(pc, chip8_op_fetch( c8, pc ));      \
+    op = &ops[pc];                                 \
+    pc = (pc + 2) & CHIP8_ADDR_MASK;               \
+    DISPATCH();                                    \
+} while(0)
+
+#define SKIP() do { pc = (pc + 2) & CHIP8_ADDR_MASK; } while(0)
+
+#define FIRED() do { ((struct cached *) ctx)->fired[op->h - OP_FUSE_FIRST]++; } while(0)
+
+/* account for the next instruction of a superinstruction, the caller has
+   checked the budget */
+#define INNER() do {                               \
+    cycles--;                                      \
+    PROFILE_OP(pc, chip8_op_fetch( c8, pc ));      \
+    pc = (pc + 2) & CHIP8_ADDR_MASK;               \
+} while(0)
+
+/* the rest of a fused loop once its first instruction, load, has run:
+   the test, and the jump unless the test skips it. goes round again
+   without dispatching while the jump comes back to the head and the
+   budget allows, and runs just base if it cannot afford the test */
+#define FUSED_LOOP(load, base) do {                          \
+    u16 head = (pc - 2) & CHIP8_ADDR_MASK;                   \
+    for ( ;; ) {                                             \
+        if ( cycles == 0 ) { DISPATCH_AS(base); }            \
+        load;                                                \
+        FIRED();                      \
+        INNER();                                             \
+        if ( (v[op->x] == op->byte2) != op->y ) {            \
+            SKIP();                                          \
+            NEXT();                                          \
+        }                                                    \
+        if ( cycles == 0 ) { goto done; }                    \
+        INNER();                                             \
+        pc = op->word;                                       \
+        if ( pc != head || cycles == 0 ) { NEXT(); }         \
+        cycles--;                                            \
+        PROFILE_OP(pc, chip8_op_fetch( c8, pc ));            \
+        pc = (pc + 2) & CHIP8_ADDR_MASK;                     \
+    }                                                        \
+} while(0)
+
+    NEXT();
+
+#if !CACHED_COMPUTED_GOTO
+dispatch:
+    switch ( h ) {
+#endif
+    CASE(OP_DECODE): {
+        u16 addr = (pc - 2) & CHIP8_ADDR_MASK;
+        decode( &ops[addr], c8->mem, addr );
+        DISPATCH();
+    }
+    CASE(OP_NOP):
+        NEXT();
+    CASE(OP_CLS):
+        chip8_op_clear( c8 );
+        NEXT();
+    CASE(OP_RET):
+        c8->sp = (c8->sp - 1) & CHIP8_STACK_MASK;
+        pc = c8->stack[c8->sp];
+        NEXT();
+    CASE(OP_SYS):
+    CASE(OP_JP):
+        pc = op->word;
+        NEXT();
+    CASE(OP_CALL):
+        c8->stack[c8->sp] = pc;
+        c8->sp = (c8->sp + 1) & CHIP8_STACK_MASK;
+        pc = op->word;
+        NEXT();
+    CASE(OP_SE_VB):
+        if (v[op->x] == op->byte) { SKIP(); }
+        NEXT();
+    CASE(OP_SNE_VB):
+        if (v[op->x] != op->byte) { SKIP(); }
+        NEXT();
+    CASE(OP_SE_VV):
+        if (v[op->x] == v[op->y]) { SKIP(); }
+        NEXT();
+    CASE(OP_LD_VB):
+        v[op->x] = op->byte;
+        NEXT();
+    CASE(OP_ADD_VB):
+        v[op->x] += op->byte;
+        NEXT();
+    CASE(OP_LD_VV):
+        v[op->x] = v[op->y];
+        NEXT();
+    CASE(OP_OR):
+        v[op->x] |= v[op->y];
+        NEXT();
+    CASE(OP_AND):
+        v[op->x] &= v[op->y];
+        NEXT();
+    CASE(OP_XOR):
+        v[op->x] ^= v[op->y];
+        NEXT();
+    CASE(OP_ADD_VV):
+        v[0xF] = ((255 - v[op->x]) < v[op->y]);
+        v[op->x] += v[op->y];
+        NEXT();
+    CASE(OP_SUB):
+        v[0xF] = v[op->y] < v[op->x];
+        v[op->x] -= v[op->y];
+        NEXT();
+    CASE(OP_SHR):
+        v[0xF] = v[op->x] & 0x01;
+        v[op->x] >>= 1;
+        NEXT();
+    CASE(OP_SUBN):
+        v[0xF] = v[op->x] < v[op->y];
+        v[op->x] = v[op->y] - v[op->x];
+        NEXT();
+    CASE(OP_SHL):
+        v[0xF] = v[op->x] & 0x80;
+        v[op->x] <<= 1;
+        NEXT();
+    CASE(OP_SNE_VV):
+        if (v[op->x] != v[op->y]) { SKIP(); }
+        NEXT();
+    CASE(OP_LD_I):
+        c8->i = op->word;
+        NEXT();
+    CASE(OP_JP_V0):
+        pc = (op->word + v[0]) & CHIP8_ADDR_MASK;
+        NEXT();
+    CASE(OP_RND):
+        v[op->x] = chip8_op_random( c8 ) & op->byte;
+        NEXT();
+    CASE(OP_DRW):
+        v[0xF] = chip8_op_draw( c8, v[op->x], v[op->y], op->n );
+        NEXT();
+    CASE(OP_SKP):
+        if (c8->keyboard[v[op->x] & 0xF] == CHIP8_KEY_DOWN) { SKIP(); }
+        NEXT();
+    CASE(OP_SKNP):
+        if (c8->keyboard[v[op->x] & 0xF] != CHIP8_KEY_DOWN) { SKIP(); }
+        NEXT();
+    CASE(OP_LD_VDT):
+        v[op->x] = c8->dt;
+        NEXT();
+    CASE(OP_LD_VK):
+        if ( !chip8_op_key_wait( c8, op->x ) ) {
+            pc = (pc - 2) & CHIP8_ADDR_MASK;
+            goto done;
+        }
+        NEXT();
+    CASE(OP_LD_DTV):
+        c8->dt = v[op->x];
+        NEXT();
+    CASE(OP_LD_STV):
+        chip8_op_sound( c8, v[op->x] );
+        if ( c8->yield ) { goto done; }
+        NEXT();
+    CASE(OP_ADD_IV):
+        c8->i += v[op->x];
+        NEXT();
+    CASE(OP_LD_FV):
+        c8->i = (v[op->x] % 0x10) * 5;
+        NEXT();
+    CASE(OP_LD_BV):
+        chip8_op_bcd( c8, op->x );
+        invalidate( ops, c8->i, 3 );
+        NEXT();
+    CASE(OP_LD_MEMV):
+        chip8_op_store( c8, op->x );
+        invalidate( ops, c8->i, op->x + 1 );
+        NEXT();
+    CASE(OP_LD_VMEM):
+        chip8_op_load( c8, op->x );
+        NEXT();
+    CASE(OP_FUSE_LD_I_DRW):
+        if ( cycles == 0 ) { DISPATCH_AS(OP_LD_I); }
+        FIRED();
+        c8->i = op->word;
+        INNER();
+        v[0xF] = chip8_op_draw( c8, v[op->x], v[op->y], op->n );
+        NEXT();
+    CASE(OP_FUSE_LD_DT):
+        if ( cycles == 0 ) { DISPATCH_AS(OP_LD_VB); }
+        FIRED();
+        v[op->x] = op->byte;
+        INNER();
+        c8->dt = op->byte;
+        NEXT();
+    CASE(OP_FUSE_COUNT):
+        FUSED_LOOP(v[op->x] += op->byte, OP_ADD_VB);
+    CASE(OP_FUSE_WAIT):
+        FUSED_LOOP(v[op->x] = c8->dt, OP_LD_VDT);
+#if !CACHED_COMPUTED_GOTO
+    }
+#endif
+
+done:
+    c8->pc = pc;
+
+#undef CASE
+#undef DISPATCH
+#undef DISPATCH_AS
+#undef NEXT
+#undef SKIP
+#undef INNER
+#undef FIRED
+#undef FUSED_LOOP
+
+    return budget - cycles;
+}
+
+const struct chip8_engine chip8_engine_cached = {
+    "cached", cached_create, cached_destroy, cached_flush, cached_run, cached_counter
+};
@@ -2,24 +2,27 @@
 #define _CHIP8_H_
 
 #include <stdint.h>
+#include <stddef.h>
 
 /* uncomment to enable disassembly dump to terminal when emulator is running */
 /* #define CHIP8_DEBUG_ENABLE */
 
-/* useful macro for printing code that is being executed by emulator */
+/* useful macro for printing code that is being executed by emulator, */
+/* see chip8_trace_open for a trace that does not slow emulation down */
 #ifdef CHIP8_DEBUG_ENABLE
 #include <stdio.h>
-#define DEBUG(pc, opcode, ...) do { \
-    fprintf( stdout, "0x%04X : 0x%04X : ", pc, opcode ); \
-    fprintf( stdout, __VA_ARGS__ );                      \
-    fprintf( stdout, "\n" );                             \
+#define DEBUG(pc, opcode) do { \
+    char dis_[CHIP8_DISASM_MAX];                                  \
+    fprintf( stdout, "0x%04X : 0x%04X : %s\n", pc, opcode,        \
+        chip8_disasm( opcode, dis_, sizeof(dis_) ) );             \
 } while(0)
 #else
-#define DEBUG(pc, opcode, ...) do { } while(0)
+#define DEBUG(pc, opcode) do { } while(0)
 #endif
 
 /* chip-8 screen properties */
-/* display buf is smaller than display because 8 pixels per buf element */
+/* display buf is the packed form handed out by chip8_display_pack, */
+/* it is smaller than display because 8 pixels per buf element */
 #define CHIP8_DISPLAY_BUF_WIDTH  8
 #define CHIP8_DISPLAY_BUF_HEIGHT 32
 #define CHIP8_DISPLAY_BUF_SIZE (CHIP8_DISPLAY_BUF_WIDTH*CHIP8_DISPLAY_BUF_HEIGHT)
@@ -28,6 +31,32 @@
 
 #define CHIP8_MEMORY_CAPACITY 0x1000
 
+/* programs are loaded at 0x200, which leaves room for 3.5K of rom */
+#define CHIP8_ROM_START 0x200
+#define CHIP8_ROM_MAX   (CHIP8_MEMORY_CAPACITY - CHIP8_ROM_START)
+
+/* addresses wrap around the 4K address space, the stack holds 16 entries */
+#define CHIP8_ADDR_MASK  (CHIP8_MEMORY_CAPACITY - 1)
+#define CHIP8_STACK_MASK 0xF
+
+/* skip the next instruction */
+#define CHIP8_SKIP(c8) do { (c8)->pc = ((c8)->pc + 2) & CHIP8_ADDR_MASK; } while(0)
+
+/* the delay and sound timers count down at 60 Hz, once per frame */
+#define CHIP8_TIMER_HZ    60
+/* instructions per frame unless changed through chip8->ipf */
+#define CHIP8_DEFAULT_IPF 10
+
+/* reasons for a run to return before its budget is spent */
+#define CHIP8_YIELD_KEY   0x1 /* blocked in LD Vx, K with no key down */
+#define CHIP8_YIELD_SOUND 0x2 /* sound timer was started from zero */
+
+/* seed chip8_init gives the random number generator */
+#define CHIP8_DEFAULT_SEED 0x2545F491u
+
+/* built in 4x5 hex digit sprites, 5 bytes each, loaded at address 0 */
+#define CHIP8_FONT_SIZE (16 * 5)
+
 /* chip-8 keyboard key codes */
 #define CHIP8_KEY_0 0x00
 #define CHIP8_KEY_1 0x01
@@ -53,6 +82,11 @@
 typedef uint8_t  u8;  /* 8-bit unsigned data type */
 typedef uint16_t u16; /* 16-bit unsigned data type */
 
+/* one display row per element, leftmost pixel in the most significant bit. */
+/* a 128x64 SUPER-CHIP display only needs a 128-bit row type here */
+typedef uint64_t chip8_row;
+#define CHIP8_ROW_BITS 64
+
 struct chip8 {
 	u16 i;     /* 16 bit address register */
 	u16 pc;    /* program counter */
@@ -65,18 +99,68 @@ struct chip8 {
 	u16 stack[16];
 	/* chip-8 memory for storing ROMs etc */
 	u8 mem[CHIP8_MEMORY_CAPACITY];
-	/* chip-8 screen buffer */
-	u8 display[CHIP8_DISPLAY_BUF_WIDTH * CHIP8_DISPLAY_BUF_HEIGHT];
-	/* chip-8 keyboard key states */
+	/* chip-8 screen buffer, use the chip8_display_* accessors to read it */
+	chip8_row display[CHIP8_DISPLAY_HEIGHT];
+	/* chip-8 keyboard key states, change them with chip8_key_set_state */
 	u8 keyboard[16];
+	/* the same as a mask, bit n set while key n is down */
+	u16 keys;
 
 	/* boolean will be set to 1 when chip-8 emits beep */
 	int beep;
+
+	/* xorshift32 state behind RND, set with chip8_seed */
+	uint32_t rng;
+	/* 60 Hz frames completed since chip8_init */
+	unsigned long long frame;
+
+	/* instructions executed per 60 Hz frame */
+	int ipf;
+	/* instructions still to run in the current frame, 0 between frames */
+	int cycles_left;
+	/* CHIP8_YIELD_* flags saying why the last run stopped early */
+	int yield;
+	/* binary trace chip8_step appends to, NULL when not tracing */
+	struct chip8_trace *trace;
+	/* log chip8_key_set_state records key changes in, NULL if none */
+	struct chip8_input *input;
+
+	/* instructions executed through chip8_run_frame so far */
+	unsigned long long instructions;
+	/* instructions chip8_run_frame skipped because the program was idle,
+	   spinning on the delay timer, jumping to itself or waiting for a key */
+	unsigned long long idle;
 };
 
+extern const u8 chip8_fonts[CHIP8_FONT_SIZE];
+
 void chip8_init ( struct chip8 *chip8 );
+/* copy a rom into memory at CHIP8_ROM_START, 0 if it does not fit or, for
+   chip8_load, cannot be read */
 int  chip8_load ( struct chip8 *chip8, const char *romfile );
+int  chip8_load_mem ( struct chip8 *chip8, const u8 *rom, size_t len );
+/* restart the random number generator, runs with the same seed and input
+   are identical */
+void chip8_seed ( struct chip8 *chip8, uint32_t seed );
 void chip8_step ( struct chip8 *chip8 );
+
+/* execute up to cycles instructions, stopping early after one that sets a
+   CHIP8_YIELD_* flag. timers are left alone. returns instructions executed */
+unsigned long chip8_run_cycles ( struct chip8 *chip8, unsigned long cycles );
+/* run the rest of the current frame of ipf instructions, then tick the
+   timers. returns 1 when the frame is complete and 0 when it stopped early
+   for a sound starting, call again to finish it. a key wait ends the frame */
+int  chip8_run_frame ( struct chip8 *chip8 );
+/* count the delay and sound timers down by one 60 Hz tick */
+void chip8_timer_tick ( struct chip8 *chip8 );
 void chip8_key_set_state ( struct chip8 *chip8, int key, int state );
 
+/* 1 if the pixel at x, y is lit */
+int  chip8_display_pixel ( const struct chip8 *chip8, int x, int y );
+/* write the display to buf as CHIP8_DISPLAY_BUF_SIZE bytes, row after row, */
+/* 8 pixels per byte with the leftmost pixel in the most significant bit */
+void chip8_display_pack ( const struct chip8 *chip8, u8 *buf );
+/* the same for a copy of the CHIP8_DISPLAY_HEIGHT rows of a display */
+void chip8_display_pack_rows ( const chip8_row *display, u8 *buf );
+
 #endif
@@ -0,0 +1,67 @@
+#include "disasm.h"
+#include <stdio.h>
+
+const char *
+chip8_disasm ( u16 opcode, char *buf, size_t len ) {
+    u8  byte = opcode & 0xFF;
+    u16 word = opcode & 0xFFF;
+    u8  x    = (opcode >> 8) & 0xF;
+    u8  y    = (opcode >> 4) & 0xF;
+    u8  n    = (opcode >> 0) & 0xF;
+
+    switch ( opcode & 0xF000 ) {
+        case 0x0000:
+            switch ( opcode & 0x0FFF ) {
+                case 0x00E0: snprintf( buf, len, "CLS" ); return buf;
+                case 0x00EE: snprintf( buf, len, "RET" ); return buf;
+                default:     snprintf( buf, len, "SYS  0x%03X", word ); return buf;
+            }
+        case 0x1000: snprintf( buf, len, "JP   0x%03X", word ); return buf;
+        case 0x2000: snprintf( buf, len, "CALL 0x%03X", word ); return buf;
+        case 0x3000: snprintf( buf, len, "SE   V%d, 0x%02X", x, byte ); return buf;
+        case 0x4000: snprintf( buf, len, "SNE  V%d, 0x%02X", x, byte ); return buf;
+        case 0x5000: snprintf( buf, len, "SE   V%d, V%d", x, y ); return buf;
+        case 0x6000: snprintf( buf, len, "LD   V%d, 0x%02X", x, byte ); return buf;
+        case 0x7000: snprintf( buf, len, "ADD  V%d, 0x%02X", x, byte ); return buf;
+        case 0x8000:
+            switch ( opcode & 0x000F ) {
+                case 0x0: snprintf( buf, len, "LD   V%d, V%d", x, y ); return buf;
+                case 0x1: snprintf( buf, len, "OR   V%d, V%d", x, y ); return buf;
+                case 0x2: snprintf( buf, len, "AND  V%d, V%d", x, y ); return buf;
+                case 0x3: snprintf( buf, len, "XOR  V%d, V%d", x, y ); return buf;
+                case 0x4: snprintf( buf, len, "ADD  V%d, V%d", x, y ); return buf;
+                case 0x5: snprintf( buf, len, "SUB  V%d, V%d", x, y ); return buf;
+                case 0x6: snprintf( buf, len, "SHR  V%d", x ); return buf;
+                case 0x7: snprintf( buf, len, "SUBN V%d, V%d", x, y ); return buf;
+                case 0xE: snprintf( buf, len, "SHL  V%d", x ); return buf;
+            }
+            break;
+        case 0x9000: snprintf( buf, len, "SNE  V%d, V%d", x, y ); return buf;
+        case 0xA000: snprintf( buf, len, "LD   I, 0x%03X", word ); return buf;
+        case 0xB000: snprintf( buf, len, "JP   V0, 0x%03X", word ); return buf;
+        case 0xC000: snprintf( buf, len, "RND  V%d, 0x%02X", x, byte ); return buf;
+        case 0xD000: snprintf( buf, len, "DRW  V%d, V%d, 0x%X", x, y, n ); return buf;
+        case 0xE000:
+            switch ( byte ) {
+                case 0x9E: snprintf( buf, len, "SKP  V%d", x ); return buf;
+                case 0xA1: snprintf( buf, len, "SKNP V%d", x ); return buf;
+            }
+            break;
+        case 0xF000:
+            switch ( byte ) {
+                case 0x07: snprintf( buf, len, "LD   V%d, DT", x ); return buf;
+                case 0x0A: snprintf( buf, len, "LD   V%d, K", x ); return buf;
+                case 0x15: snprintf( buf, len, "LD   DT, V%d", x ); return buf;
+                case 0x18: snprintf( buf, len, "LD   ST, V%d", x ); return buf;
+                case 0x1E: snprintf( buf, len, "ADD  I, V%d", x ); return buf;
+                case 0x29: snprintf( buf, len, "LD   F, V%d", x ); return buf;
+                case 0x33: snprintf( buf, len, "LD   B, V%d", x ); return buf;
+                case 0x55: snprintf( buf, len, "LD   [I], V%d", x ); return buf;
+                case 0x65: snprintf( buf, len, "LD   V%d, [I]", x ); return buf;
+            }
+            break;
+    }
+
+    snprintf( buf, len, "DW   0x%04X", opcode );
+    return buf;
+}
@@ -0,0 +1,14 @@
+#ifndef _DISASM_H_
+#define _DISASM_H_
+
+#include "chip8.h"
+#include <stddef.h>
+
+/* longest text chip8_disasm produces, terminator included */
+#define CHIP8_DISASM_MAX 24
+
+/* write the assembly text of opcode to buf, e.g. "LD   V3, 0x1F", and
+   return buf. words that are not instructions come out as "DW   0xnnnn" */
+const char *chip8_disasm ( u16 opcode, char *buf, size_t len );
+
+#endif
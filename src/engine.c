@@ -0,0 +1,55 @@
+#include "engine.h"
+#include "ops.h"
+#include <string.h>
+
+const struct chip8_engine *chip8_engines[] = {
+    &chip8_engine_switch,
+    &chip8_engine_cached,
+#if CHIP8_HAVE_JIT
+    &chip8_engine_jit,
+#endif
+    NULL
+};
+
+const struct chip8_engine *
+chip8_engine_find ( const char *name ) {
+    for ( int i = 0; chip8_engines[i]; i++ ) {
+        if ( strcmp( chip8_engines[i]->name, name ) == 0 ) {
+            return chip8_engines[i];
+        }
+    }
+    return NULL;
+}
+
+int
+chip8_engine_run_frame ( const struct chip8_engine *e, void *ctx, struct chip8 *c8 ) {
+    /* only chip8_step records trace entries. what the engine cached may be
+       stale after chip8_step changed memory behind its back */
+    if ( c8->trace ) {
+        e->flush( ctx );
+        return chip8_run_frame( c8 );
+    }
+    return chip8_op_frame( c8, e->run, ctx );
+}
+
+/* the reference interpreter keeps no state of its own */
+static void *
+switch_create ( void ) {
+    static char dummy;
+    return &dummy;
+}
+
+static void
+switch_destroy ( void *ctx ) { }
+
+static void
+switch_flush ( void *ctx ) { }
+
+static unsigned long
+switch_run ( void *ctx, struct chip8 *c8, unsigned long cycles ) {
+    return chip8_run_cycles( c8, cycles );
+}
+
+const struct chip8_engine chip8_engine_switch = {
+    "switch", switch_create, switch_destroy, switch_flush, switch_run, NULL
+};
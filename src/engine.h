@@ -0,0 +1,51 @@
+#ifndef _ENGINE_H_
+#define _ENGINE_H_
+
+#include "chip8.h"
+
+/* an execution engine runs instructions on a struct chip8. chip8_step is
+   the reference, every other engine must leave the machine in exactly the
+   state chip8_step would have. engines may cache things derived from mem
+   in their context, so a context belongs to a single machine */
+struct chip8_engine {
+	const char *name;
+
+	/* allocate engine state for one machine, NULL on failure */
+	void *(*create) ( void );
+	void  (*destroy) ( void *ctx );
+
+	/* discard anything derived from memory. call after chip8_load or after
+	   writing to mem from outside the engine */
+	void  (*flush) ( void *ctx );
+
+	/* execute up to cycles instructions, returning early after one that
+	   sets a CHIP8_YIELD_* flag like chip8_run_cycles. timers are not
+	   touched. returns the number of instructions executed */
+	unsigned long (*run) ( void *ctx, struct chip8 *chip8, unsigned long cycles );
+
+	/* optional, NULL if the engine keeps no counters. stores the value of
+	   counter i in value and returns its name, or returns NULL once i is
+	   past the last one. counters survive flush */
+	const char *(*counter) ( void *ctx, int i, unsigned long long *value );
+};
+
+extern const struct chip8_engine chip8_engine_switch;
+extern const struct chip8_engine chip8_engine_cached;
+
+/* the recompiler needs an x86-64 host that can map executable memory */
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define CHIP8_HAVE_JIT 1
+extern const struct chip8_engine chip8_engine_jit;
+#else
+#define CHIP8_HAVE_JIT 0
+#endif
+
+/* NULL terminated list of engines available in this build */
+extern const struct chip8_engine *chip8_engines[];
+
+const struct chip8_engine *chip8_engine_find ( const char *name );
+
+/* chip8_run_frame on an engine */
+int chip8_engine_run_frame ( const struct chip8_engine *engine, void *ctx, struct chip8 *chip8 );
+
+#endif
@@ -0,0 +1,347 @@
+#include "env.h"
+#include "hash.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+/* environments a thread claims at a time */
+#define CHUNK 64
+
+/* worker threads wait for a new generation, then claim chunks of
+   environments until none are left. the thread calling chip8_env_step
+   claims chunks too */
+struct chip8_env_pool {
+    pthread_t *threads;
+    int nthreads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t go;
+    pthread_cond_t done;
+    unsigned long generation;
+    int busy;
+    int quit;
+
+    atomic_int next;
+    struct chip8_env *env;
+    const u16 *actions;
+    u8 *obs;
+    float *rewards;
+    u8 *dones;
+};
+
+/* each byte of a display row expanded to one byte per pixel, leftmost
+   pixel first */
+static u8 expand[256][8];
+static pthread_once_t expand_once = PTHREAD_ONCE_INIT;
+
+static void
+init_expand ( void ) {
+    for ( int b = 0; b < 256; b++ ) {
+        for ( int j = 0; j < 8; j++ ) { expand[b][j] = (b >> (7 - j)) & 1; }
+    }
+}
+
+static void
+write_obs ( const struct chip8_env *env, const struct chip8_paged *m, u8 *obs ) {
+    if ( env->obs == CHIP8_ENV_OBS_PACKED ) {
+        chip8_display_pack_rows( m->display, obs );
+        return;
+    }
+
+    for ( int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++ ) {
+        chip8_row row = m->display[y];
+        for ( int b = 0; b < CHIP8_ROW_BITS / 8; b++ ) {
+            memcpy( obs, expand[(row >> (CHIP8_ROW_BITS - 8 - 8 * b)) & 0xFF], 8 );
+            obs += 8;
+        }
+    }
+}
+
+static int
+probe_value ( const struct chip8_probe *probe, const struct chip8_paged *m ) {
+    switch ( probe->source ) {
+        case CHIP8_PROBE_MEM:
+            return chip8_paged_read( m, probe->addr );
+        case CHIP8_PROBE_V:
+            return m->v[probe->addr & 0xF];
+        case CHIP8_PROBE_BCD:
+            return chip8_paged_read( m, probe->addr ) * 100 +
+                   chip8_paged_read( m, probe->addr + 1 ) * 10 +
+                   chip8_paged_read( m, probe->addr + 2 );
+    }
+    return 0;
+}
+
+static void
+reset_one ( struct chip8_env *env, int e ) {
+    struct chip8_paged *m = &env->machines[e];
+    uint64_t key[3] = { env->seed, (uint64_t) e, env->episodes[e]++ };
+    uint32_t rng = fnv1a64( key, sizeof(key), FNV1A64_INIT );
+
+    chip8_paged_release( m );
+    chip8_paged_fork( m, &env->start );
+    /* xorshift never leaves zero */
+    m->rng = rng? rng : CHIP8_DEFAULT_SEED;
+    env->held[e] = 0;
+
+    for ( int p = 0; p < env->nprobes; p++ ) {
+        env->last[e * CHIP8_ENV_PROBES + p] = probe_value( &env->probes[p], m );
+    }
+}
+
+static void
+step_one ( struct chip8_env *env, int e, u16 action, u8 *obs, float *reward, u8 *done ) {
+    struct chip8_paged *m = &env->machines[e];
+    u16 changed = action ^ env->held[e];
+    float r = 0;
+    int over = 0;
+
+    for ( int key = 0; changed; key++, changed >>= 1 ) {
+        if ( changed & 1 ) {
+            chip8_paged_key_set_state( m, key, ((action >> key) & 1)? CHIP8_KEY_DOWN : CHIP8_KEY_UP );
+        }
+    }
+    env->held[e] = action;
+
+    for ( int f = 0; f < env->skip; f++ ) {
+        while ( !chip8_paged_run_frame( m ) ) { }
+    }
+
+    for ( int p = 0; p < env->nprobes; p++ ) {
+        const struct chip8_probe *probe = &env->probes[p];
+        int *last = &env->last[e * CHIP8_ENV_PROBES + p];
+        int value = probe_value( probe, m );
+
+        r += probe->scale * (value - *last);
+        *last = value;
+        if ( value == probe->done ) { over = 1; }
+    }
+    if ( env->hook ) { r += env->hook( env->hook_ctx, e, m, &over ); }
+    if ( env->max_frames && m->frame - env->start.frame >= env->max_frames ) { over = 1; }
+
+    if ( over ) { reset_one( env, e ); }
+    if ( obs ) { write_obs( env, m, obs ); }
+    if ( reward ) { *reward = r; }
+    if ( done ) { *done = over; }
+}
+
+/* step or reset chunks of environments until there are none left */
+static void
+run_chunks ( struct chip8_env_pool *pool ) {
+    struct chip8_env *env = pool->env;
+    size_t size = chip8_env_obs_size( env );
+    int chunk;
+
+    while ( (chunk = atomic_fetch_add( &pool->next, 1 )) * CHUNK < env->n ) {
+        int end = (chunk + 1) * CHUNK;
+        if ( end > env->n ) { end = env->n; }
+
+        for ( int e = chunk * CHUNK; e < end; e++ ) {
+            u8 *obs = pool->obs? pool->obs + e * size : NULL;
+
+            if ( pool->actions ) {
+                step_one( env, e, pool->actions[e], obs,
+                          pool->rewards? &pool->rewards[e] : NULL,
+                          pool->dones? &pool->dones[e] : NULL );
+            } else {
+                reset_one( env, e );
+                if ( obs ) { write_obs( env, &env->machines[e], obs ); }
+            }
+        }
+    }
+}
+
+static void *
+worker ( void *arg ) {
+    struct chip8_env_pool *pool = arg;
+    unsigned long seen = 0;
+
+    for ( ;; ) {
+        pthread_mutex_lock( &pool->lock );
+        while ( pool->generation == seen && !pool->quit ) {
+            pthread_cond_wait( &pool->go, &pool->lock );
+        }
+        if ( pool->quit ) {
+            pthread_mutex_unlock( &pool->lock );
+            return NULL;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock( &pool->lock );
+
+        run_chunks( pool );
+
+        pthread_mutex_lock( &pool->lock );
+        if ( --pool->busy == 0 ) { pthread_cond_signal( &pool->done ); }
+        pthread_mutex_unlock( &pool->lock );
+    }
+}
+
+/* run every environment through the workers and this thread, actions of
+   NULL resets them */
+static void
+run_all ( struct chip8_env *env, const u16 *actions, void *obs, float *rewards, u8 *dones ) {
+    struct chip8_env_pool *pool = env->pool;
+
+    pool->actions = actions;
+    pool->obs = obs;
+    pool->rewards = rewards;
+    pool->dones = dones;
+    atomic_store( &pool->next, 0 );
+
+    if ( pool->nthreads == 0 ) {
+        run_chunks( pool );
+        return;
+    }
+
+    pthread_mutex_lock( &pool->lock );
+    pool->busy = pool->nthreads;
+    pool->generation++;
+    pthread_cond_broadcast( &pool->go );
+    pthread_mutex_unlock( &pool->lock );
+
+    run_chunks( pool );
+
+    pthread_mutex_lock( &pool->lock );
+    while ( pool->busy > 0 ) { pthread_cond_wait( &pool->done, &pool->lock ); }
+    pthread_mutex_unlock( &pool->lock );
+}
+
+static struct chip8_env_pool *
+pool_create ( struct chip8_env *env, int threads ) {
+    struct chip8_env_pool *pool = calloc( 1, sizeof(struct chip8_env_pool) );
+
+    if ( !pool ) { return NULL; }
+    pool->env = env;
+    pthread_mutex_init( &pool->lock, NULL );
+    pthread_cond_init( &pool->go, NULL );
+    pthread_cond_init( &pool->done, NULL );
+
+    /* the calling thread is one of them, and there is no use in more
+       threads than chunks */
+    int chunks = (env->n + CHUNK - 1) / CHUNK;
+    if ( threads > chunks ) { threads = chunks; }
+    if ( threads < 1 ) { threads = 1; }
+
+    pool->threads = malloc( sizeof(pthread_t) * threads );
+    if ( !pool->threads ) {
+        free( pool );
+        return NULL;
+    }
+    for ( int t = 0; t < threads - 1; t++ ) {
+        if ( pthread_create( &pool->threads[t], NULL, worker, pool ) != 0 ) { break; }
+        pool->nthreads++;
+    }
+    return pool;
+}
+
+static void
+pool_destroy ( struct chip8_env_pool *pool ) {
+    pthread_mutex_lock( &pool->lock );
+    pool->quit = 1;
+    pthread_cond_broadcast( &pool->go );
+    pthread_mutex_unlock( &pool->lock );
+
+    for ( int t = 0; t < pool->nthreads; t++ ) { pthread_join( pool->threads[t], NULL ); }
+    pthread_mutex_destroy( &pool->lock );
+    pthread_cond_destroy( &pool->go );
+    pthread_cond_destroy( &pool->done );
+    free( pool->threads );
+    free( pool );
+}
+
+struct chip8_env *
+chip8_env_create ( const struct chip8 *c8, int n, int threads ) {
+    struct chip8_env *env = calloc( 1, sizeof(struct chip8_env) );
+
+    if ( !env ) { return NULL; }
+    pthread_once( &expand_once, init_expand );
+
+    env->n = n;
+    env->skip = 4;
+    env->obs = CHIP8_ENV_OBS_PIXELS;
+    env->seed = c8->rng;
+
+    env->image = chip8_image_create( c8 );
+    env->machines = calloc( n, sizeof(struct chip8_paged) );
+    env->held = calloc( n, sizeof(u16) );
+    env->episodes = calloc( n, sizeof(unsigned long long) );
+    env->last = calloc( (size_t) n * CHIP8_ENV_PROBES, sizeof(int) );
+    if ( !env->image || !env->machines || !env->held || !env->episodes || !env->last ) {
+        chip8_env_destroy( env );
+        return NULL;
+    }
+    chip8_paged_load( &env->start, env->image, c8 );
+
+    if ( threads <= 0 ) { threads = sysconf(_SC_NPROCESSORS_ONLN); }
+    env->pool = pool_create( env, threads );
+    if ( !env->pool ) {
+        chip8_env_destroy( env );
+        return NULL;
+    }
+    env->threads = env->pool->nthreads + 1;
+
+    chip8_env_reset( env, NULL );
+    return env;
+}
+
+void
+chip8_env_destroy ( struct chip8_env *env ) {
+    if ( env->pool ) { pool_destroy( env->pool ); }
+    if ( env->machines ) {
+        for ( int e = 0; e < env->n; e++ ) { chip8_paged_release( &env->machines[e] ); }
+    }
+    chip8_paged_release( &env->start );
+    chip8_image_destroy( env->image );
+    free( env->machines );
+    free( env->held );
+    free( env->episodes );
+    free( env->last );
+    free( env );
+}
+
+int
+chip8_env_probe ( struct chip8_env *env, int source, u16 addr, float scale, int done ) {
+    if ( env->nprobes == CHIP8_ENV_PROBES ) { return 0; }
+
+    struct chip8_probe *probe = &env->probes[env->nprobes];
+    probe->source = source;
+    probe->addr = addr;
+    probe->scale = scale;
+    probe->done = done;
+
+    for ( int e = 0; e < env->n; e++ ) {
+        env->last[e * CHIP8_ENV_PROBES + env->nprobes] = probe_value( probe, &env->machines[e] );
+    }
+    env->nprobes++;
+    return 1;
+}
+
+void
+chip8_env_set_hook ( struct chip8_env *env, chip8_env_hook hook, void *ctx ) {
+    env->hook = hook;
+    env->hook_ctx = ctx;
+}
+
+void
+chip8_env_seed ( struct chip8_env *env, uint32_t seed ) {
+    env->seed = seed;
+}
+
+size_t
+chip8_env_obs_size ( const struct chip8_env *env ) {
+    return (env->obs == CHIP8_ENV_OBS_PACKED)? CHIP8_DISPLAY_BUF_SIZE :
+                                               CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT;
+}
+
+void
+chip8_env_reset ( struct chip8_env *env, void *obs ) {
+    run_all( env, NULL, obs, NULL, NULL );
+}
+
+void
+chip8_env_step ( struct chip8_env *env, const u16 *actions, void *obs,
+                 float *rewards, u8 *dones ) {
+    run_all( env, actions, obs, rewards, dones );
+}
@@ -0,0 +1,94 @@
+#ifndef _ENV_H_
+#define _ENV_H_
+
+#include "paged.h"
+#include <stddef.h>
+
+/* vectorized environments for driving many copies of one program from
+   training code. every environment is a paged machine forked from the
+   same start state, so a million of them fit in well under a gigabyte.
+   chip8_env_step applies one action per environment, runs each for skip
+   frames and writes observations, rewards and episode ends straight into
+   arrays the caller owns, spread over a pool of worker threads. nothing is
+   allocated per step.
+
+   an action is the mask of keys held down for the step, bit k for key k.
+   an environment whose episode ends is reset before its observation is
+   written, so the observation is the first of the next episode */
+
+#define CHIP8_ENV_PROBES 8
+
+/* observation layouts */
+enum chip8_env_obs {
+	CHIP8_ENV_OBS_PIXELS,  /* 64x32 bytes per environment, 0 or 1, row by row */
+	CHIP8_ENV_OBS_PACKED,  /* 256 bytes per environment as chip8_display_pack */
+};
+
+/* what a probe reads */
+enum chip8_probe_source {
+	CHIP8_PROBE_MEM,  /* the byte at addr */
+	CHIP8_PROBE_V,    /* register V[addr] */
+	CHIP8_PROBE_BCD,  /* the three digits Fx33 left at addr, as 0 to 999 */
+};
+
+/* adds scale times the change in its value over a step to the reward and,
+   unless done is -1, ends the episode once the value equals done */
+struct chip8_probe {
+	int source;
+	u16 addr;
+	float scale;
+	int done;
+};
+
+/* called after every step of every environment, on whichever thread ran
+   it. returns extra reward and can end the episode by setting *done */
+typedef float (*chip8_env_hook) ( void *ctx, int env, const struct chip8_paged *machine, int *done );
+
+struct chip8_env {
+	int n;                         /* number of environments */
+	int skip;                      /* frames per step, default 4 */
+	int obs;                       /* enum chip8_env_obs */
+	unsigned long long max_frames; /* frames an episode may last, 0 for no limit */
+
+	struct chip8_paged *machines;
+	struct chip8_paged start;      /* every episode begins as a fork of this */
+	struct chip8_image *image;
+	u16 *held;                     /* keys down in each environment */
+	unsigned long long *episodes;  /* episodes each environment has started */
+	uint32_t seed;
+
+	struct chip8_probe probes[CHIP8_ENV_PROBES];
+	int nprobes;
+	int *last;                     /* last value of each probe, nprobes per environment */
+	chip8_env_hook hook;
+	void *hook_ctx;
+
+	int threads;                   /* threads stepping them, the caller's included */
+	struct chip8_env_pool *pool;
+};
+
+/* n environments running the program chip8 holds, typically fresh from
+   chip8_init and chip8_load. threads of 0 means one per core. NULL if out
+   of memory */
+struct chip8_env *chip8_env_create ( const struct chip8 *chip8, int n, int threads );
+void chip8_env_destroy ( struct chip8_env *env );
+
+/* add a reward probe, returns 0 if there are CHIP8_ENV_PROBES already */
+int  chip8_env_probe ( struct chip8_env *env, int source, u16 addr, float scale, int done );
+void chip8_env_set_hook ( struct chip8_env *env, chip8_env_hook hook, void *ctx );
+/* episodes of environment e get random number generators seeded from
+   seed, e and the episode number. takes effect on the next reset */
+void chip8_env_seed ( struct chip8_env *env, uint32_t seed );
+
+/* bytes of observation per environment, obs buffers hold n of these */
+size_t chip8_env_obs_size ( const struct chip8_env *env );
+
+/* start a new episode in every environment, writing observations to obs
+   unless it is NULL */
+void chip8_env_reset ( struct chip8_env *env, void *obs );
+/* apply actions[e] to environment e and run it for skip frames. obs,
+   rewards and dones may each be NULL */
+void chip8_env_step ( struct chip8_env *env, const u16 *actions, void *obs,
+                      float *rewards, u8 *dones );
+
+#endif
@@ -0,0 +1,140 @@
+#include "framelog.h"
+#include "rle.h"
+#include <stdlib.h>
+
+static const u8 magic[4] = { 'C', '8', 'F', 'S' };
+
+/* output is gathered here and written once it cannot take another frame */
+#define OUT_SIZE (1 << 16)
+#define OUT_FRAME (3 + RLE_BOUND(CHIP8_DISPLAY_BUF_SIZE))
+
+static int
+keyframe ( int interval, unsigned long index ) {
+    return index == 0 || (interval > 0 && index % interval == 0);
+}
+
+/* code one frame against the one before it into out, returns its size */
+static size_t
+encode ( const u8 *display, const u8 *prev, int key, u8 *out ) {
+    if ( key ) {
+        memcpy( out, display, CHIP8_DISPLAY_BUF_SIZE );
+        return CHIP8_DISPLAY_BUF_SIZE;
+    }
+
+    u8 rle[RLE_BOUND(CHIP8_DISPLAY_BUF_SIZE)];
+    size_t len = rle_encode_xor( display, prev, CHIP8_DISPLAY_BUF_SIZE, rle );
+
+    u8 *p = out;
+    if ( len < 0xFF ) {
+        *p++ = len;
+    } else {
+        *p++ = 0xFF;
+        *p++ = len & 0xFF;
+        *p++ = len >> 8;
+    }
+    memcpy( p, rle, len );
+    return p + len - out;
+}
+
+static size_t
+drain ( struct spool *s, size_t tail, size_t head ) {
+    struct chip8_framelog *log = s->ctx;
+    u8 display[CHIP8_DISPLAY_BUF_SIZE];
+
+    for ( size_t i = tail; i != head; i++ ) {
+        const chip8_row *frame = (const chip8_row *) spool_at( s, i );
+        int key = keyframe( log->interval, i );
+
+        if ( log->used + OUT_FRAME > OUT_SIZE ) {
+            if ( fwrite( log->out, 1, log->used, s->f ) != log->used ) { s->error = 1; }
+            log->used = 0;
+        }
+        /* most frames do not change the display, only pack those that do */
+        if ( !key && memcmp( frame, log->rows, sizeof(log->rows) ) == 0 ) {
+            log->out[log->used++] = 0;
+            continue;
+        }
+        memcpy( log->rows, frame, sizeof(log->rows) );
+        chip8_display_pack_rows( log->rows, display );
+        log->used += encode( display, log->prev, key, log->out + log->used );
+        memcpy( log->prev, display, sizeof(log->prev) );
+    }
+    return head - tail;
+}
+
+static void
+flush ( struct spool *s ) {
+    struct chip8_framelog *log = s->ctx;
+    if ( fwrite( log->out, 1, log->used, s->f ) != log->used ) { s->error = 1; }
+}
+
+struct chip8_framelog *
+chip8_framelog_open ( const char *path, int interval ) {
+    struct chip8_framelog *log = calloc( 1, sizeof(struct chip8_framelog) );
+    u8 header[CHIP8_FRAMELOG_HEADER];
+
+    if ( !log ) { return NULL; }
+    if ( interval < 0 || interval > 0xFFFF ) { interval = CHIP8_FRAMELOG_INTERVAL; }
+    log->interval = interval;
+    log->out = malloc( OUT_SIZE );
+    if ( !log->out ) { goto fail; }
+
+    memcpy( header, magic, 4 );
+    header[4] = CHIP8_FRAMELOG_VERSION & 0xFF; header[5] = CHIP8_FRAMELOG_VERSION >> 8;
+    header[6] = interval & 0xFF;               header[7] = interval >> 8;
+
+    log->spool.drain = drain;
+    log->spool.flush = flush;
+    log->spool.ctx = log;
+    if ( !spool_open( &log->spool, path, sizeof(log->rows), CHIP8_FRAMELOG_RING,
+                      header, sizeof(header) ) ) { goto fail; }
+    return log;
+
+fail:
+    free( log->out );
+    free( log );
+    return NULL;
+}
+
+int
+chip8_framelog_close ( struct chip8_framelog *log ) {
+    int ok = spool_close( &log->spool );
+    free( log->out );
+    free( log );
+    return ok;
+}
+
+int
+chip8_framelog_read_header ( FILE *f, int *interval ) {
+    u8 header[CHIP8_FRAMELOG_HEADER];
+
+    if ( fread( header, 1, sizeof(header), f ) != sizeof(header) ) { return 0; }
+    if ( memcmp( header, magic, 4 ) != 0 ) { return 0; }
+    if ( (header[4] | (header[5] << 8)) != CHIP8_FRAMELOG_VERSION ) { return 0; }
+    *interval = header[6] | (header[7] << 8);
+    return 1;
+}
+
+int
+chip8_framelog_read ( FILE *f, int interval, unsigned long index, u8 *display ) {
+    u8 rle[RLE_BOUND(CHIP8_DISPLAY_BUF_SIZE)];
+    int c;
+
+    if ( keyframe( interval, index ) ) {
+        size_t n = fread( display, 1, CHIP8_DISPLAY_BUF_SIZE, f );
+        if ( n == 0 ) { return 0; }
+        return (n == CHIP8_DISPLAY_BUF_SIZE)? 1 : -1;
+    }
+
+    if ( (c = fgetc( f )) == EOF ) { return 0; }
+    size_t len = c;
+    if ( len == 0xFF ) {
+        int lo = fgetc( f ), hi = fgetc( f );
+        if ( lo == EOF || hi == EOF ) { return -1; }
+        len = lo | (hi << 8);
+    }
+    if ( len == 0 ) { return 1; }
+    if ( len > sizeof(rle) ) { return -1; }
+    if ( fread( rle, 1, len, f ) != len ) { return -1; }
+    return rle_decode_xor( rle, len, display, CHIP8_DISPLAY_BUF_SIZE )? 1 : -1;
+}
@@ -0,0 +1,62 @@
+#ifndef _FRAMELOG_H_
+#define _FRAMELOG_H_
+
+#include "chip8.h"
+#include "spool.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+/* compressed stream of the display after every frame, for keeping the
+   whole picture history of headless runs. chip8_framelog_put only copies
+   the display rows into a spool.h ring. its writer thread packs them,
+   codes each against the previous one and writes the result out in large
+   blocks, so recording costs a 256 byte copy a frame.
+
+   the file is an 8 byte header, "C8FS", version and keyframe interval as
+   little endian u16s, followed by one record per frame. frame 0 and every
+   interval-th frame after it (none if interval is 0) are keyframes, the
+   CHIP8_DISPLAY_BUF_SIZE bytes of chip8_display_pack. every other frame
+   is the XOR against the frame before it, run length coded by rle.h,
+   after a length byte, or 0xFF and a u16 length if it is 0xFF or more.
+   a frame that did not change is a single zero byte */
+
+#define CHIP8_FRAMELOG_VERSION  1
+#define CHIP8_FRAMELOG_HEADER   8
+#define CHIP8_FRAMELOG_INTERVAL 600  /* 10 seconds */
+
+/* ring capacity in frames, a power of two */
+#define CHIP8_FRAMELOG_RING (1 << 14)
+
+struct chip8_framelog {
+	struct spool spool;  /* of one display's rows per slot */
+	int interval;
+
+	/* writer thread: the last frame written, as rows and packed, and the
+	   output gathered for the next write */
+	chip8_row rows[CHIP8_DISPLAY_HEIGHT];
+	u8 prev[CHIP8_DISPLAY_BUF_SIZE];
+	u8 *out;
+	size_t used;
+};
+
+/* create path and start the writer thread, NULL on failure. interval is
+   the number of frames from one keyframe to the next, 0 for just one */
+struct chip8_framelog *chip8_framelog_open ( const char *path, int interval );
+/* write out what is still queued and close the file, 0 if writing failed */
+int  chip8_framelog_close ( struct chip8_framelog *log );
+
+/* read the header of a frame log, 0 if it is not one */
+int  chip8_framelog_read_header ( FILE *f, int *interval );
+/* read frame index, counting from 0, into display which holds frame
+   index - 1 unless index is a keyframe. 1 on success, 0 at the end of the
+   file and -1 if the record is damaged */
+int  chip8_framelog_read ( FILE *f, int interval, unsigned long index, u8 *display );
+
+static inline void
+chip8_framelog_put ( struct chip8_framelog *log, const struct chip8 *c8 ) {
+	memcpy( spool_slot( &log->spool ), c8->display, sizeof(c8->display) );
+	spool_push( &log->spool );
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef _HASH_H_
+#define _HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define FNV1A64_INIT 0xCBF29CE484222325ULL
+
+/* 64-bit FNV-1a, pass FNV1A64_INIT as h or chain the result of a previous
+   call to hash several buffers as one */
+static inline uint64_t
+fnv1a64 ( const void *buf, size_t len, uint64_t h ) {
+    const uint8_t *p = buf;
+    for ( size_t i = 0; i < len; i++ ) {
+        h ^= p[i];
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+/* 8 bytes at a time in four independent lanes, several times faster than
+   fnv1a64 on whole machines. for comparing states within a run, the result
+   depends on the host's byte order */
+static inline uint64_t
+hash64_words ( const void *buf, size_t len, uint64_t h ) {
+    const uint8_t *p = buf;
+    uint64_t lane[4] = { h, h ^ 0x9E3779B97F4A7C15ULL, h ^ 0xC2B2AE3D27D4EB4FULL, h ^ 0x165667B19E3779F9ULL };
+    size_t i = 0;
+
+    for ( ; i + 32 <= len; i += 32 ) {
+        for ( int k = 0; k < 4; k++ ) {
+            uint64_t w;
+            memcpy( &w, p + i + 8 * k, 8 );
+            lane[k] = (lane[k] ^ w) * 0x9E3779B97F4A7C15ULL;
+            lane[k] ^= lane[k] >> 31;
+        }
+    }
+    h = lane[0] ^ (lane[1] * 3) ^ (lane[2] * 5) ^ (lane[3] * 7) ^ len;
+    for ( ; i < len; i++ ) {
+        h = (h ^ p[i]) * 0x100000001B3ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    return h;
+}
+
+#endif
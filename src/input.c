@@ -0,0 +1,147 @@
+#include "input.h"
+#include "hash.h"
+#include "le.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const u8 magic[4] = { 'C', '8', 'I', 'N' };
+
+#define HEADER_SIZE 36
+#define EVENT_SIZE  6
+
+struct chip8_input *
+chip8_input_create ( const struct chip8 *c8 ) {
+    struct chip8_input *log = calloc( 1, sizeof(struct chip8_input) );
+
+    if ( !log ) { return NULL; }
+    log->seed = c8->rng;
+    log->ipf = c8->ipf;
+    log->mem_hash = fnv1a64( c8->mem, CHIP8_MEMORY_CAPACITY, FNV1A64_INIT );
+    return log;
+}
+
+void
+chip8_input_destroy ( struct chip8_input *log ) {
+    free( log->events );
+    free( log );
+}
+
+void
+chip8_input_record ( struct chip8_input *log, unsigned long long frame, int key, int state ) {
+    if ( log->count == log->cap ) {
+        size_t cap = log->cap? log->cap * 2 : 256;
+        struct chip8_input_event *events = realloc( log->events, cap * sizeof(*events) );
+        if ( !events ) { log->error = 1; return; }
+        log->events = events;
+        log->cap = cap;
+    }
+
+    log->events[log->count].frame = frame;
+    log->events[log->count].key = key;
+    log->events[log->count].state = state;
+    log->count++;
+    if ( frame > log->frames ) { log->frames = frame; }
+}
+
+void
+chip8_input_end ( struct chip8_input *log, const struct chip8 *c8 ) {
+    log->frames = c8->frame;
+}
+
+int
+chip8_input_save ( const struct chip8_input *log, const char *path ) {
+    size_t len = HEADER_SIZE + log->count * EVENT_SIZE + 8;
+    u8 *buf, *p;
+
+    /* a log missing an event replays a different session */
+    if ( log->error ) { return 0; }
+    if ( (buf = p = malloc( len )) == NULL ) { return 0; }
+
+    memcpy( p, magic, 4 ); p += 4;
+    p = put16( p, CHIP8_INPUT_VERSION );
+    p = put16( p, 0 );
+    p = put32( p, log->ipf );
+    p = put32( p, log->seed );
+    p = put64( p, log->mem_hash );
+    p = put64( p, log->frames );
+    p = put32( p, log->count );
+    for ( size_t e = 0; e < log->count; e++ ) {
+        p = put32( p, log->events[e].frame );
+        *p++ = log->events[e].key;
+        *p++ = log->events[e].state;
+    }
+    p = put64( p, fnv1a64( buf, p - buf, FNV1A64_INIT ) );
+
+    FILE *f = fopen( path, "wb" );
+    int ok = f && fwrite( buf, 1, len, f ) == len;
+    if ( f && fclose(f) != 0 ) { ok = 0; }
+    free( buf );
+    return ok;
+}
+
+struct chip8_input *
+chip8_input_load ( const char *path ) {
+    struct chip8_input *log = NULL;
+    u8 *buf = NULL;
+    long len;
+    FILE *f = fopen( path, "rb" );
+
+    if ( !f ) { return NULL; }
+    if ( fseek( f, 0, SEEK_END ) != 0 || (len = ftell(f)) < HEADER_SIZE + 8 ) { goto fail; }
+    fseek( f, 0, SEEK_SET );
+    if ( (buf = malloc( len )) == NULL ) { goto fail; }
+    if ( fread( buf, 1, len, f ) != (size_t) len ) { goto fail; }
+
+    if ( memcmp( buf, magic, 4 ) != 0 || get16( buf + 4 ) != CHIP8_INPUT_VERSION ) { goto fail; }
+    size_t count = get32( buf + 32 );
+    uint32_t ipf = get32( buf + 8 );
+    if ( ipf < 1 || ipf > INT_MAX ) { goto fail; }
+    if ( (size_t) len != HEADER_SIZE + count * EVENT_SIZE + 8 ) { goto fail; }
+    if ( get64( buf + len - 8 ) != fnv1a64( buf, len - 8, FNV1A64_INIT ) ) { goto fail; }
+
+    if ( (log = calloc( 1, sizeof(struct chip8_input) )) == NULL ) { goto fail; }
+    log->ipf = ipf;
+    log->seed = get32( buf + 12 );
+    log->mem_hash = get64( buf + 16 );
+    log->frames = get64( buf + 24 );
+    log->count = log->cap = count;
+    log->events = malloc( (count? count : 1) * sizeof(struct chip8_input_event) );
+    if ( !log->events ) { free( log ); log = NULL; goto fail; }
+
+    const u8 *p = buf + HEADER_SIZE;
+    for ( size_t e = 0; e < count; e++, p += EVENT_SIZE ) {
+        log->events[e].frame = get32( p );
+        log->events[e].key = p[4] & 0xF;
+        log->events[e].state = p[5];
+    }
+
+fail:
+    free( buf );
+    fclose( f );
+    return log;
+}
+
+int
+chip8_input_start ( struct chip8_input *log, struct chip8 *c8 ) {
+    if ( fnv1a64( c8->mem, CHIP8_MEMORY_CAPACITY, FNV1A64_INIT ) != log->mem_hash ) { return 0; }
+
+    chip8_seed( c8, log->seed );
+    c8->ipf = log->ipf;
+    log->next = 0;
+    return 1;
+}
+
+void
+chip8_input_apply ( struct chip8_input *log, struct chip8 *c8 ) {
+    while ( log->next < log->count && log->events[log->next].frame <= c8->frame ) {
+        const struct chip8_input_event *e = &log->events[log->next++];
+        chip8_key_set_state( c8, e->key, e->state );
+    }
+}
+
+int
+chip8_input_done ( const struct chip8_input *log, const struct chip8 *c8 ) {
+    return c8->frame >= log->frames;
+}
@@ -0,0 +1,58 @@
+#ifndef _INPUT_H_
+#define _INPUT_H_
+
+#include "chip8.h"
+#include <stddef.h>
+
+/* frame indexed input logs. with chip8->input set, every key change made
+   through chip8_key_set_state is recorded against chip8->frame. together
+   with the seed, ipf and initial memory this is enough to replay a session
+   exactly, at any speed.
+
+   file layout, little endian: "C8IN", u16 version, u16 reserved, u32 ipf,
+   u32 seed, u64 FNV-1a of the initial memory, u64 frames, u32 event count, then per
+   event u32 frame, u8 key, u8 state, and a u64 FNV-1a of everything before */
+
+#define CHIP8_INPUT_VERSION 2
+
+struct chip8_input_event {
+	uint32_t frame;  /* frame the key changed before */
+	u8 key;
+	u8 state;        /* CHIP8_KEY_DOWN or CHIP8_KEY_UP */
+};
+
+struct chip8_input {
+	uint32_t seed;
+	int ipf;
+	uint64_t mem_hash;
+	unsigned long long frames;  /* length of the session */
+
+	struct chip8_input_event *events;
+	size_t count, cap;
+	size_t next;                /* next event chip8_input_apply replays */
+	int error;                  /* an event could not be recorded */
+};
+
+/* start a log of a machine fresh from chip8_init, chip8_load and any
+   chip8_seed. set chip8->input to it to record. NULL if out of memory */
+struct chip8_input *chip8_input_create ( const struct chip8 *chip8 );
+void chip8_input_destroy ( struct chip8_input *log );
+
+void chip8_input_record ( struct chip8_input *log, unsigned long long frame, int key, int state );
+/* mark the end of the session at the machine's current frame */
+void chip8_input_end ( struct chip8_input *log, const struct chip8 *chip8 );
+
+/* 0 if path could not be written or an event was lost while recording */
+int  chip8_input_save ( const struct chip8_input *log, const char *path );
+/* NULL if path is not a valid log */
+struct chip8_input *chip8_input_load ( const char *path );
+
+/* seed a machine fresh from chip8_init and chip8_load and set its ipf to
+   replay log. returns 0 if its memory differs from the recorded one */
+int  chip8_input_start ( struct chip8_input *log, struct chip8 *chip8 );
+/* apply the key changes due before the machine's next frame */
+void chip8_input_apply ( struct chip8_input *log, struct chip8 *chip8 );
+/* 1 once the machine has run every frame of the session */
+int  chip8_input_done ( const struct chip8_input *log, const struct chip8 *chip8 );
+
+#endif
@@ -0,0 +1,638 @@
+#include "engine.h"
+
+#if CHIP8_HAVE_JIT
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <sys/mman.h>
+
+/* basic block recompiler for x86-64. straight-line runs of instructions are
+   translated into a native function taking the struct chip8 in rdi. within a
+   block pc is a translation time constant, I lives in r8d and the V registers
+   a block touches are loaded into host registers on entry and written back
+   on exit. a block ends after a jump, call, return or skip, or just before an
+   instruction the translator leaves to chip8_step: CLS, RND, DRW, the two
+   instructions that can stop the run loop, LD Vx, K and LD ST, Vx, and the
+   two instructions that write memory, LD B, Vx and LD [I], Vx.
+
+   since only chip8_step ever writes to mem, the run loop checks the target of
+   every LD B / LD [I] it hands over and throws the whole translation cache
+   away when the write lands on translated code */
+
+#define JIT_CODE_SIZE   (1 << 20)
+#define JIT_BLOCK_MAX   64           /* instructions per block */
+#define JIT_OP_BYTES    256          /* per instruction, LD VA, [I] takes 227 */
+#define JIT_FRAME_BYTES 512          /* register loads, stores and saves */
+/* worst case native code per block, translate flushes the cache unless
+   this much is left */
+#define JIT_BLOCK_BYTES (JIT_BLOCK_MAX * JIT_OP_BYTES + JIT_FRAME_BYTES)
+
+/* x86 register numbers */
+enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+/* registers handed out to V registers, caller saved ones first */
+static const u8 pool[] = { RCX, RSI, R9, R10, R11, RBX, RBP, R12, R13, R14, R15 };
+#define POOL_SIZE (sizeof(pool)/sizeof(pool[0]))
+
+/* condition codes */
+#define CC_B  0x2
+#define CC_E  0x4
+#define CC_NE 0x5
+#define CC_S  0x8
+
+/* register holding I */
+#define REG_I R8
+
+#define OFF(field) ((int) offsetof(struct chip8, field))
+
+typedef void (*block_fn) ( struct chip8 *c8 );
+
+enum { BLOCK_NONE, BLOCK_NATIVE, BLOCK_INTERPRET };
+
+struct block {
+    block_fn fn;
+    u16 count;  /* instructions executed by fn */
+    u8  state;
+};
+
+struct jit {
+    u8 *code;
+    size_t used;
+
+    struct block blocks[CHIP8_MEMORY_CAPACITY];
+    /* bytes of mem that some translated block was built from */
+    u8 covered[CHIP8_MEMORY_CAPACITY];
+};
+
+/* emitter state for one block */
+struct emit {
+    u8 *p;
+    signed char host[16]; /* host register of each V register, -1 if unused */
+    u16 written;    /* V registers written by the block */
+    int writes_i;
+};
+
+/* ---- instruction encoding ---- */
+
+static void emit8 ( struct emit *e, u8 b ) { *e->p++ = b; }
+static void emit16 ( struct emit *e, u16 w ) { memcpy( e->p, &w, 2 ); e->p += 2; }
+static void emit32 ( struct emit *e, uint32_t d ) { memcpy( e->p, &d, 4 ); e->p += 4; }
+
+/* REX prefix, force emits it even when no bits are set so that byte
+   operations address sil, dil, bpl and spl instead of dh, bh, ch and ah */
+static void
+rex ( struct emit *e, int w, int r, int x, int b, int force ) {
+    u8 v = 0x40 | (w << 3) | ((r >> 3) << 2) | ((x >> 3) << 1) | (b >> 3);
+    if ( v != 0x40 || force ) { emit8( e, v ); }
+}
+
+static void
+modrm_rr ( struct emit *e, int reg, int rm ) {
+    emit8( e, 0xC0 | ((reg & 7) << 3) | (rm & 7) );
+}
+
+/* [rdi + disp32] */
+static void
+modrm_rdi ( struct emit *e, int reg, int disp ) {
+    emit8( e, 0x80 | ((reg & 7) << 3) | RDI );
+    emit32( e, disp );
+}
+
+/* [rdi + index*scale + disp32], scale given as shift */
+static void
+modrm_rdi_idx ( struct emit *e, int reg, int index, int shift, int disp ) {
+    emit8( e, 0x84 | ((reg & 7) << 3) );
+    emit8( e, (shift << 6) | ((index & 7) << 3) | RDI );
+    emit32( e, disp );
+}
+
+/* op r/m8, r8 for add 00, or 08, and 20, sub 28, xor 30, cmp 38, mov 88 */
+static void
+alu8_rr ( struct emit *e, u8 opc, int dst, int src ) {
+    rex( e, 0, src, 0, dst, 1 );
+    emit8( e, opc );
+    modrm_rr( e, src, dst );
+}
+
+/* op r/m32, r32 for add 01, or 09, and 21, sub 29, xor 31, cmp 39, mov 89 */
+static void
+alu32_rr ( struct emit *e, u8 opc, int dst, int src ) {
+    rex( e, 0, src, 0, dst, 0 );
+    emit8( e, opc );
+    modrm_rr( e, src, dst );
+}
+
+/* group 1 op r/m8, imm8: add /0, or /1, and /4, sub /5, xor /6, cmp /7 */
+static void
+alu8_ri ( struct emit *e, int digit, int dst, u8 imm ) {
+    rex( e, 0, 0, 0, dst, 1 );
+    emit8( e, 0x80 );
+    modrm_rr( e, digit, dst );
+    emit8( e, imm );
+}
+
+/* group 1 op r/m32, imm8 sign extended */
+static void
+alu32_ri8 ( struct emit *e, int digit, int dst, int imm ) {
+    rex( e, 0, 0, 0, dst, 0 );
+    emit8( e, 0x83 );
+    modrm_rr( e, digit, dst );
+    emit8( e, (u8) imm );
+}
+
+/* shl r/m8, 1 is /4, shr r/m8, 1 is /5 */
+static void
+shift8 ( struct emit *e, int digit, int dst ) {
+    rex( e, 0, 0, 0, dst, 1 );
+    emit8( e, 0xD0 );
+    modrm_rr( e, digit, dst );
+}
+
+static void
+mov32_ri ( struct emit *e, int dst, uint32_t imm ) {
+    rex( e, 0, 0, 0, dst, 0 );
+    emit8( e, 0xB8 | (dst & 7) );
+    emit32( e, imm );
+}
+
+/* movzx r32, byte [rdi + disp] */
+static void
+load8 ( struct emit *e, int dst, int disp ) {
+    rex( e, 0, dst, 0, RDI, 0 );
+    emit8( e, 0x0F ); emit8( e, 0xB6 );
+    modrm_rdi( e, dst, disp );
+}
+
+/* movzx r32, word [rdi + disp] */
+static void
+load16 ( struct emit *e, int dst, int disp ) {
+    rex( e, 0, dst, 0, RDI, 0 );
+    emit8( e, 0x0F ); emit8( e, 0xB7 );
+    modrm_rdi( e, dst, disp );
+}
+
+/* mov byte [rdi + disp], r8 */
+static void
+store8 ( struct emit *e, int disp, int src ) {
+    rex( e, 0, src, 0, RDI, 1 );
+    emit8( e, 0x88 );
+    modrm_rdi( e, src, disp );
+}
+
+/* mov word [rdi + disp], r16 */
+static void
+store16 ( struct emit *e, int disp, int src ) {
+    emit8( e, 0x66 );
+    rex( e, 0, src, 0, RDI, 0 );
+    emit8( e, 0x89 );
+    modrm_rdi( e, src, disp );
+}
+
+/* mov word [rdi + disp], imm16 */
+static void
+store16_i ( struct emit *e, int disp, u16 imm ) {
+    emit8( e, 0x66 ); emit8( e, 0xC7 );
+    modrm_rdi( e, 0, disp );
+    emit16( e, imm );
+}
+
+/* setcc al */
+static void
+setcc_al ( struct emit *e, int cc ) {
+    emit8( e, 0x0F ); emit8( e, 0x90 | cc ); emit8( e, 0xC0 );
+}
+
+static void
+push ( struct emit *e, int r ) {
+    rex( e, 0, 0, 0, r, 0 );
+    emit8( e, 0x50 | (r & 7) );
+}
+
+static void
+pop ( struct emit *e, int r ) {
+    rex( e, 0, 0, 0, r, 0 );
+    emit8( e, 0x58 | (r & 7) );
+}
+
+/* ---- translation ---- */
+
+#define VX(e, x) ((e)->host[(x)])
+
+static int
+is_callee_saved ( int r ) {
+    return r == RBX || r == RBP || r >= R12;
+}
+
+/* true if the instruction is left to chip8_step */
+static int
+interpreted ( u16 opcode ) {
+    switch ( opcode & 0xF000 ) {
+        case 0x0000: return opcode == 0x00E0;
+        case 0xC000: return 1;
+        case 0xD000: return 1;
+        case 0xF000:
+            switch ( opcode & 0x00FF ) {
+                case 0x000A: case 0x0018: case 0x0033: case 0x0055: return 1;
+            }
+            return 0;
+    }
+    return 0;
+}
+
+/* true if the instruction ends a block */
+static int
+terminates ( u16 opcode ) {
+    switch ( opcode & 0xF000 ) {
+        case 0x0000: return opcode != 0x00E0;   /* RET and SYS */
+        case 0x1000: case 0x2000: case 0x3000: case 0x4000:
+        case 0x5000: case 0x9000: case 0xB000: case 0xE000:
+            return 1;
+    }
+    return 0;
+}
+
+/* mask of V registers an instruction reads or writes */
+static u16
+regs_used ( u16 opcode ) {
+    u8 x = (opcode >> 8) & 0xF;
+    u8 y = (opcode >> 4) & 0xF;
+
+    switch ( opcode & 0xF000 ) {
+        case 0x3000: case 0x4000: case 0x6000: case 0x7000:
+            return 1 << x;
+        case 0x5000: case 0x9000:
+            return (1 << x) | (1 << y);
+        case 0x8000:
+            switch ( opcode & 0x000F ) {
+                case 0x0: case 0x1: case 0x2: case 0x3:
+                    return (1 << x) | (1 << y);
+                case 0x4: case 0x5: case 0x6: case 0x7: case 0xE:
+                    return (1 << x) | (1 << y) | (1 << 0xF);
+            }
+            return 0;
+        case 0xB000:
+            return 1;
+        case 0xE000:
+            switch ( opcode & 0x00FF ) {
+                case 0x009E: case 0x00A1: return 1 << x;
+            }
+            return 0;
+        case 0xF000:
+            switch ( opcode & 0x00FF ) {
+                case 0x0007: case 0x0015: case 0x0018: case 0x001E: case 0x0029:
+                    return 1 << x;
+                case 0x0065:
+                    return (u16) ((2 << x) - 1);
+            }
+            return 0;
+    }
+    return 0;
+}
+
+static int
+popcount16 ( u16 m ) {
+    int n = 0;
+    for ( ; m; m &= m - 1 ) { n++; }
+    return n;
+}
+
+/* set pc to skip when the flags satisfy cc, next otherwise */
+static void
+emit_skip ( struct emit *e, int cc, u16 next ) {
+    mov32_ri( e, RAX, next );
+    mov32_ri( e, RDX, (next + 2) & CHIP8_ADDR_MASK );
+    emit8( e, 0x0F ); emit8( e, 0x40 | cc ); modrm_rr( e, RAX, RDX );
+    store16( e, OFF(pc), RAX );
+}
+
+/* translate one instruction. next is the address following it. returns 1
+   if the instruction has set pc itself */
+static int
+translate_op ( struct emit *e, u16 opcode, u16 next ) {
+    u8  byte = opcode & 0xFF;
+    u16 word = opcode & 0xFFF;
+    u8  x    = (opcode >> 8) & 0xF;
+    u8  y    = (opcode >> 4) & 0xF;
+    int vx = VX(e, x), vy = VX(e, y), vf = VX(e, 0xF);
+
+    switch ( opcode & 0xF000 ) {
+        case 0x0000:
+            if ( opcode == 0x00EE ) {
+                /* sp = (sp - 1) & 15; pc = stack[sp] */
+                load8( e, RAX, OFF(sp) );
+                emit8( e, 0xFF ); emit8( e, 0xC8 );
+                alu32_ri8( e, 4, RAX, CHIP8_STACK_MASK );
+                store8( e, OFF(sp), RAX );
+                emit8( e, 0x0F ); emit8( e, 0xB7 );
+                modrm_rdi_idx( e, RAX, RAX, 1, OFF(stack) );
+                store16( e, OFF(pc), RAX );
+            } else {
+                store16_i( e, OFF(pc), word );
+            }
+            return 1;
+        case 0x1000:
+            store16_i( e, OFF(pc), word );
+            return 1;
+        case 0x2000:
+            /* stack[sp] = next; sp = (sp + 1) & 15; pc = word */
+            load8( e, RAX, OFF(sp) );
+            emit8( e, 0x66 ); emit8( e, 0xC7 );
+            modrm_rdi_idx( e, 0, RAX, 1, OFF(stack) );
+            emit16( e, next );
+            emit8( e, 0xFF ); emit8( e, 0xC0 );
+            alu32_ri8( e, 4, RAX, CHIP8_STACK_MASK );
+            store8( e, OFF(sp), RAX );
+            store16_i( e, OFF(pc), word );
+            return 1;
+        case 0x3000:
+        case 0x4000:
+            alu8_ri( e, 7, vx, byte );
+            emit_skip( e, ((opcode & 0xF000) == 0x3000)? CC_E : CC_NE, next );
+            return 1;
+        case 0x5000:
+        case 0x9000:
+            alu8_rr( e, 0x38, vx, vy );
+            emit_skip( e, ((opcode & 0xF000) == 0x5000)? CC_E : CC_NE, next );
+            return 1;
+        case 0x6000:
+            mov32_ri( e, vx, byte );
+            e->written |= 1 << x;
+            return 0;
+        case 0x7000:
+            alu8_ri( e, 0, vx, byte );
+            e->written |= 1 << x;
+            return 0;
+        case 0x8000:
+            switch ( opcode & 0x000F ) {
+                case 0x0: alu32_rr( e, 0x89, vx, vy ); break;
+                case 0x1: alu32_rr( e, 0x09, vx, vy ); break;
+                case 0x2: alu32_rr( e, 0x21, vx, vy ); break;
+                case 0x3: alu32_rr( e, 0x31, vx, vy ); break;
+                case 0x4:
+                    /* VF = carry of Vx + Vy, then Vx += Vy */
+                    alu32_rr( e, 0x89, RAX, vx );
+                    alu8_rr( e, 0x00, RAX, vy );
+                    setcc_al( e, CC_B );
+                    alu8_rr( e, 0x88, vf, RAX );
+                    alu8_rr( e, 0x00, vx, vy );
+                    break;
+                case 0x5:
+                    /* VF = Vy < Vx, then Vx -= Vy */
+                    alu8_rr( e, 0x38, vy, vx );
+                    setcc_al( e, CC_B );
+                    alu8_rr( e, 0x88, vf, RAX );
+                    alu8_rr( e, 0x28, vx, vy );
+                    break;
+                case 0x6:
+                    /* VF = Vx & 1, then Vx >>= 1 */
+                    alu32_rr( e, 0x89, RAX, vx );
+                    alu32_ri8( e, 4, RAX, 0x01 );
+                    alu8_rr( e, 0x88, vf, RAX );
+                    shift8( e, 5, vx );
+                    break;
+                case 0x7:
+                    /* VF = Vx < Vy, then Vx = Vy - Vx */
+                    alu8_rr( e, 0x38, vx, vy );
+                    setcc_al( e, CC_B );
+                    alu8_rr( e, 0x88, vf, RAX );
+                    alu32_rr( e, 0x89, RAX, vy );
+                    alu8_rr( e, 0x28, RAX, vx );
+                    alu8_rr( e, 0x88, vx, RAX );
+                    break;
+                case 0xE:
+                    /* VF = Vx & 0x80, then Vx <<= 1 */
+                    alu32_rr( e, 0x89, RAX, vx );
+                    emit8( e, 0x25 ); emit32( e, 0x80 );
+                    alu8_rr( e, 0x88, vf, RAX );
+                    shift8( e, 4, vx );
+                    break;
+                default:
+                    return 0;
+            }
+            e->written |= 1 << x;
+            if ( (opcode & 0x000F) >= 0x4 ) { e->written |= 1 << 0xF; }
+            return 0;
+        case 0xA000:
+            mov32_ri( e, REG_I, word );
+            e->writes_i = 1;
+            return 0;
+        case 0xB000:
+            /* pc = (word + V0) & 0xFFF */
+            alu32_rr( e, 0x89, RAX, VX(e, 0) );
+            emit8( e, 0x05 ); emit32( e, word );
+            emit8( e, 0x25 ); emit32( e, CHIP8_ADDR_MASK );
+            store16( e, OFF(pc), RAX );
+            return 1;
+        case 0xE000:
+            if ( byte != 0x9E && byte != 0xA1 ) {
+                store16_i( e, OFF(pc), next );
+                return 1;
+            }
+            /* mov eax, Vx; and eax, 15; cmp byte [keyboard + rax], KEY_DOWN */
+            alu32_rr( e, 0x89, RAX, vx );
+            alu32_ri8( e, 4, RAX, 0xF );
+            emit8( e, 0x80 );
+            modrm_rdi_idx( e, 7, RAX, 0, OFF(keyboard) );
+            emit8( e, CHIP8_KEY_DOWN );
+            emit_skip( e, (byte == 0x9E)? CC_E : CC_NE, next );
+            return 1;
+        case 0xF000:
+            switch ( byte ) {
+                case 0x07:
+                    load8( e, vx, OFF(dt) );
+                    e->written |= 1 << x;
+                    break;
+                case 0x15:
+                    store8( e, OFF(dt), vx );
+                    break;
+                case 0x1E:
+                    /* add r8d, Vx; movzx r8d, r8w */
+                    alu32_rr( e, 0x01, REG_I, vx );
+                    rex( e, 0, REG_I, 0, REG_I, 0 );
+                    emit8( e, 0x0F ); emit8( e, 0xB7 ); modrm_rr( e, REG_I, REG_I );
+                    e->writes_i = 1;
+                    break;
+                case 0x29:
+                    /* I = (Vx % 16) * 5 via lea r8d, [rax + rax*4] */
+                    alu32_rr( e, 0x89, RAX, vx );
+                    alu32_ri8( e, 4, RAX, 0xF );
+                    rex( e, 0, REG_I, 0, 0, 0 );
+                    emit8( e, 0x8D ); emit8( e, 0x04 | ((REG_I & 7) << 3) ); emit8( e, 0x80 );
+                    e->writes_i = 1;
+                    break;
+                case 0x65:
+                    /* Vk = mem[(I + k) & 0xFFF] for k = 0..x */
+                    for ( int k = 0; k <= x; k++ ) {
+                        rex( e, 0, RAX, 0, REG_I, 0 );
+                        emit8( e, 0x8D ); emit8( e, 0x80 | (REG_I & 7) ); emit32( e, k );
+                        emit8( e, 0x25 ); emit32( e, CHIP8_ADDR_MASK );
+                        rex( e, 0, VX(e, k), RAX, RDI, 0 );
+                        emit8( e, 0x0F ); emit8( e, 0xB6 );
+                        modrm_rdi_idx( e, VX(e, k), RAX, 0, OFF(mem) );
+                        e->written |= 1 << k;
+                    }
+                    break;
+            }
+            return 0;
+    }
+    return 0;
+}
+
+static u16
+fetch ( const struct chip8 *c8, u16 addr ) {
+    return (c8->mem[addr] << 8) | c8->mem[(addr + 1) & CHIP8_ADDR_MASK];
+}
+
+static void
+jit_flush ( void *ctx ) {
+    struct jit *j = ctx;
+    j->used = 0;
+    memset( j->blocks, 0, sizeof(j->blocks) );
+    memset( j->covered, 0, sizeof(j->covered) );
+}
+
+/* translate the block starting at start, leaves it BLOCK_INTERPRET when the
+   first instruction has to go through chip8_step */
+static void
+translate ( struct jit *j, const struct chip8 *c8, u16 start ) {
+    struct block *b = &j->blocks[start];
+    struct emit e;
+    u16 used = 0, addr = start;
+    int count = 0, term = 0;
+
+    if ( j->used + JIT_BLOCK_BYTES > JIT_CODE_SIZE ) { jit_flush( j ); }
+
+    /* first pass: find the extent of the block and the registers it needs */
+    while ( count < JIT_BLOCK_MAX ) {
+        u16 opcode = fetch( c8, addr );
+        u16 regs = used | regs_used( opcode );
+        if ( interpreted( opcode ) || popcount16( regs ) > POOL_SIZE ) { break; }
+        used = regs;
+        count++;
+        addr = (addr + 2) & CHIP8_ADDR_MASK;
+        if ( terminates( opcode ) ) { term = 1; break; }
+    }
+
+    if ( count == 0 ) {
+        b->state = BLOCK_INTERPRET;
+        return;
+    }
+
+    memset( &e, 0, sizeof(e) );
+    memset( e.host, -1, sizeof(e.host) );
+    e.p = j->code + j->used;
+
+    /* hand out host registers and save the callee saved ones we take */
+    for ( int r = 0, h = 0; r < 16; r++ ) {
+        if ( used & (1 << r) ) { e.host[r] = pool[h++]; }
+    }
+    for ( int r = 0; r < 16; r++ ) {
+        if ( e.host[r] >= 0 && is_callee_saved( e.host[r] ) ) { push( &e, e.host[r] ); }
+    }
+    for ( int r = 0; r < 16; r++ ) {
+        if ( e.host[r] >= 0 ) { load8( &e, e.host[r], OFF(v) + r ); }
+    }
+    load16( &e, REG_I, OFF(i) );
+
+    /* second pass: translate */
+    addr = start;
+    for ( int k = 0; k < count; k++ ) {
+        u16 opcode = fetch( c8, addr );
+        u16 next = (addr + 2) & CHIP8_ADDR_MASK;
+        j->covered[addr] = j->covered[(addr + 1) & CHIP8_ADDR_MASK] = 1;
+        term = translate_op( &e, opcode, next );
+        addr = next;
+    }
+    if ( !term ) { store16_i( &e, OFF(pc), addr ); }
+
+    /* write back and return */
+    for ( int r = 0; r < 16; r++ ) {
+        if ( e.written & (1 << r) ) { store8( &e, OFF(v) + r, e.host[r] ); }
+    }
+    if ( e.writes_i ) { store16( &e, OFF(i), REG_I ); }
+    for ( int r = 15; r >= 0; r-- ) {
+        if ( e.host[r] >= 0 && is_callee_saved( e.host[r] ) ) { pop( &e, e.host[r] ); }
+    }
+    emit8( &e, 0xC3 );
+
+    b->fn = (block_fn) (void *) (j->code + j->used);
+    b->count = count;
+    b->state = BLOCK_NATIVE;
+    j->used = e.p - j->code;
+}
+
+/* run one instruction through chip8_step and drop the translation cache if
+   it wrote over translated code */
+static void
+interpret ( struct jit *j, struct chip8 *c8 ) {
+    u16 opcode = fetch( c8, c8->pc );
+    u16 addr = c8->i;
+    int len = 0;
+
+    if ( (opcode & 0xF0FF) == 0xF033 ) { len = 3; }
+    if ( (opcode & 0xF0FF) == 0xF055 ) { len = ((opcode >> 8) & 0xF) + 1; }
+
+    chip8_step( c8 );
+
+    for ( int k = 0; k < len; k++ ) {
+        if ( j->covered[(addr + k) & CHIP8_ADDR_MASK] ) {
+            jit_flush( j );
+            break;
+        }
+    }
+}
+
+static void *
+jit_create ( void ) {
+    struct jit *j = calloc( 1, sizeof(struct jit) );
+    if ( !j ) { return NULL; }
+
+    j->code = mmap( NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if ( j->code == MAP_FAILED ) {
+        free( j );
+        return NULL;
+    }
+
+    return j;
+}
+
+static void
+jit_destroy ( void *ctx ) {
+    struct jit *j = ctx;
+    munmap( j->code, JIT_CODE_SIZE );
+    free( j );
+}
+
+static unsigned long
+jit_run ( void *ctx, struct chip8 *c8, unsigned long cycles ) {
+    struct jit *j = ctx;
+    unsigned long budget = cycles;
+
+    c8->yield = 0;
+    while ( cycles ) {
+        struct block *b = &j->blocks[c8->pc];
+
+        if ( b->state == BLOCK_NONE ) { translate( j, c8, c8->pc ); }
+
+        /* a block runs to completion, finish off the budget one
+           instruction at a time when it does not fit */
+        if ( b->state == BLOCK_NATIVE && b->count <= cycles ) {
+            b->fn( c8 );
+            cycles -= b->count;
+        } else {
+            interpret( j, c8 );
+            cycles--;
+            if ( c8->yield ) { break; }
+        }
+    }
+
+    return budget - cycles;
+}
+
+const struct chip8_engine chip8_engine_jit = {
+    "jit", jit_create, jit_destroy, jit_flush, jit_run, NULL
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef _LE_H_
+#define _LE_H_
+
+#include <stdint.h>
+
+/* little endian integers in byte buffers, for the save state, input log and
+   rom pack formats. put* return the byte after the one written */
+
+static inline uint8_t *
+put16 ( uint8_t *p, uint16_t v ) {
+    p[0] = v; p[1] = v >> 8;
+    return p + 2;
+}
+
+static inline uint8_t *
+put32 ( uint8_t *p, uint32_t v ) {
+    p = put16( p, v );
+    return put16( p, v >> 16 );
+}
+
+static inline uint8_t *
+put64 ( uint8_t *p, uint64_t v ) {
+    p = put32( p, v );
+    return put32( p, v >> 32 );
+}
+
+static inline uint16_t
+get16 ( const uint8_t *p ) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t
+get32 ( const uint8_t *p ) {
+    return get16( p ) | ((uint32_t) get16( p + 2 ) << 16);
+}
+
+static inline uint64_t
+get64 ( const uint8_t *p ) {
+    return get32( p ) | ((uint64_t) get32( p + 4 ) << 32);
+}
+
+#endif
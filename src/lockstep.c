@@ -0,0 +1,429 @@
+#include "lockstep.h"
+#include "profile.h"
+#include <stdlib.h>
+#include <memory.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define LOCKSTEP_X86 1
+#include <immintrin.h>
+#else
+#define LOCKSTEP_X86 0
+#endif
+
+/* lanes are padded to a multiple of the widest vector */
+#define LANE_ALIGN 32
+
+/* ---- plain C kernels, one lane per "vector" ---- */
+
+#define KFN(name)    name##_generic
+#define KATTR
+#define VW           1
+#define VEC          u8
+#define LOAD(p)      (*(p))
+#define STORE(p, a)  (*(p) = (a))
+#define SET1(b)      ((u8) (b))
+#define ADD(a, b)    ((u8) ((a) + (b)))
+#define SUB(a, b)    ((u8) ((a) - (b)))
+#define ADDS(a, b)   ((u8) (((a) + (b) > 0xFF)? 0xFF : (a) + (b)))
+#define SUBS(a, b)   ((u8) (((a) > (b))? (a) - (b) : 0))
+#define AND(a, b)    ((u8) ((a) & (b)))
+#define OR(a, b)     ((u8) ((a) | (b)))
+#define XOR(a, b)    ((u8) ((a) ^ (b)))
+#define ANDNOT(a, b) ((u8) (~(a) & (b)))
+#define CMPEQ(a, b)  ((u8) (((a) == (b))? 0xFF : 0))
+#define SHR1(a)      ((u8) ((a) >> 1))
+#define ANY(a)       (a)
+#include "lockstep_kernels.h"
+#undef KFN
+#undef KATTR
+#undef VW
+#undef VEC
+#undef LOAD
+#undef STORE
+#undef SET1
+#undef ADD
+#undef SUB
+#undef ADDS
+#undef SUBS
+#undef AND
+#undef OR
+#undef XOR
+#undef ANDNOT
+#undef CMPEQ
+#undef SHR1
+#undef ANY
+
+#if LOCKSTEP_X86
+
+/* ---- SSE2, 16 lanes per vector ---- */
+
+#define KFN(name)    name##_sse2
+#define KATTR        __attribute__((target("sse2")))
+#define VW           16
+#define VEC          __m128i
+#define LOAD(p)      _mm_load_si128( (const __m128i *) (p) )
+#define STORE(p, a)  _mm_store_si128( (__m128i *) (p), (a) )
+#define SET1(b)      _mm_set1_epi8( (char) (b) )
+#define ADD(a, b)    _mm_add_epi8( (a), (b) )
+#define SUB(a, b)    _mm_sub_epi8( (a), (b) )
+#define ADDS(a, b)   _mm_adds_epu8( (a), (b) )
+#define SUBS(a, b)   _mm_subs_epu8( (a), (b) )
+#define AND(a, b)    _mm_and_si128( (a), (b) )
+#define OR(a, b)     _mm_or_si128( (a), (b) )
+#define XOR(a, b)    _mm_xor_si128( (a), (b) )
+#define ANDNOT(a, b) _mm_andnot_si128( (a), (b) )
+#define CMPEQ(a, b)  _mm_cmpeq_epi8( (a), (b) )
+#define SHR1(a)      _mm_and_si128( _mm_srli_epi16( (a), 1 ), _mm_set1_epi8(0x7F) )
+#define ANY(a)       _mm_movemask_epi8( (a) )
+#include "lockstep_kernels.h"
+#undef KFN
+#undef KATTR
+#undef VW
+#undef VEC
+#undef LOAD
+#undef STORE
+#undef SET1
+#undef ADD
+#undef SUB
+#undef ADDS
+#undef SUBS
+#undef AND
+#undef OR
+#undef XOR
+#undef ANDNOT
+#undef CMPEQ
+#undef SHR1
+#undef ANY
+
+/* ---- AVX2, 32 lanes per vector ---- */
+
+#define KFN(name)    name##_avx2
+#define KATTR        __attribute__((target("avx2")))
+#define VW           32
+#define VEC          __m256i
+#define LOAD(p)      _mm256_load_si256( (const __m256i *) (p) )
+#define STORE(p, a)  _mm256_store_si256( (__m256i *) (p), (a) )
+#define SET1(b)      _mm256_set1_epi8( (char) (b) )
+#define ADD(a, b)    _mm256_add_epi8( (a), (b) )
+#define SUB(a, b)    _mm256_sub_epi8( (a), (b) )
+#define ADDS(a, b)   _mm256_adds_epu8( (a), (b) )
+#define SUBS(a, b)   _mm256_subs_epu8( (a), (b) )
+#define AND(a, b)    _mm256_and_si256( (a), (b) )
+#define OR(a, b)     _mm256_or_si256( (a), (b) )
+#define XOR(a, b)    _mm256_xor_si256( (a), (b) )
+#define ANDNOT(a, b) _mm256_andnot_si256( (a), (b) )
+#define CMPEQ(a, b)  _mm256_cmpeq_epi8( (a), (b) )
+#define SHR1(a)      _mm256_and_si256( _mm256_srli_epi16( (a), 1 ), _mm256_set1_epi8(0x7F) )
+#define ANY(a)       _mm256_movemask_epi8( (a) )
+#include "lockstep_kernels.h"
+#undef KFN
+#undef KATTR
+#undef VW
+#undef VEC
+#undef LOAD
+#undef STORE
+#undef SET1
+#undef ADD
+#undef SUB
+#undef ADDS
+#undef SUBS
+#undef AND
+#undef OR
+#undef XOR
+#undef ANDNOT
+#undef CMPEQ
+#undef SHR1
+#undef ANY
+
+#endif
+
+struct kernels {
+    const char *name;
+    void (*alu) ( int op, u8 *vx, u8 *vy, u8 *vf, int n );
+    void (*addi) ( u8 *vx, u8 byte, int n );
+    int  (*any_eq) ( const u8 *a, u8 value, int n );
+    void (*tick) ( u8 *dt, u8 *st, int n );
+};
+
+static const struct kernels kernels_generic = {
+    "generic", alu_generic, addi_generic, any_eq_generic, tick_generic
+};
+
+#if LOCKSTEP_X86
+static const struct kernels kernels_sse2 = {
+    "sse2", alu_sse2, addi_sse2, any_eq_sse2, tick_sse2
+};
+
+static const struct kernels kernels_avx2 = {
+    "avx2", alu_avx2, addi_avx2, any_eq_avx2, tick_avx2
+};
+#endif
+
+static const struct kernels *
+kernels ( void ) {
+#if LOCKSTEP_X86
+    if ( __builtin_cpu_supports( "avx2" ) ) { return &kernels_avx2; }
+    if ( __builtin_cpu_supports( "sse2" ) ) { return &kernels_sse2; }
+#endif
+    return &kernels_generic;
+}
+
+const char *
+chip8_batch_isa ( void ) {
+    return kernels()->name;
+}
+
+struct chip8_batch *
+chip8_batch_create ( int n ) {
+    struct chip8_batch *b;
+    size_t stride, size;
+    u8 *p;
+
+    if ( n < 1 ) { return NULL; }
+
+    b = calloc( 1, sizeof(struct chip8_batch) );
+    if ( !b ) { return NULL; }
+
+    /* 16 V registers, dt, st and sp are a byte per lane, pc and I two */
+    stride = (n + LANE_ALIGN - 1) & ~(size_t) (LANE_ALIGN - 1);
+    size = stride * (16 + 3) + stride * sizeof(u16) * 2;
+
+    b->mem = p = aligned_alloc( LANE_ALIGN, size );
+    b->lanes = calloc( n, sizeof(struct chip8) );
+    if ( !b->mem || !b->lanes ) {
+        chip8_batch_destroy( b );
+        return NULL;
+    }
+    memset( p, 0, size );
+
+    b->n = n;
+    b->stride = stride;
+    for ( int r = 0; r < 16; r++, p += stride ) { b->v[r] = p; }
+    b->dt = p; p += stride;
+    b->st = p; p += stride;
+    b->sp = p; p += stride;
+    b->pc = (u16 *) p; p += stride * sizeof(u16);
+    b->i  = (u16 *) p;
+
+    return b;
+}
+
+void
+chip8_batch_destroy ( struct chip8_batch *b ) {
+    if ( !b ) { return; }
+    free( b->mem );
+    free( b->lanes );
+    free( b );
+}
+
+/* move the registers of a lane between the SoA arrays and its struct chip8 */
+static void
+gather ( const struct chip8_batch *b, int k, struct chip8 *c8 ) {
+    for ( int r = 0; r < 16; r++ ) { c8->v[r] = b->v[r][k]; }
+    c8->i  = b->i[k];
+    c8->pc = b->pc[k];
+    c8->sp = b->sp[k];
+    c8->dt = b->dt[k];
+    c8->st = b->st[k];
+}
+
+static void
+scatter ( struct chip8_batch *b, int k, const struct chip8 *c8 ) {
+    for ( int r = 0; r < 16; r++ ) { b->v[r][k] = c8->v[r]; }
+    b->i[k]  = c8->i;
+    b->pc[k] = c8->pc;
+    b->sp[k] = c8->sp;
+    b->dt[k] = c8->dt;
+    b->st[k] = c8->st;
+}
+
+void
+chip8_batch_load ( struct chip8_batch *b, const struct chip8 *c8 ) {
+    for ( int k = 0; k < b->n; k++ ) {
+        memcpy( &b->lanes[k], c8, sizeof(struct chip8) );
+        b->lanes[k].trace = NULL;
+        b->lanes[k].input = NULL;
+        scatter( b, k, c8 );
+    }
+    b->ipf = c8->ipf;
+    b->mem_diverged = 0;
+}
+
+void
+chip8_batch_key_set_state ( struct chip8_batch *b, int lane, int key, int state ) {
+    chip8_key_set_state( &b->lanes[lane], key, state );
+}
+
+void
+chip8_batch_get ( const struct chip8_batch *b, int lane, struct chip8 *c8 ) {
+    memcpy( c8, &b->lanes[lane], sizeof(struct chip8) );
+    gather( b, lane, c8 );
+    c8->cycles_left = 0;
+    c8->yield = 0;
+}
+
+static u16
+fetch ( const struct chip8 *c8, u16 pc ) {
+    return (c8->mem[pc] << 8) | c8->mem[(pc + 1) & CHIP8_ADDR_MASK];
+}
+
+/* true if the instruction can be applied to every lane with the kernels */
+static int
+vectorizable ( u16 opcode ) {
+    switch ( opcode & 0xF000 ) {
+        case 0x1000: case 0x3000: case 0x4000: case 0x5000:
+        case 0x6000: case 0x7000: case 0x8000: case 0x9000: case 0xA000:
+            return 1;
+        case 0xE000:
+            return (opcode & 0xFF) != 0x9E && (opcode & 0xFF) != 0xA1;
+        case 0xF000:
+            switch ( opcode & 0xFF ) {
+                case 0x0A: case 0x33: case 0x55: case 0x65: return 0;
+            }
+            return 1;
+    }
+    return 0;
+}
+
+/* run one instruction on every lane through chip8_step */
+static void
+step_scalar ( struct chip8_batch *b ) {
+    for ( int k = 0; k < b->n; k++ ) {
+        struct chip8 *c8 = &b->lanes[k];
+        gather( b, k, c8 );
+
+        u16 opcode = fetch( c8, c8->pc );
+        if ( (opcode & 0xF0FF) == 0xF033 || (opcode & 0xF0FF) == 0xF055 ) {
+            b->mem_diverged = 1;
+        }
+
+        chip8_step( c8 );
+        scatter( b, k, c8 );
+    }
+    b->scalar_steps += b->n;
+}
+
+/* true if every lane is about to execute opcode at pc */
+static int
+converged ( const struct chip8_batch *b, u16 pc, u16 opcode ) {
+    for ( int k = 1; k < b->n; k++ ) {
+        if ( b->pc[k] != pc ) { return 0; }
+    }
+    if ( b->mem_diverged ) {
+        for ( int k = 1; k < b->n; k++ ) {
+            if ( fetch( &b->lanes[k], pc ) != opcode ) { return 0; }
+        }
+    }
+    return 1;
+}
+
+static void
+fill16 ( u16 *a, u16 value, int n ) {
+    for ( int k = 0; k < n; k++ ) { a[k] = value; }
+}
+
+static void
+step_lockstep ( struct chip8_batch *b, const struct kernels *K, u16 opcode ) {
+    int n = b->stride;
+    u16 pc = b->pc[0];
+    u16 next = (pc + 2) & CHIP8_ADDR_MASK;
+    u8  byte = opcode & 0xFF;
+    u16 word = opcode & 0xFFF;
+    u8  x    = (opcode >> 8) & 0xF;
+    u8  y    = (opcode >> 4) & 0xF;
+    u8 *vx = b->v[x], *vy = b->v[y];
+
+    for ( int k = 0; k < b->n; k++ ) { PROFILE_OP(pc, opcode); }
+
+    switch ( opcode & 0xF000 ) {
+        case 0x1000:
+            fill16( b->pc, word, n );
+            break;
+        case 0x3000:
+            for ( int k = 0; k < n; k++ ) { b->pc[k] = (next + 2*(vx[k] == byte)) & CHIP8_ADDR_MASK; }
+            break;
+        case 0x4000:
+            for ( int k = 0; k < n; k++ ) { b->pc[k] = (next + 2*(vx[k] != byte)) & CHIP8_ADDR_MASK; }
+            break;
+        case 0x5000:
+            for ( int k = 0; k < n; k++ ) { b->pc[k] = (next + 2*(vx[k] == vy[k])) & CHIP8_ADDR_MASK; }
+            break;
+        case 0x9000:
+            for ( int k = 0; k < n; k++ ) { b->pc[k] = (next + 2*(vx[k] != vy[k])) & CHIP8_ADDR_MASK; }
+            break;
+        case 0x6000:
+            memset( vx, byte, n );
+            fill16( b->pc, next, n );
+            break;
+        case 0x7000:
+            K->addi( vx, byte, n );
+            fill16( b->pc, next, n );
+            break;
+        case 0x8000:
+            K->alu( opcode & 0xF, vx, vy, b->v[0xF], n );
+            fill16( b->pc, next, n );
+            break;
+        case 0xA000:
+            fill16( b->i, word, n );
+            fill16( b->pc, next, n );
+            break;
+        case 0xF000:
+            switch ( byte ) {
+                case 0x07: memcpy( vx, b->dt, n ); break;
+                case 0x15: memcpy( b->dt, vx, n ); break;
+                case 0x18: memcpy( b->st, vx, n ); break;
+                case 0x1E:
+                    for ( int k = 0; k < n; k++ ) { b->i[k] += vx[k]; }
+                    break;
+                case 0x29:
+                    for ( int k = 0; k < n; k++ ) { b->i[k] = (vx[k] % 0x10) * 5; }
+                    break;
+            }
+            fill16( b->pc, next, n );
+            break;
+        default:
+            fill16( b->pc, next, n );
+            break;
+    }
+
+    b->lockstep_steps += b->n;
+}
+
+void
+chip8_batch_tick ( struct chip8_batch *b ) {
+    const struct kernels *K = kernels();
+
+    if ( K->any_eq( b->st, 1, b->stride ) ) {
+        for ( int k = 0; k < b->n; k++ ) {
+            if ( b->st[k] == 1 ) { b->lanes[k].beep = 1; }
+        }
+    }
+    K->tick( b->dt, b->st, b->stride );
+}
+
+void
+chip8_batch_run_frames ( struct chip8_batch *b, unsigned long frames ) {
+    for ( unsigned long f = 0; f < frames; f++ ) {
+        PROFILE_FRAME_BEGIN(start);
+        chip8_batch_run( b, b->ipf );
+        chip8_batch_tick( b );
+        PROFILE_FRAME_END(start, 1);
+    }
+    for ( int k = 0; k < b->n; k++ ) { b->lanes[k].frame += frames; }
+}
+
+void
+chip8_batch_run ( struct chip8_batch *b, unsigned long cycles ) {
+    const struct kernels *K = kernels();
+
+    while ( cycles-- ) {
+        u16 pc = b->pc[0];
+        u16 opcode = fetch( &b->lanes[0], pc );
+
+        if ( vectorizable( opcode ) && converged( b, pc, opcode ) ) {
+            step_lockstep( b, K, opcode );
+        } else {
+            step_scalar( b );
+        }
+    }
+}
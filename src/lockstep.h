@@ -0,0 +1,63 @@
+#ifndef _LOCKSTEP_H_
+#define _LOCKSTEP_H_
+
+#include "chip8.h"
+
+/* runs many copies of the same program side by side. registers, timers and
+   program counters are stored structure-of-arrays so that an instruction
+   can be applied to every lane at once with SIMD while the lanes agree on
+   pc. lanes that drift apart are stepped one at a time with chip8_step until
+   they line up again. memory, stack, display and keyboard are addressed by
+   register contents, so they stay in a struct chip8 per lane */
+struct chip8_batch {
+	int n;       /* number of lanes */
+	int stride;  /* n rounded up to a whole number of vectors */
+	int ipf;     /* instructions per frame, taken from chip8_batch_load */
+
+	/* register file, each array holds stride entries */
+	u8  *v[16];
+	u16 *i;
+	u16 *pc;
+	u8  *sp;
+	u8  *dt;
+	u8  *st;
+
+	/* the registers above are only valid in here between steps */
+	struct chip8 *lanes;
+
+	/* set once any lane has written to memory, lanes can no longer be
+	   assumed to hold the same program after that */
+	int mem_diverged;
+
+	/* instructions executed in lockstep and one lane at a time */
+	unsigned long long lockstep_steps;
+	unsigned long long scalar_steps;
+
+	void *mem; /* backing allocation */
+};
+
+struct chip8_batch *chip8_batch_create ( int n );
+void chip8_batch_destroy ( struct chip8_batch *batch );
+
+/* copy a machine, typically fresh from chip8_init and chip8_load, into
+   every lane */
+void chip8_batch_load ( struct chip8_batch *batch, const struct chip8 *chip8 );
+
+/* execute exactly cycles instructions on every lane, timers are left alone.
+   a lane blocked in LD Vx, K keeps retrying it */
+void chip8_batch_run ( struct chip8_batch *batch, unsigned long cycles );
+/* tick every lane's timers once */
+void chip8_batch_tick ( struct chip8_batch *batch );
+/* run whole frames of ipf instructions followed by a timer tick. lanes end
+   up in the state chip8_run_frame would leave them in */
+void chip8_batch_run_frames ( struct chip8_batch *batch, unsigned long frames );
+
+void chip8_batch_key_set_state ( struct chip8_batch *batch, int lane, int key, int state );
+
+/* copy the full state of a lane out into a struct chip8 */
+void chip8_batch_get ( const struct chip8_batch *batch, int lane, struct chip8 *chip8 );
+
+/* name of the SIMD kernels picked for this cpu */
+const char *chip8_batch_isa ( void );
+
+#endif
@@ -0,0 +1,108 @@
+/* lane kernels for lockstep.c, included once per instruction set with the
+   vector primitives below defined by the includer:
+
+   KFN(name)   function name for this instruction set
+   KATTR       function attributes, e.g. target("avx2")
+   VW          lanes per vector
+   VEC         vector type
+   LOAD STORE SET1 ADD SUB ADDS SUBS AND OR XOR ANDNOT CMPEQ SHR1 ANY
+
+   arrays are aligned and padded to a whole number of vectors, so there is
+   no tail to take care of. every kernel writes VF before reloading its
+   operands so that Vx or Vy aliasing VF behaves exactly as in chip8_step */
+
+/* 8xyN for every lane */
+static KATTR void
+KFN(alu) ( int op, u8 *vx, u8 *vy, u8 *vf, int n ) {
+    const VEC one = SET1(1), zero = SET1(0);
+
+    switch ( op ) {
+        case 0x0:
+            for ( int k = 0; k < n; k += VW ) {
+                STORE( vx + k, LOAD( vy + k ) );
+            }
+            break;
+        case 0x1:
+            for ( int k = 0; k < n; k += VW ) {
+                STORE( vx + k, OR( LOAD( vx + k ), LOAD( vy + k ) ) );
+            }
+            break;
+        case 0x2:
+            for ( int k = 0; k < n; k += VW ) {
+                STORE( vx + k, AND( LOAD( vx + k ), LOAD( vy + k ) ) );
+            }
+            break;
+        case 0x3:
+            for ( int k = 0; k < n; k += VW ) {
+                STORE( vx + k, XOR( LOAD( vx + k ), LOAD( vy + k ) ) );
+            }
+            break;
+        case 0x4:
+            /* carry out when the saturating sum differs from the wrapped one */
+            for ( int k = 0; k < n; k += VW ) {
+                VEC x = LOAD( vx + k ), y = LOAD( vy + k );
+                STORE( vf + k, ANDNOT( CMPEQ( ADDS( x, y ), ADD( x, y ) ), one ) );
+                STORE( vx + k, ADD( LOAD( vx + k ), LOAD( vy + k ) ) );
+            }
+            break;
+        case 0x5:
+            /* Vy < Vx exactly when Vx - Vy saturates above zero */
+            for ( int k = 0; k < n; k += VW ) {
+                VEC x = LOAD( vx + k ), y = LOAD( vy + k );
+                STORE( vf + k, ANDNOT( CMPEQ( SUBS( x, y ), zero ), one ) );
+                STORE( vx + k, SUB( LOAD( vx + k ), LOAD( vy + k ) ) );
+            }
+            break;
+        case 0x6:
+            for ( int k = 0; k < n; k += VW ) {
+                STORE( vf + k, AND( LOAD( vx + k ), one ) );
+                STORE( vx + k, SHR1( LOAD( vx + k ) ) );
+            }
+            break;
+        case 0x7:
+            for ( int k = 0; k < n; k += VW ) {
+                VEC x = LOAD( vx + k ), y = LOAD( vy + k );
+                STORE( vf + k, ANDNOT( CMPEQ( SUBS( y, x ), zero ), one ) );
+                STORE( vx + k, SUB( LOAD( vy + k ), LOAD( vx + k ) ) );
+            }
+            break;
+        case 0xE:
+            for ( int k = 0; k < n; k += VW ) {
+                VEC x = LOAD( vx + k );
+                STORE( vf + k, AND( x, SET1(0x80) ) );
+                x = LOAD( vx + k );
+                STORE( vx + k, ADD( x, x ) );
+            }
+            break;
+    }
+}
+
+/* 7xkk for every lane */
+static KATTR void
+KFN(addi) ( u8 *vx, u8 byte, int n ) {
+    const VEC b = SET1(byte);
+    for ( int k = 0; k < n; k += VW ) {
+        STORE( vx + k, ADD( LOAD( vx + k ), b ) );
+    }
+}
+
+/* true if any lane holds value */
+static KATTR int
+KFN(any_eq) ( const u8 *a, u8 value, int n ) {
+    const VEC b = SET1(value);
+    VEC any = SET1(0);
+    for ( int k = 0; k < n; k += VW ) {
+        any = OR( any, CMPEQ( LOAD( a + k ), b ) );
+    }
+    return ANY(any) != 0;
+}
+
+/* count both timers down, stopping at zero */
+static KATTR void
+KFN(tick) ( u8 *dt, u8 *st, int n ) {
+    const VEC one = SET1(1);
+    for ( int k = 0; k < n; k += VW ) {
+        STORE( dt + k, SUBS( LOAD( dt + k ), one ) );
+        STORE( st + k, SUBS( LOAD( st + k ), one ) );
+    }
+}
@@ -1,9 +1,20 @@
 #include "chip8.h"
+#include "engine.h"
+#include "blit.h"
+#include "state.h"
+#include "rewind.h"
+#include "sdl_overlay.h"
+#include "trace.h"
+#include "input.h"
+#include "tribuf.h"
+#include "sdl_pacer.h"
+#include "sdl_audio.h"
 
 #include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <memory.h>
+#include <stdatomic.h>
 
 #include <SDL2/SDL.h>
 
@@ -11,25 +22,156 @@
 #define DEFAULT_SCREEN_WIDTH  1024
 #define DEFAULT_SCREEN_HEIGHT 512
 
-#define FPS  50
-#define MSPS (1000/FPS)
+#define DEFAULT_FG 0xFFFFFF
+#define DEFAULT_BG 0x000000
 
+/* frames a second, the timers tick once a frame so this sets game speed */
+#define DEFAULT_RATE 60
+
+/* frames to catch up on at most after the process has been stalled */
+#define MAX_FRAMES_BEHIND 4
+
+/* height of each timing graph, the graphs fill up at two frame periods */
+#define STATS_GRAPH_H 8
+#define STATS_EMU_RGB    0x40FF40
+#define STATS_RENDER_RGB 0xFFC040
+
+/* requests from the render thread for the emulation thread */
+#define CMD_SAVE_STATE 1
+#define CMD_LOAD_STATE 2
+
+/* rewind history, a snapshot every frame with a keyframe every second */
+#define DEFAULT_REWIND_MB   4
+#define REWIND_MAX_SECONDS  600
+#define REWIND_KEYFRAME     CHIP8_TIMER_HZ
+
+/* the emulation runs on its own thread, paced at 60 Hz, and publishes
+   every finished frame's display through a triple buffer. the main thread
+   only polls events and presents whatever frame is newest, so a present
+   that blocks on vsync or the compositor never holds emulation up. keys
+   and commands go the other way through atomics. the fields below are
+   owned by the emulation thread unless marked otherwise */
 struct state {
 	struct chip8 chip8;
 
+	const struct chip8_engine *engine;
+	void *engine_ctx;
+
 	SDL_Window   *window;
 	SDL_Renderer *renderer;
 	SDL_Texture  *texture;
 
+	/* texture format and palette */
+	struct blitter blitter;
+	enum blit_format format;
+	enum blit_impl impl;
+	uint32_t fg, bg;
+
+	/* emulation thread to render thread */
+	SDL_Thread *emu_thread;
+	struct tribuf frames;
+	chip8_row slots[3][CHIP8_DISPLAY_HEIGHT];
+
+	/* render thread to emulation thread */
+	atomic_int keys;        /* chip-8 keys held, bit n for key n */
+	atomic_int rewinding;   /* backspace is held */
+	atomic_int command;     /* CMD_* to carry out before the next frame */
+	atomic_int quit;        /* set by either side */
+
+	/* frame pacing, on the emulation thread or with -V on the render
+	   thread, which then passes on the frames its presents paid for */
+	struct pacer pacer;
+	double rate;
+	int vsync;
+	SDL_sem *vsyncs;
+	atomic_int due;
+
+	/* time between frames and to emulate one, emulation thread, and
+	   time to draw and present, render thread. -S graphs the last few,
+	   -P prints histograms on exit */
+	struct times frame_times;
+	struct times emu_times;
+	struct times render_times;
+	Uint64 last_frame;
+	int stats_overlay;
+	int stats_dump;
+
+	/* beeper, NULL without an audio device or while replaying. sound_st
+	   is the sound timer as last reported to it, counted down by frames */
+	struct audio *audio;
+	u8 sound_st;
+
+	/* render thread: texture contents, up to 4 bytes per pixel */
+	Uint8 pixels[CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT * 4];
+	/* display rows as last uploaded to the texture */
+	chip8_row shown[CHIP8_DISPLAY_HEIGHT];
+	/* window needs redrawing in full even if the display has not changed */
+	int redraw;
+
+	/* run-ahead: ahead is a copy of chip8 run runahead frames further with
+	   the current keys, it is what gets displayed. it has its own engine
+	   context so speculation never touches chip8's caches */
+	int runahead;
+	struct chip8 ahead;
+	void *ahead_ctx;
+
+	/* render thread: input to photon latency, time of the first key press
+	   not yet followed by a change on screen, and a running average in ms */
+	int latency_overlay;
+	Uint64 key_time;
+	double latency;
+
+	int ipf;
+
+	/* frame history, stepped back through while backspace is held */
+	struct chip8_rewind *rewind;
+	int rewind_mb;
+
 	char *romfile;
+	char statefile[4096];
+	char *tracefile;
+
+	/* random seed, the time unless given with -s */
+	uint32_t seed;
+	int seeded;
+	/* input log being recorded with -r or replayed with -p. a replay
+	   runs as fast as it can, ignoring the keyboard */
+	char *recordfile;
+	struct chip8_input *record;
+	char *replayfile;
+	struct chip8_input *replay;
+	Uint64 replay_start;
 
 	int width, height, fullscreen;
-	int quit;
 };
 
 static void
 usage ( const char *progname ) {
-	fprintf( stdout, "usage: %s ROM\n", progname );
+	fprintf( stdout, "usage: %s [-W WIDTH] [-H HEIGHT] [-f] [-e ENGINE] [-t FORMAT] [-b BLITTER] [-fg RRGGBB] [-bg RRGGBB] [-i IPF] [-R MB] [-a FRAMES] [-L] [-F HZ] [-V] [-S] [-P] [-T FILE] [-s SEED] [-r LOG | -p LOG] ROM\n", progname );
+	fprintf( stdout, "  -a FRAMES  run ahead FRAMES frames to hide input latency\n" );
+	fprintf( stdout, "  -L         show input to screen latency in ms\n" );
+	fprintf( stdout, "  -F HZ      frames per second (default: %d)\n", DEFAULT_RATE );
+	fprintf( stdout, "  -V         lock frames to the display's vsync\n" );
+	fprintf( stdout, "  -S         graph frame, emulation and render times\n" );
+	fprintf( stdout, "  -P         print frame, emulation and render time histograms on exit\n" );
+	fprintf( stdout, "  -T FILE    write a binary trace of every instruction to FILE\n" );
+	fprintf( stdout, "  -s SEED    seed for the random number generator (default: the time)\n" );
+	fprintf( stdout, "  -r LOG     record the seed and every key press to LOG\n" );
+	fprintf( stdout, "  -p LOG     replay LOG at full speed, then quit\n" );
+	fprintf( stdout, "keys: backspace rewinds (-R MB of history, 0 to disable), F5 saves state, F9 loads it\n" );
+	fprintf( stdout, "engines:" );
+	for ( int i = 0; chip8_engines[i]; i++ ) {
+		fprintf( stdout, " %s", chip8_engines[i]->name );
+	}
+	fprintf( stdout, "\ntexture formats:" );
+	for ( int i = 0; i < BLIT_FORMAT_COUNT; i++ ) {
+		fprintf( stdout, " %s", blit_format_name(i) );
+	}
+	fprintf( stdout, "\nblitters:" );
+	for ( int i = 0; i < BLIT_IMPL_COUNT; i++ ) {
+		fprintf( stdout, " %s", blit_impl_name(i) );
+	}
+	fprintf( stdout, "\n" );
 	exit(0);
 }
 
@@ -37,8 +179,17 @@ static void
 parse_args ( struct state *state, int argc, char *argv[] ) {
 	memset( state, 0, sizeof(struct state) );
 
+	state->redraw = 1;
 	state->width = DEFAULT_SCREEN_WIDTH;
 	state->height = DEFAULT_SCREEN_HEIGHT;
+	state->engine = chip8_engines[0];
+	state->format = BLIT_RGB332;
+	state->impl = BLIT_IMPL_AUTO;
+	state->fg = DEFAULT_FG;
+	state->bg = DEFAULT_BG;
+	state->ipf = CHIP8_DEFAULT_IPF;
+	state->rewind_mb = DEFAULT_REWIND_MB;
+	state->rate = DEFAULT_RATE;
 
 	for ( int i = 1; i < argc; i++ ) {
 		if ( strcmp( "-W", argv[i] ) == 0 ) {
@@ -47,6 +198,47 @@ parse_args ( struct state *state, int argc, char *argv[] ) {
 			state->height = atoi(argv[++i]);
 		} else if ( strcmp( "-f", argv[i] ) == 0 ) {
 			state->fullscreen = 1;
+		} else if ( strcmp( "-e", argv[i] ) == 0 ) {
+			state->engine = chip8_engine_find( argv[++i] );
+			if ( state->engine == 0 ) { usage(argv[0]); }
+		} else if ( strcmp( "-t", argv[i] ) == 0 ) {
+			int format = blit_format_find( argv[++i] );
+			if ( format < 0 ) { usage(argv[0]); }
+			state->format = format;
+		} else if ( strcmp( "-b", argv[i] ) == 0 ) {
+			int impl = blit_impl_find( argv[++i] );
+			if ( impl < 0 ) { usage(argv[0]); }
+			state->impl = impl;
+		} else if ( strcmp( "-fg", argv[i] ) == 0 ) {
+			state->fg = strtoul( argv[++i], NULL, 16 ) & 0xFFFFFF;
+		} else if ( strcmp( "-bg", argv[i] ) == 0 ) {
+			state->bg = strtoul( argv[++i], NULL, 16 ) & 0xFFFFFF;
+		} else if ( strcmp( "-i", argv[i] ) == 0 ) {
+			state->ipf = atoi(argv[++i]);
+		} else if ( strcmp( "-a", argv[i] ) == 0 ) {
+			state->runahead = atoi(argv[++i]);
+		} else if ( strcmp( "-L", argv[i] ) == 0 ) {
+			state->latency_overlay = 1;
+		} else if ( strcmp( "-F", argv[i] ) == 0 ) {
+			state->rate = atof(argv[++i]);
+			if ( state->rate <= 0 ) { usage(argv[0]); }
+		} else if ( strcmp( "-V", argv[i] ) == 0 ) {
+			state->vsync = 1;
+		} else if ( strcmp( "-S", argv[i] ) == 0 ) {
+			state->stats_overlay = 1;
+		} else if ( strcmp( "-P", argv[i] ) == 0 ) {
+			state->stats_dump = 1;
+		} else if ( strcmp( "-T", argv[i] ) == 0 ) {
+			state->tracefile = argv[++i];
+		} else if ( strcmp( "-s", argv[i] ) == 0 ) {
+			state->seed = strtoul( argv[++i], NULL, 0 );
+			state->seeded = 1;
+		} else if ( strcmp( "-r", argv[i] ) == 0 ) {
+			state->recordfile = argv[++i];
+		} else if ( strcmp( "-p", argv[i] ) == 0 ) {
+			state->replayfile = argv[++i];
+		} else if ( strcmp( "-R", argv[i] ) == 0 ) {
+			state->rewind_mb = atoi(argv[++i]);
 		} else if ( strcmp( "-h", argv[i] ) == 0 ) {
 			usage(argv[0]);
 		} else {
@@ -55,23 +247,92 @@ parse_args ( struct state *state, int argc, char *argv[] ) {
 	}
 
 	if ( state->romfile == 0 ) { usage(argv[0]); }
+	if ( state->recordfile && state->replayfile ) { usage(argv[0]); }
+	/* rewinding or loading a state would break the frame numbering of a log */
+	if ( state->recordfile || state->replayfile ) { state->rewind_mb = 0; }
+	snprintf( state->statefile, sizeof(state->statefile), "%s.state", state->romfile );
 }
 
 static int
 init ( struct state *state ) {
-	srand(time(NULL));
-
 	chip8_init( &state->chip8 );
 	if ( chip8_load( &state->chip8, state->romfile ) == 0 ) {
 		fprintf( stderr, "unable to load rom \"%s\"\n", state->romfile );
 		return 0;
 	}
+	state->chip8.ipf = state->ipf;
+	chip8_seed( &state->chip8, state->seeded? state->seed : (uint32_t) time(NULL) );
+
+	if ( state->replayfile ) {
+		state->replay = chip8_input_load( state->replayfile );
+		if ( state->replay == 0 ) {
+			fprintf( stderr, "unable to load input log \"%s\"\n", state->replayfile );
+			return 0;
+		}
+		if ( !chip8_input_start( state->replay, &state->chip8 ) ) {
+			fprintf( stderr, "input log was not recorded with \"%s\"\n", state->romfile );
+			return 0;
+		}
+		state->replay_start = SDL_GetPerformanceCounter();
+	}
+	if ( state->recordfile ) {
+		state->record = chip8_input_create( &state->chip8 );
+		if ( state->record == 0 ) {
+			fprintf( stderr, "unable to record input\n" );
+			return 0;
+		}
+		state->chip8.input = state->record;
+	}
+
+	if ( state->tracefile ) {
+		state->chip8.trace = chip8_trace_open( state->tracefile );
+		if ( state->chip8.trace == 0 ) {
+			fprintf( stderr, "unable to write trace \"%s\"\n", state->tracefile );
+			return 0;
+		}
+	}
+
+	if ( state->rewind_mb > 0 ) {
+		state->rewind = chip8_rewind_create( (size_t) state->rewind_mb << 20,
+			REWIND_MAX_SECONDS * CHIP8_TIMER_HZ, REWIND_KEYFRAME );
+		if ( state->rewind == 0 ) {
+			fprintf( stderr, "unable to allocate rewind buffer\n" );
+			return 0;
+		}
+		chip8_rewind_push( state->rewind, &state->chip8 );
+	}
+
+	state->engine_ctx = state->engine->create();
+	if ( state->runahead > 0 ) { state->ahead_ctx = state->engine->create(); }
+	if ( state->engine_ctx == 0 || (state->runahead > 0 && state->ahead_ctx == 0) ) {
+		fprintf( stderr, "unable to start %s engine\n", state->engine->name );
+		return 0;
+	}
+	tribuf_init( &state->frames );
+	times_init( &state->frame_times, "frame" );
+	times_init( &state->emu_times, "emulation" );
+	times_init( &state->render_times, "render" );
+
+	if ( blit_init( &state->blitter, state->format, state->fg, state->bg, state->impl ) == 0 ) {
+		fprintf( stderr, "%s blitter is not supported on this cpu\n", blit_impl_name( state->impl ) );
+		return 0;
+	}
 
 	if ( SDL_Init( SDL_INIT_EVERYTHING ) < 0 ) {
 		fprintf( stderr, "SDL_Init : %s\n", SDL_GetError() );
 		return 0;
 	}
 
+	/* presents block until the next refresh and pace the emulation */
+	if ( state->vsync ) {
+		SDL_SetHint( SDL_HINT_RENDER_VSYNC, "1" );
+		state->vsyncs = SDL_CreateSemaphore( 0 );
+		if ( state->vsyncs == NULL ) {
+			fprintf( stderr, "SDL_CreateSemaphore : %s\n", SDL_GetError() );
+			return 0;
+		}
+	}
+
 	int status = SDL_CreateWindowAndRenderer( 
 		state->width, 
 		state->height,
@@ -94,51 +355,232 @@ init ( struct state *state ) {
 		state->renderer, CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT
 	);
 
+	static const Uint32 formats[BLIT_FORMAT_COUNT] = {
+		[BLIT_RGB332]   = SDL_PIXELFORMAT_RGB332,
+		[BLIT_RGB565]   = SDL_PIXELFORMAT_RGB565,
+		[BLIT_ARGB8888] = SDL_PIXELFORMAT_ARGB8888,
+	};
+
 	state->texture = SDL_CreateTexture(
-		state->renderer, SDL_PIXELFORMAT_RGB332, SDL_TEXTUREACCESS_STREAMING,
+		state->renderer, formats[state->format], SDL_TEXTUREACCESS_STREAMING,
 		CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT
 	);
 
+	if ( state->texture == NULL ) {
+		fprintf( stderr, "SDL_CreateTexture : %s\n", SDL_GetError() );
+		return 0;
+	}
+
+	/* a replay runs faster than real time, it would only buzz */
+	if ( !state->replay ) {
+		state->audio = audio_open( state->rate );
+		if ( state->audio == NULL ) {
+			fprintf( stderr, "no sound, SDL_OpenAudioDevice : %s\n", SDL_GetError() );
+		}
+	}
+
 	return 1;
 }
 
+/* bring a machine's keyboard in line with the keys held on the host */
 static void
-update ( struct state *state, Sint32 dt ) {
-	static Sint32 elapsed = 0;
-	elapsed += dt;
-	
-	/* fiddle with the numbers in this loop to affect processor speed */	
-	while ( elapsed >= 15 ) {
-		chip8_step( &state->chip8 );
-		if ( state->chip8.beep ) { 
-			fprintf( stdout, "\a" ); 
-			state->chip8.beep = 0;
+sync_keys ( struct state *state, struct chip8 *c8 ) {
+	u16 keys = atomic_load( &state->keys );
+	u16 changed = keys ^ c8->keys;
+
+	for ( int k = 0; k < 16; k++ ) {
+		if ( changed & (1 << k) ) {
+			chip8_key_set_state( c8, k, (keys >> k) & 1 );
+		}
+	}
+}
+
+/* the machine as it will be runahead frames from now if the keys stay as
+   they are. the speculative copy is thrown away again next frame, so this
+   costs runahead extra frames of emulation per frame */
+static const struct chip8 *
+run_ahead ( struct state *state ) {
+	if ( state->runahead <= 0 || atomic_load( &state->rewinding ) ) { return &state->chip8; }
+
+	/* the context holds what it derived from the previous copy's memory,
+	   which is only still valid if memory ended up the same */
+	if ( memcmp( state->ahead.mem, state->chip8.mem, CHIP8_MEMORY_CAPACITY ) != 0 ) {
+		state->engine->flush( state->ahead_ctx );
+	}
+
+	state->ahead = state->chip8;
+	state->ahead.trace = NULL;
+	state->ahead.input = NULL;
+	/* keys pressed since the frame started count straight away */
+	if ( !state->replay ) { sync_keys( state, &state->ahead ); }
+	for ( int f = 0; f < state->runahead; f++ ) {
+		while ( !chip8_engine_run_frame( state->engine, state->ahead_ctx, &state->ahead ) ) { }
+	}
+	return &state->ahead;
+}
+
+/* hand the display to the render thread */
+static void
+publish ( struct state *state ) {
+	const struct chip8 *view = run_ahead( state );
+
+	memcpy( state->slots[tribuf_back( &state->frames )], view->display, sizeof(view->display) );
+	tribuf_publish( &state->frames );
+}
+
+/* report the sound timer to the beeper whenever it was set rather than
+   ticked down, including by loading a state or rewinding */
+static void
+update_sound ( struct state *state, int st ) {
+	if ( state->audio && st != state->sound_st ) { audio_sound( state->audio, st ); }
+	state->sound_st = st;
+}
+
+/* F5 and F9 save and load the state next to the rom */
+static void
+run_command ( struct state *state, int command ) {
+	if ( command == CMD_SAVE_STATE ) {
+		if ( !chip8_save_state_file( &state->chip8, state->statefile ) ) {
+			fprintf( stderr, "unable to save state to \"%s\"\n", state->statefile );
+		}
+	} else if ( command == CMD_LOAD_STATE ) {
+		if ( state->record || state->replay ) {
+			fprintf( stderr, "states cannot be loaded while recording or replaying input\n" );
+			return;
+		}
+		if ( !chip8_load_state_file( &state->chip8, state->statefile ) ) {
+			fprintf( stderr, "unable to load state from \"%s\"\n", state->statefile );
+			return;
 		}
-		elapsed -= 4;
+		state->engine->flush( state->engine_ctx );
+		update_sound( state, state->chip8.st );
+		if ( state->rewind ) {
+			chip8_rewind_clear( state->rewind );
+			chip8_rewind_push( state->rewind, &state->chip8 );
+		}
+	}
+}
+
+/* run the replay for one display frame's worth of wall time, as many
+   chip-8 frames as fit */
+static void
+update_replay ( struct state *state ) {
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	while ( !chip8_input_done( state->replay, &state->chip8 ) ) {
+		chip8_input_apply( state->replay, &state->chip8 );
+		while ( !chip8_engine_run_frame( state->engine, state->engine_ctx, &state->chip8 ) ) { }
+		if ( SDL_GetPerformanceCounter() - start >= state->pacer.period ) { return; }
+	}
+
+	double seconds = (double) (SDL_GetPerformanceCounter() - state->replay_start)
+	               / SDL_GetPerformanceFrequency();
+	fprintf( stdout, "replayed %llu frames in %.3fs, %.0fx real time\n",
+		state->chip8.frame, seconds,
+		(seconds > 0)? state->chip8.frame / state->rate / seconds : 0 );
+	atomic_store( &state->quit, 1 );
+}
+
+/* one 60 Hz frame */
+static void
+update ( struct state *state ) {
+	int done;
+
+	/* play history backwards while backspace is held, silently */
+	if ( atomic_load( &state->rewinding ) && state->rewind ) {
+		if ( chip8_rewind_step( state->rewind, &state->chip8 ) ) {
+			state->engine->flush( state->engine_ctx );
+		}
+		update_sound( state, 0 );
+		return;
+	}
+
+	sync_keys( state, &state->chip8 );
+	do {
+		/* the frame stops early when a sound starts so it is not late */
+		done = chip8_engine_run_frame( state->engine, state->engine_ctx, &state->chip8 );
+		if ( done && state->sound_st > 0 ) { state->sound_st--; }
+		update_sound( state, state->chip8.st );
+	} while ( !done );
+
+	if ( state->rewind ) { chip8_rewind_push( state->rewind, &state->chip8 ); }
+}
+
+/* emulation thread, a frame every 1/60th of a second (-F) whatever the
+   render thread is doing, or with -V the frames the presents since the
+   last ones have paid for. speed is set by the instructions per frame, -i */
+static int
+emulate ( void *arg ) {
+	struct state *state = arg;
+	Uint64 freq = SDL_GetPerformanceFrequency();
+
+	while ( !atomic_load( &state->quit ) ) {
+		int command = atomic_exchange( &state->command, 0 );
+		if ( command ) { run_command( state, command ); }
+
+		/* replays run unthrottled */
+		if ( state->replay ) {
+			update_replay( state );
+			publish( state );
+			continue;
+		}
+
+		int frames = 1;
+		if ( state->vsync ) {
+			/* times out now and then to notice quit */
+			if ( SDL_SemWaitTimeout( state->vsyncs, 100 ) != 0 ) { continue; }
+			frames = atomic_exchange( &state->due, 0 );
+			if ( frames == 0 ) { continue; }
+		} else {
+			pacer_wait( &state->pacer );
+		}
+
+		Uint64 start = SDL_GetPerformanceCounter();
+		if ( state->last_frame != 0 ) {
+			times_add( &state->frame_times, start - state->last_frame, freq );
+		}
+		state->last_frame = start;
+
+		for ( int f = 0; f < frames; f++ ) { update( state ); }
+		publish( state );
+		times_add( &state->emu_times, SDL_GetPerformanceCounter() - start, freq );
 	}
+
+	return 0;
 }
 
 static void
 update_keyboard ( struct state *s, int key, int dir ) {
+	int k;
+
 	/* change chip-8 keyboard mappings here */
-	switch (key) {		
-		case SDLK_1: chip8_key_set_state( &s->chip8, CHIP8_KEY_1, dir ); break;		
-		case SDLK_2: chip8_key_set_state( &s->chip8, CHIP8_KEY_2, dir ); break;
-		case SDLK_3: chip8_key_set_state( &s->chip8, CHIP8_KEY_3, dir ); break;		
-		case SDLK_4: chip8_key_set_state( &s->chip8, CHIP8_KEY_C, dir ); break;
-		case SDLK_q: chip8_key_set_state( &s->chip8, CHIP8_KEY_4, dir ); break;		
-		case SDLK_w: chip8_key_set_state( &s->chip8, CHIP8_KEY_5, dir ); break;
-		case SDLK_e: chip8_key_set_state( &s->chip8, CHIP8_KEY_6, dir ); break;		
-		case SDLK_r: chip8_key_set_state( &s->chip8, CHIP8_KEY_D, dir ); break;
-		case SDLK_a: chip8_key_set_state( &s->chip8, CHIP8_KEY_7, dir ); break;
-		case SDLK_s: chip8_key_set_state( &s->chip8, CHIP8_KEY_8, dir ); break;
-		case SDLK_d: chip8_key_set_state( &s->chip8, CHIP8_KEY_9, dir ); break;
-		case SDLK_f: chip8_key_set_state( &s->chip8, CHIP8_KEY_E, dir ); break;
-		case SDLK_z: chip8_key_set_state( &s->chip8, CHIP8_KEY_A, dir ); break;
-		case SDLK_x: chip8_key_set_state( &s->chip8, CHIP8_KEY_0, dir ); break;
-		case SDLK_c: chip8_key_set_state( &s->chip8, CHIP8_KEY_B, dir ); break;
-		case SDLK_v: chip8_key_set_state( &s->chip8, CHIP8_KEY_F, dir ); break;
-		default: break;
+	switch (key) {
+		case SDLK_1: k = CHIP8_KEY_1; break;
+		case SDLK_2: k = CHIP8_KEY_2; break;
+		case SDLK_3: k = CHIP8_KEY_3; break;
+		case SDLK_4: k = CHIP8_KEY_C; break;
+		case SDLK_q: k = CHIP8_KEY_4; break;
+		case SDLK_w: k = CHIP8_KEY_5; break;
+		case SDLK_e: k = CHIP8_KEY_6; break;
+		case SDLK_r: k = CHIP8_KEY_D; break;
+		case SDLK_a: k = CHIP8_KEY_7; break;
+		case SDLK_s: k = CHIP8_KEY_8; break;
+		case SDLK_d: k = CHIP8_KEY_9; break;
+		case SDLK_f: k = CHIP8_KEY_E; break;
+		case SDLK_z: k = CHIP8_KEY_A; break;
+		case SDLK_x: k = CHIP8_KEY_0; break;
+		case SDLK_c: k = CHIP8_KEY_B; break;
+		case SDLK_v: k = CHIP8_KEY_F; break;
+		default: return;
+	}
+
+	if ( dir == CHIP8_KEY_DOWN ) {
+		/* time from a chip-8 key going down to the screen reacting */
+		if ( !(atomic_fetch_or( &s->keys, 1 << k ) & (1 << k)) && s->key_time == 0 ) {
+			s->key_time = SDL_GetPerformanceCounter();
+		}
+	} else {
+		atomic_fetch_and( &s->keys, ~(1 << k) );
 	}
 }
 
@@ -149,62 +591,164 @@ handle_events ( struct state *state ) {
 	while ( SDL_PollEvent(&e) ) {
 		switch ( e.type ) {
 			case SDL_QUIT:
-				state->quit = 1;
+				atomic_store( &state->quit, 1 );
 				break;
 			case SDL_KEYDOWN:
-				if ( e.key.keysym.sym == SDLK_ESCAPE ) { state->quit = 1; }
-				update_keyboard( state, e.key.keysym.sym, CHIP8_KEY_DOWN );
+				if ( e.key.keysym.sym == SDLK_ESCAPE ) { atomic_store( &state->quit, 1 ); }
+				if ( e.key.keysym.sym == SDLK_BACKSPACE ) { atomic_store( &state->rewinding, 1 ); }
+				if ( e.key.keysym.sym == SDLK_F5 ) { atomic_store( &state->command, CMD_SAVE_STATE ); }
+				if ( e.key.keysym.sym == SDLK_F9 ) { atomic_store( &state->command, CMD_LOAD_STATE ); }
+				if ( !state->replay ) { update_keyboard( state, e.key.keysym.sym, CHIP8_KEY_DOWN ); }
 				break;
 			case SDL_KEYUP:
-				update_keyboard( state, e.key.keysym.sym, CHIP8_KEY_UP );
+				if ( e.key.keysym.sym == SDLK_BACKSPACE ) { atomic_store( &state->rewinding, 0 ); }
+				if ( !state->replay ) { update_keyboard( state, e.key.keysym.sym, CHIP8_KEY_UP ); }
+				break;
+			case SDL_WINDOWEVENT:
+				if ( e.window.event == SDL_WINDOWEVENT_EXPOSED ||
+				     e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED ) {
+					state->redraw = 1;
+				}
 				break;
 		}
 	}
 }
 
+/* the last few frame, emulation and render times over the bottom rows */
 static void
+draw_stats ( struct state *state ) {
+	unsigned us[TIMES_WINDOW];
+	unsigned full = 2e6 / state->rate;
+	int y = CHIP8_DISPLAY_HEIGHT - 3 * STATS_GRAPH_H;
+
+	times_recent( &state->frame_times, us, TIMES_WINDOW );
+	overlay_graph( state->renderer, 0, y, STATS_GRAPH_H, us, TIMES_WINDOW, full, state->fg );
+	times_recent( &state->emu_times, us, TIMES_WINDOW );
+	overlay_graph( state->renderer, 0, y + STATS_GRAPH_H, STATS_GRAPH_H, us, TIMES_WINDOW, full, STATS_EMU_RGB );
+	times_recent( &state->render_times, us, TIMES_WINDOW );
+	overlay_graph( state->renderer, 0, y + 2 * STATS_GRAPH_H, STATS_GRAPH_H, us, TIMES_WINDOW, full, STATS_RENDER_RGB );
+}
+
+/* present the newest published frame, returns 0 if there was nothing new.
+   with -V every call presents, as presenting is what paces emulation */
+static int
 render ( struct state *state ) {
-	Uint8 *pixels; /* PIXELFORMAT in init is RGB332 so Uint8 should be OK? */
-	int pitch;     /* should really use this to error check, just in case */
-
-	/* lock the texture and retrieve the pixel buffer */
-	SDL_LockTexture( state->texture, NULL, (void **) &pixels, &pitch );
-
-	/* draw the chip-8 display buffer to the texture */
-	for ( int i = 0, pi = 0; i < CHIP8_DISPLAY_BUF_SIZE; i++, pi += 8 ) {
-		pixels[pi + 7] = (state->chip8.display[i] & 0x01)? 255 : 0;
-		pixels[pi + 6] = (state->chip8.display[i] & 0x02)? 255 : 0;
-		pixels[pi + 5] = (state->chip8.display[i] & 0x04)? 255 : 0;
-		pixels[pi + 4] = (state->chip8.display[i] & 0x08)? 255 : 0;
-		pixels[pi + 3] = (state->chip8.display[i] & 0x10)? 255 : 0;
-		pixels[pi + 2] = (state->chip8.display[i] & 0x20)? 255 : 0;
-		pixels[pi + 1] = (state->chip8.display[i] & 0x40)? 255 : 0;
-		pixels[pi + 0] = (state->chip8.display[i] & 0x80)? 255 : 0;		
+	u8 display[CHIP8_DISPLAY_BUF_SIZE];
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	int fresh = tribuf_acquire( &state->frames );
+	if ( !fresh && !state->redraw && !state->vsync ) { return 0; }
+	const chip8_row *view = state->slots[tribuf_front( &state->frames )];
+
+	/* frames in between may have been skipped, so rows are compared with
+	   what was last uploaded, bit n set if row n differs */
+	uint64_t changed = 0;
+	for ( int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++ ) {
+		changed |= (uint64_t) (view[y] != state->shown[y]) << y;
 	}
-	
-	/* unlock the texture and draw to the screen */
-	SDL_UnlockTexture( state->texture );
+	uint64_t dirty = changed;
+
+	/* nothing changed, leave the last frame on screen. the timing graphs
+	   move on every frame though */
+	if ( changed == 0 && !state->redraw && !state->vsync && !(fresh && state->stats_overlay) ) { return 0; }
+	if ( state->redraw ) { dirty = ~(uint64_t) 0 >> (64 - CHIP8_DISPLAY_HEIGHT); }
+
+	chip8_display_pack_rows( view, display );
+	memcpy( state->shown, view, sizeof(state->shown) );
+
+	/* upload each run of consecutive dirty rows as one sub-rect */
+	int pitch = CHIP8_DISPLAY_WIDTH * state->blitter.bpp;
+	for ( int y = 0; y < CHIP8_DISPLAY_HEIGHT; ) {
+		if ( !(dirty & ((uint64_t) 1 << y)) ) { y++; continue; }
+
+		int first = y;
+		while ( y < CHIP8_DISPLAY_HEIGHT && (dirty & ((uint64_t) 1 << y)) ) { y++; }
+
+		/* draw the chip-8 display buffer to the texture */
+		blit_rows( &state->blitter, display, first, y, state->pixels, pitch );
+
+		SDL_Rect rect = { 0, first, CHIP8_DISPLAY_WIDTH, y - first };
+		SDL_UpdateTexture(
+			state->texture, &rect, state->pixels + first * pitch, pitch
+		);
+	}
+
+	/* draw to the screen */
 	SDL_RenderClear( state->renderer );
 	SDL_RenderCopy( state->renderer, state->texture, NULL, NULL );
+	if ( state->latency_overlay ) {
+		unsigned ms = state->latency + 0.5;
+		overlay_number( state->renderer,
+			CHIP8_DISPLAY_WIDTH - overlay_number_width( ms ), 0, ms, state->fg );
+	}
+	if ( state->stats_overlay ) { draw_stats( state ); }
 	SDL_RenderPresent( state->renderer );
+	state->redraw = 0;
+
+	Uint64 presented = SDL_GetPerformanceCounter();
+	times_add( &state->render_times, presented - start, SDL_GetPerformanceFrequency() );
+	if ( state->vsync ) {
+		atomic_fetch_add( &state->due, pacer_vsync( &state->pacer, presented ) );
+		SDL_SemPost( state->vsyncs );
+	}
+
+	/* the first change on screen after a key press is taken as its result */
+	if ( state->key_time != 0 && changed != 0 ) {
+		double ms = (SDL_GetPerformanceCounter() - state->key_time) * 1000.0
+		          / SDL_GetPerformanceFrequency();
+		state->latency = (state->latency == 0)? ms : state->latency * 0.75 + ms * 0.25;
+		state->key_time = 0;
+		state->redraw = state->latency_overlay;
+	}
+
+	return 1;
 }
 
+/* render thread, polls events and presents frames as they come in */
 static void
 gameloop ( struct state *state ) {
-	Uint32 start = SDL_GetTicks();
-	while ( !state->quit ) {
-		Uint32 old = start;
-		start = SDL_GetTicks();		
-		update( state, start-old );
-		handle_events( state );				
-		render( state );
-		Sint32 diff = MSPS - SDL_GetTicks() + start;
-		SDL_Delay( (diff > 0)? diff : 0 );
+	pacer_init( &state->pacer, state->rate, MAX_FRAMES_BEHIND );
+	state->emu_thread = SDL_CreateThread( emulate, "emulation", state );
+	if ( state->emu_thread == NULL ) {
+		fprintf( stderr, "SDL_CreateThread : %s\n", SDL_GetError() );
+		return;
+	}
+
+	while ( !atomic_load( &state->quit ) ) {
+		handle_events( state );
+		if ( !render( state ) ) { SDL_Delay( 1 ); }
+	}
+
+	atomic_store( &state->quit, 1 );
+	SDL_WaitThread( state->emu_thread, NULL );
+
+	if ( state->stats_dump ) {
+		times_dump( &state->frame_times, stdout );
+		times_dump( &state->emu_times, stdout );
+		times_dump( &state->render_times, stdout );
 	}
 }
 
 static void
 quit ( struct state *state ) {
+	if ( state->rewind )     { chip8_rewind_destroy( state->rewind ); }
+	if ( state->record ) {
+		chip8_input_end( state->record, &state->chip8 );
+		if ( state->record->error ) {
+			fprintf( stderr, "out of memory recording input, not writing \"%s\"\n", state->recordfile );
+		} else if ( !chip8_input_save( state->record, state->recordfile ) ) {
+			fprintf( stderr, "unable to write input log \"%s\"\n", state->recordfile );
+		}
+		chip8_input_destroy( state->record );
+	}
+	if ( state->replay )     { chip8_input_destroy( state->replay ); }
+	if ( state->chip8.trace && !chip8_trace_close( state->chip8.trace ) ) {
+		fprintf( stderr, "error writing trace \"%s\"\n", state->tracefile );
+	}
+	if ( state->engine_ctx ) { state->engine->destroy( state->engine_ctx ); }
+	if ( state->ahead_ctx )  { state->engine->destroy( state->ahead_ctx ); }
+	if ( state->audio )    { audio_close( state->audio ); }
+	if ( state->vsyncs )   { SDL_DestroySemaphore( state->vsyncs ); }
 	if ( state->texture )  { SDL_DestroyTexture( state->texture ); }
 	if ( state->renderer ) { SDL_DestroyRenderer( state->renderer ); }
 	if ( state->window )   { SDL_DestroyWindow( state->window ); }
@@ -0,0 +1,19 @@
+#ifndef _OPS_H_
+#define _OPS_H_
+
+/* instruction bodies shared by chip8_step and the alternative execution
+   engines. every engine must produce exactly the same machine state as
+   chip8_step, so anything non-trivial lives here rather than being copied */
+
+#include "chip8.h"
+#include "profile.h"
+
+#define OPS_T            struct chip8
+#define OPS(name)        chip8_op_##name
+#define OPS_RD(c8, a)    ((c8)->mem[a])
+#define OPS_WR(c8, a, v) ((c8)->mem[a] = (v))
+#define OPS_TRACED(c8)   ((c8)->trace != NULL)
+
+#include "ops_tmpl.h"
+
+#endif
@@ -0,0 +1,216 @@
+/* instruction bodies for one machine type, included once per type after
+   defining
+
+       OPS_T             the machine type, struct chip8 or a type with the
+                         same register, display and timer fields
+       OPS(name)         the name to give helper name, e.g. chip8_op_##name
+       OPS_RD(c8, a)     the byte at address a, a is already wrapped
+       OPS_WR(c8, a, v)  store v at address a
+       OPS_TRACED(c8)    true if every instruction has to be traced
+
+   ops.h does this for struct chip8. there is no include guard on purpose */
+
+static inline u16
+OPS(fetch) ( const OPS_T *c8, u16 addr ) {
+    return (OPS_RD( c8, addr ) << 8) | OPS_RD( c8, (addr + 1) & CHIP8_ADDR_MASK );
+}
+
+/* true if SE/SNE Vx, kk keeps a delay timer polling loop going for v */
+static inline int
+OPS(idle_spins) ( u16 test, u8 v ) {
+    return ((test & 0xF000) == 0x3000)? v != (test & 0xFF) : v == (test & 0xFF);
+}
+
+/* returns how many of the next budget instructions can be skipped because
+   they would not change anything but pc and a register the skip leaves
+   exactly as running them would. that covers a jump to itself, a key wait
+   with no key down, and whole iterations of a delay timer polling loop
+
+       L:   LD Vx, DT
+            SE Vx, kk    (or SNE Vx, kk)
+            JP L
+
+   while dt keeps it spinning, as dt only changes between frames */
+static inline unsigned long
+OPS(idle) ( OPS_T *c8, unsigned long budget ) {
+    u16 pc = c8->pc;
+    u16 opcode = OPS(fetch)( c8, pc );
+    unsigned long skipped = 0;
+
+    if ( opcode == (0x1000 | pc) ) { return budget; }
+    if ( (opcode & 0xF0FF) == 0xF00A && c8->keys == 0 ) {
+        c8->yield |= CHIP8_YIELD_KEY;
+        return budget;
+    }
+
+    /* find the head of the loop if pc is anywhere in one */
+    for ( int at = 0; at < 3; at++ ) {
+        u16 head = (pc - 2 * at) & CHIP8_ADDR_MASK;
+        u16 load = OPS(fetch)( c8, head );
+        u16 test = OPS(fetch)( c8, (head + 2) & CHIP8_ADDR_MASK );
+        u16 jump = OPS(fetch)( c8, (head + 4) & CHIP8_ADDR_MASK );
+        u8  x    = (load >> 8) & 0xF;
+
+        if ( (load & 0xF0FF) != 0xF007 || jump != (0x1000 | head) ) { continue; }
+        if ( (test & 0xF000) != 0x3000 && (test & 0xF000) != 0x4000 ) { continue; }
+        if ( ((test >> 8) & 0xF) != x ) { continue; }
+
+        /* finish the current iteration to get back to the head, the test
+           still sees whatever Vx holds now */
+        if ( at == 1 && !OPS(idle_spins)( test, c8->v[x] ) ) { return 0; }
+        if ( at > 0 ) {
+            skipped = 3 - at;
+            if ( skipped > budget ) { return 0; }
+            budget -= skipped;
+            c8->pc = head;
+        }
+
+        if ( !OPS(idle_spins)( test, c8->dt ) ) { return skipped; }
+
+        unsigned long iterations = budget / 3;
+        if ( iterations > 0 ) { c8->v[x] = c8->dt; }
+        return skipped + iterations * 3;
+    }
+
+    return 0;
+}
+
+/* count the delay and sound timers down by one tick */
+static inline void
+OPS(tick) ( OPS_T *c8 ) {
+    if (c8->st == 1) { c8->beep = 1; }
+    if (c8->st > 0)  { c8->st--; }
+    if (c8->dt > 0)  { c8->dt--; }
+}
+
+/* runs what is left of the current frame through run, an engine's run
+   function, and ticks the timers once the frame's budget is spent. idle
+   loops are skipped over rather than run and a blocked key wait idles away
+   the rest of the frame. returns 1 once the frame is complete, 0 if run
+   stopped early for the reason in c8->yield, in which case the next call
+   carries on with the same frame */
+static inline int
+OPS(frame) ( OPS_T *c8,
+             unsigned long (*run) ( void *ctx, OPS_T *c8, unsigned long cycles ),
+             void *ctx ) {
+    PROFILE_FRAME_BEGIN(start);
+    if ( c8->cycles_left == 0 ) { c8->cycles_left = c8->ipf; }
+    c8->yield = 0;
+
+    /* a traced machine runs its idle loops so they show up in the trace */
+    unsigned long idle = OPS_TRACED(c8)? 0 : OPS(idle)( c8, c8->cycles_left );
+    c8->cycles_left -= idle;
+    c8->idle += idle;
+
+    if ( c8->cycles_left > 0 && !c8->yield ) {
+        unsigned long done = run( ctx, c8, c8->cycles_left );
+        c8->cycles_left -= done;
+        c8->instructions += done;
+    }
+    if ( c8->cycles_left > 0 && !(c8->yield & CHIP8_YIELD_KEY) ) {
+        PROFILE_FRAME_END(start, 0);
+        return 0;
+    }
+
+    c8->idle += c8->cycles_left;
+    c8->cycles_left = 0;
+    c8->frame++;
+    OPS(tick)( c8 );
+    PROFILE_FRAME_END(start, 1);
+    return 1;
+}
+
+/* next byte of the machine's xorshift32 generator, for RND */
+static inline u8
+OPS(random) ( OPS_T *c8 ) {
+    uint32_t r = c8->rng;
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    c8->rng = r;
+    return r >> 24;
+}
+
+/* set the sound timer, asking the run loop to stop when a sound starts */
+static inline void
+OPS(sound) ( OPS_T *c8, u8 value ) {
+    if ( c8->st == 0 && value > 0 ) { c8->yield |= CHIP8_YIELD_SOUND; }
+    c8->st = value;
+}
+
+/* clear the screen */
+static inline void
+OPS(clear) ( OPS_T *c8 ) {
+    for ( int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++ ) {
+        c8->display[y] = 0;
+    }
+}
+
+/* draws n rows of the sprite at I to (vx, vy) and returns 1 on collision. */
+/* each sprite row is shifted into place across a whole display row, so a */
+/* row costs one AND for collision and one XOR, and is clipped at the */
+/* right edge */
+static inline u8
+OPS(draw) ( OPS_T *c8, u8 vx, u8 vy, u8 n ) {
+    int sx = vx % CHIP8_DISPLAY_WIDTH;  /* sprite x coord */
+    int sy = vy % CHIP8_DISPLAY_HEIGHT; /* sprite y coord */
+    chip8_row collision = 0;
+
+    if ( n + sy > CHIP8_DISPLAY_HEIGHT ) {
+        n = CHIP8_DISPLAY_HEIGHT - sy;
+    }
+
+    /* for each row of the sprite */
+    for ( int i = 0; i < n; i++, sy++ ) {
+        /* retrieve the row from memory and line it up with the display */
+        chip8_row sprite = OPS_RD( c8, (c8->i + i) & CHIP8_ADDR_MASK );
+        sprite = (sprite << (CHIP8_ROW_BITS - 8)) >> sx;
+
+        collision |= c8->display[sy] & sprite;
+        c8->display[sy] ^= sprite;
+    }
+
+    return collision != 0;
+}
+
+/* store value of Vx in BCD at location pointed to by I */
+static inline void
+OPS(bcd) ( OPS_T *c8, u8 x ) {
+    OPS_WR( c8, (c8->i + 0) & CHIP8_ADDR_MASK, (c8->v[x] / 100) );
+    OPS_WR( c8, (c8->i + 1) & CHIP8_ADDR_MASK, (c8->v[x] / 10) % 100 );
+    OPS_WR( c8, (c8->i + 2) & CHIP8_ADDR_MASK, (c8->v[x]) % 10 );
+}
+
+/* store registers V0-Vx at location pointed to by I */
+static inline void
+OPS(store) ( OPS_T *c8, u8 x ) {
+    for ( int i = 0; i <= x; i++ ) {
+        OPS_WR( c8, (c8->i + i) & CHIP8_ADDR_MASK, c8->v[i] );
+    }
+}
+
+/* load registers V0-Vx from location pointed to by I */
+static inline void
+OPS(load) ( OPS_T *c8, u8 x ) {
+    for ( int i = 0; i <= x; i++ ) {
+        c8->v[i] = OPS_RD( c8, (c8->i + i) & CHIP8_ADDR_MASK );
+    }
+}
+
+/* stores the lowest pressed key in Vx, returns 0 and asks the run loop to
+   stop if no key is down */
+static inline int
+OPS(key_wait) ( OPS_T *c8, u8 x ) {
+    if ( c8->keys == 0 ) {
+        c8->yield |= CHIP8_YIELD_KEY;
+        return 0;
+    }
+#if defined(__GNUC__)
+    c8->v[x] = __builtin_ctz( c8->keys );
+#else
+    u8 i = 0;
+    while ( !(c8->keys & (1 << i)) ) { i++; }
+    c8->v[x] = i;
+#endif
+    return 1;
+}
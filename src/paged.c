@@ -0,0 +1,240 @@
+#include "paged.h"
+#include "profile.h"
+#include "disasm.h"
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <memory.h>
+
+static struct chip8_page *
+page_of ( u8 *data ) {
+    return (struct chip8_page *) (data - offsetof(struct chip8_page, data));
+}
+
+static u8 *
+new_page ( const u8 *from ) {
+    struct chip8_page *page = malloc( sizeof(struct chip8_page) );
+
+    if ( !page ) { fprintf( stderr, "out of memory\n" ); exit(EXIT_FAILURE); }
+    atomic_init( &page->refs, 1 );
+    memcpy( page->data, from, CHIP8_PAGE_SIZE );
+    return page->data;
+}
+
+static void
+drop_page ( u8 *data ) {
+    struct chip8_page *page = page_of( data );
+
+    /* release so the last owner's writes come after every other owner's
+       reads, which may be copying the page on another thread */
+    if ( atomic_fetch_sub_explicit( &page->refs, 1, memory_order_acq_rel ) == 1 ) { free( page ); }
+}
+
+/* give the machine a page of its own to write to, unless it already has */
+static void
+copy_page ( struct chip8_paged *p, int page ) {
+    u8 *old = p->pages[page];
+
+    p->pages[page] = new_page( old );
+    if ( p->written & (1 << page) ) { drop_page( old ); }
+    p->written |= 1 << page;
+}
+
+/* where a write to addr goes, copying the page on the first write */
+static inline u8 *
+writable ( struct chip8_paged *p, u16 addr ) {
+    int page = addr >> CHIP8_PAGE_BITS;
+
+    if ( !(p->written & (1 << page)) ||
+         atomic_load_explicit( &page_of( p->pages[page] )->refs, memory_order_acquire ) > 1 ) {
+        copy_page( p, page );
+    }
+    return &p->pages[page][addr & (CHIP8_PAGE_SIZE - 1)];
+}
+
+#define OPS_T            struct chip8_paged
+#define OPS(name)        paged_op_##name
+#define OPS_RD(c8, a)    ((c8)->pages[(a) >> CHIP8_PAGE_BITS][(a) & (CHIP8_PAGE_SIZE - 1)])
+#define OPS_WR(c8, a, v) (*writable( c8, a ) = (v))
+#define OPS_TRACED(c8)   0
+
+#include "ops_tmpl.h"
+
+#define STEP_NAME chip8_paged_step
+#define STEP_TRACE(c8, pc, opcode) do { } while(0)
+
+#include "step_tmpl.h"
+
+struct chip8_image *
+chip8_image_create ( const struct chip8 *c8 ) {
+    struct chip8_image *image = malloc( sizeof(struct chip8_image) );
+
+    if ( image ) { memcpy( image->mem, c8->mem, CHIP8_MEMORY_CAPACITY ); }
+    return image;
+}
+
+void
+chip8_image_destroy ( struct chip8_image *image ) {
+    free( image );
+}
+
+void
+chip8_paged_load ( struct chip8_paged *p, const struct chip8_image *image,
+                   const struct chip8 *c8 ) {
+    memset( p, 0, sizeof(struct chip8_paged) );
+
+    p->i = c8->i;
+    p->pc = c8->pc;
+    memcpy( p->v, c8->v, sizeof(p->v) );
+    p->sp = c8->sp;
+    p->dt = c8->dt;
+    p->st = c8->st;
+    memcpy( p->stack, c8->stack, sizeof(p->stack) );
+    memcpy( p->display, c8->display, sizeof(p->display) );
+    memcpy( p->keyboard, c8->keyboard, sizeof(p->keyboard) );
+    p->keys = c8->keys;
+    p->beep = c8->beep;
+    p->rng = c8->rng;
+    p->frame = c8->frame;
+    p->ipf = c8->ipf;
+    p->cycles_left = c8->cycles_left;
+    p->yield = c8->yield;
+    p->instructions = c8->instructions;
+    p->idle = c8->idle;
+
+    for ( int page = 0; page < CHIP8_PAGES; page++ ) {
+        const u8 *mem = c8->mem + page * CHIP8_PAGE_SIZE;
+        const u8 *shared = image->mem + page * CHIP8_PAGE_SIZE;
+
+        if ( memcmp( mem, shared, CHIP8_PAGE_SIZE ) == 0 ) {
+            /* never written through while the written bit is clear */
+            p->pages[page] = (u8 *) shared;
+        } else {
+            p->pages[page] = new_page( mem );
+            p->written |= 1 << page;
+        }
+    }
+}
+
+void
+chip8_paged_store ( const struct chip8_paged *p, struct chip8 *c8 ) {
+    memset( c8, 0, sizeof(struct chip8) );
+
+    c8->i = p->i;
+    c8->pc = p->pc;
+    memcpy( c8->v, p->v, sizeof(c8->v) );
+    c8->sp = p->sp;
+    c8->dt = p->dt;
+    c8->st = p->st;
+    memcpy( c8->stack, p->stack, sizeof(c8->stack) );
+    memcpy( c8->display, p->display, sizeof(c8->display) );
+    memcpy( c8->keyboard, p->keyboard, sizeof(c8->keyboard) );
+    c8->keys = p->keys;
+    c8->beep = p->beep;
+    c8->rng = p->rng;
+    c8->frame = p->frame;
+    c8->ipf = p->ipf;
+    c8->cycles_left = p->cycles_left;
+    c8->yield = p->yield;
+    c8->instructions = p->instructions;
+    c8->idle = p->idle;
+
+    for ( int page = 0; page < CHIP8_PAGES; page++ ) {
+        memcpy( c8->mem + page * CHIP8_PAGE_SIZE, p->pages[page], CHIP8_PAGE_SIZE );
+    }
+}
+
+void
+chip8_paged_fork ( struct chip8_paged *dst, const struct chip8_paged *src ) {
+    *dst = *src;
+    for ( int page = 0; page < CHIP8_PAGES; page++ ) {
+        if ( src->written & (1 << page) ) {
+            atomic_fetch_add_explicit( &page_of( src->pages[page] )->refs, 1, memory_order_relaxed );
+        }
+    }
+}
+
+void
+chip8_paged_release ( struct chip8_paged *p ) {
+    for ( int page = 0; page < CHIP8_PAGES; page++ ) {
+        if ( p->written & (1 << page) ) { drop_page( p->pages[page] ); }
+    }
+    p->written = 0;
+}
+
+unsigned long
+chip8_paged_run_cycles ( struct chip8_paged *p, unsigned long cycles ) {
+    unsigned long done = 0;
+
+    p->yield = 0;
+    while ( done < cycles ) {
+        chip8_paged_step( p );
+        done++;
+        if ( p->yield ) { break; }
+    }
+
+    return done;
+}
+
+static unsigned long
+run_cycles ( void *ctx, struct chip8_paged *p, unsigned long cycles ) {
+    return chip8_paged_run_cycles( p, cycles );
+}
+
+int
+chip8_paged_run_frame ( struct chip8_paged *p ) {
+    return paged_op_frame( p, run_cycles, NULL );
+}
+
+void
+chip8_paged_timer_tick ( struct chip8_paged *p ) {
+    paged_op_tick( p );
+}
+
+void
+chip8_paged_key_set_state ( struct chip8_paged *p, int key, int state ) {
+    p->keyboard[key] = state;
+    if ( state == CHIP8_KEY_DOWN ) {
+        p->keys |= 1 << key;
+    } else {
+        p->keys &= ~(1 << key);
+    }
+}
+
+int
+chip8_paged_written ( const struct chip8_paged *p ) {
+    int n = 0;
+    for ( int page = 0; page < CHIP8_PAGES; page++ ) { n += (p->written >> page) & 1; }
+    return n;
+}
+
+uint64_t
+chip8_paged_hash ( const struct chip8_paged *p ) {
+    struct {
+        u16 i, pc;
+        u8 v[16];
+        u8 sp, dt, st, pad;
+        u16 stack[16];
+        uint32_t rng;
+        uint32_t written;
+    } regs;
+
+    memset( &regs, 0, sizeof(regs) );
+    regs.i = p->i;
+    regs.pc = p->pc;
+    memcpy( regs.v, p->v, sizeof(regs.v) );
+    regs.sp = p->sp;
+    regs.dt = p->dt;
+    regs.st = p->st;
+    memcpy( regs.stack, p->stack, sizeof(regs.stack) );
+    regs.rng = p->rng;
+    regs.written = p->written;
+
+    uint64_t h = hash64_words( &regs, sizeof(regs), FNV1A64_INIT );
+    h = hash64_words( p->display, sizeof(p->display), h );
+    for ( int page = 0; page < CHIP8_PAGES; page++ ) {
+        if ( p->written & (1 << page) ) { h = hash64_words( p->pages[page], CHIP8_PAGE_SIZE, h ); }
+    }
+    return h;
+}
@@ -0,0 +1,107 @@
+#ifndef _PAGED_H_
+#define _PAGED_H_
+
+#include "chip8.h"
+#include <stdatomic.h>
+
+/* paged machines, for keeping very many instances of the same program
+   around, e.g. for search or training. memory is 16 pages of 256 bytes
+   reached through a page table. every page starts out pointing into a
+   shared, read-only image of the loaded program and is copied the first
+   time the machine writes to it, which only BCD and LD [I], Vx do. a
+   machine costs about 500 bytes plus 256 per page it has written, against
+   4.5K for a struct chip8, and a fork shares the pages its parent has
+   written until one of them writes the page again.
+
+   instructions run through the same bodies as chip8_step (ops_tmpl.h and
+   step_tmpl.h), so a paged machine ends up in exactly the state a struct
+   chip8 would. paged machines are not traced and do not record input */
+
+#define CHIP8_PAGE_BITS 8
+#define CHIP8_PAGE_SIZE (1 << CHIP8_PAGE_BITS)
+#define CHIP8_PAGES     (CHIP8_MEMORY_CAPACITY / CHIP8_PAGE_SIZE)
+
+/* memory of a loaded program, shared by every machine started from it.
+   it has to outlive them */
+struct chip8_image {
+	u8 mem[CHIP8_MEMORY_CAPACITY];
+};
+
+/* a page some machine has written, shared by that machine's forks */
+struct chip8_page {
+	atomic_int refs;
+	u8 data[CHIP8_PAGE_SIZE];
+};
+
+/* fields as in struct chip8 */
+struct chip8_paged {
+	u16 i;
+	u16 pc;
+	u8  v[16];
+	u8  sp;
+	u8  dt;
+	u8  st;
+	u16 stack[16];
+
+	/* pages[p] holds addresses p * CHIP8_PAGE_SIZE on. bit p of written
+	   is set if it is the data of a struct chip8_page, otherwise it points
+	   into the image and must not be written */
+	u8 *pages[CHIP8_PAGES];
+	u16 written;
+
+	chip8_row display[CHIP8_DISPLAY_HEIGHT];
+	u8 keyboard[16];
+	u16 keys;
+	int beep;
+
+	uint32_t rng;
+	unsigned long long frame;
+	int ipf;
+	int cycles_left;
+	int yield;
+
+	unsigned long long instructions;
+	unsigned long long idle;
+};
+
+/* the memory of chip8, typically fresh from chip8_init and chip8_load.
+   NULL if out of memory */
+struct chip8_image *chip8_image_create ( const struct chip8 *chip8 );
+void chip8_image_destroy ( struct chip8_image *image );
+
+/* start paged from chip8's registers and display. pages that match image
+   are shared with it and the rest copied */
+void chip8_paged_load ( struct chip8_paged *paged, const struct chip8_image *image,
+                        const struct chip8 *chip8 );
+/* the whole machine as a struct chip8, e.g. to save its state or draw it */
+void chip8_paged_store ( const struct chip8_paged *paged, struct chip8 *chip8 );
+/* make dst a copy of src that shares all of its pages */
+void chip8_paged_fork ( struct chip8_paged *dst, const struct chip8_paged *src );
+/* give up the machine's written pages, it must be loaded or forked again
+   before it is used */
+void chip8_paged_release ( struct chip8_paged *paged );
+
+/* as the chip8_* functions of the same name */
+void chip8_paged_step ( struct chip8_paged *paged );
+unsigned long chip8_paged_run_cycles ( struct chip8_paged *paged, unsigned long cycles );
+int  chip8_paged_run_frame ( struct chip8_paged *paged );
+void chip8_paged_timer_tick ( struct chip8_paged *paged );
+void chip8_paged_key_set_state ( struct chip8_paged *paged, int key, int state );
+
+static inline u8
+chip8_paged_read ( const struct chip8_paged *paged, u16 addr ) {
+	addr &= CHIP8_ADDR_MASK;
+	return paged->pages[addr >> CHIP8_PAGE_BITS][addr & (CHIP8_PAGE_SIZE - 1)];
+}
+
+/* pages the machine has its own or a shared written copy of */
+int chip8_paged_written ( const struct chip8_paged *paged );
+
+/* hash of memory, display, registers, timers, stack and rng for telling
+   states apart during a search. it only reads the written pages, so it is
+   only comparable between machines started from the same image, and a
+   page written back to what the image holds still counts as different.
+   depends on the host's byte order like hash64_words */
+uint64_t chip8_paged_hash ( const struct chip8_paged *paged );
+
+#endif
@@ -0,0 +1,183 @@
+#include "profile.h"
+
+#ifdef CHIP8_PROFILE_ENABLE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/* mnemonics in enum chip8_profile_class order */
+static const char *class_names[PROF_CLASS_COUNT] = {
+    "CLS", "RET", "SYS", "JP", "CALL",
+    "SE Vx, kk", "SNE Vx, kk", "SE Vx, Vy", "LD Vx, kk", "ADD Vx, kk",
+    "LD Vx, Vy", "OR", "AND", "XOR", "ADD Vx, Vy", "SUB", "SHR",
+    "SUBN", "SHL", "SNE Vx, Vy", "LD I, nnn", "JP V0, nnn", "RND", "DRW",
+    "SKP", "SKNP", "LD Vx, DT", "LD Vx, K", "LD DT, Vx", "LD ST, Vx",
+    "ADD I, Vx", "LD F, Vx", "LD B, Vx", "LD [I], Vx", "LD Vx, [I]",
+    "invalid"
+};
+
+_Thread_local struct chip8_profile *chip8_profile_local;
+
+/* every thread's counters, kept after the thread exits */
+static struct chip8_profile *profiles;
+static pthread_mutex_t profiles_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+dump_at_exit ( void ) {
+    const char *path = getenv( "CHIP8_PROFILE" );
+    if ( !chip8_profile_dump( path? path : CHIP8_PROFILE_PATH ) ) {
+        fprintf( stderr, "unable to write profile \"%s\"\n", path? path : CHIP8_PROFILE_PATH );
+    }
+}
+
+struct chip8_profile *
+chip8_profile_thread ( void ) {
+    struct chip8_profile *p = calloc( 1, sizeof(struct chip8_profile) );
+    if ( !p ) { fprintf( stderr, "out of memory\n" ); exit(EXIT_FAILURE); }
+
+    pthread_mutex_lock( &profiles_lock );
+    if ( !profiles ) { atexit( dump_at_exit ); }
+    p->next = profiles;
+    profiles = p;
+    pthread_mutex_unlock( &profiles_lock );
+
+    chip8_profile_local = p;
+    return p;
+}
+
+int
+chip8_profile_class ( u16 opcode ) {
+    switch ( opcode & 0xF000 ) {
+        case 0x0000:
+            switch ( opcode & 0x0FFF ) {
+                case 0x00E0: return PROF_CLS;
+                case 0x00EE: return PROF_RET;
+                default:     return PROF_SYS;
+            }
+        case 0x1000: return PROF_JP;
+        case 0x2000: return PROF_CALL;
+        case 0x3000: return PROF_SE_VB;
+        case 0x4000: return PROF_SNE_VB;
+        case 0x5000: return PROF_SE_VV;
+        case 0x6000: return PROF_LD_VB;
+        case 0x7000: return PROF_ADD_VB;
+        case 0x8000:
+            switch ( opcode & 0x000F ) {
+                case 0x0: return PROF_LD_VV;
+                case 0x1: return PROF_OR;
+                case 0x2: return PROF_AND;
+                case 0x3: return PROF_XOR;
+                case 0x4: return PROF_ADD_VV;
+                case 0x5: return PROF_SUB;
+                case 0x6: return PROF_SHR;
+                case 0x7: return PROF_SUBN;
+                case 0xE: return PROF_SHL;
+                default:  return PROF_INVALID;
+            }
+        case 0x9000: return PROF_SNE_VV;
+        case 0xA000: return PROF_LD_I;
+        case 0xB000: return PROF_JP_V0;
+        case 0xC000: return PROF_RND;
+        case 0xD000: return PROF_DRW;
+        case 0xE000:
+            switch ( opcode & 0x00FF ) {
+                case 0x9E: return PROF_SKP;
+                case 0xA1: return PROF_SKNP;
+                default:   return PROF_INVALID;
+            }
+        default:
+            switch ( opcode & 0x00FF ) {
+                case 0x07: return PROF_LD_VDT;
+                case 0x0A: return PROF_LD_VK;
+                case 0x15: return PROF_LD_DTV;
+                case 0x18: return PROF_LD_STV;
+                case 0x1E: return PROF_ADD_IV;
+                case 0x29: return PROF_LD_FV;
+                case 0x33: return PROF_LD_BV;
+                case 0x55: return PROF_LD_MEMV;
+                case 0x65: return PROF_LD_VMEM;
+                default:   return PROF_INVALID;
+            }
+    }
+}
+
+void
+chip8_profile_frame ( unsigned long long start, int done ) {
+    struct chip8_profile *p = chip8_profile_get();
+
+    p->frame_ns += chip8_profile_now() - start;
+    if ( !done ) { return; }
+
+    int bucket = 0;
+    unsigned long long us = p->frame_ns / 1000;
+    while ( us > 1 && bucket < CHIP8_PROFILE_FRAME_BUCKETS - 1 ) { us >>= 1; bucket++; }
+
+    p->frames++;
+    p->frame_hist[bucket]++;
+    p->total_ns += p->frame_ns;
+    if ( p->frame_ns > p->max_ns ) { p->max_ns = p->frame_ns; }
+    p->frame_ns = 0;
+}
+
+int
+chip8_profile_dump ( const char *path ) {
+    static struct chip8_profile sum;
+    unsigned long long total = 0;
+    FILE *f = fopen( path, "w" );
+
+    if ( !f ) { return 0; }
+
+    pthread_mutex_lock( &profiles_lock );
+    for ( struct chip8_profile *p = profiles; p; p = p->next ) {
+        for ( int c = 0; c < PROF_CLASS_COUNT; c++ ) { sum.ops[c] += p->ops[c]; }
+        for ( int a = 0; a < CHIP8_MEMORY_CAPACITY; a++ ) { sum.pc[a] += p->pc[a]; }
+        for ( int n = 0; n < 16; n++ ) { sum.draws[n] += p->draws[n]; }
+        for ( int b = 0; b < CHIP8_PROFILE_FRAME_BUCKETS; b++ ) { sum.frame_hist[b] += p->frame_hist[b]; }
+        sum.frames += p->frames;
+        sum.total_ns += p->total_ns;
+        if ( p->max_ns > sum.max_ns ) { sum.max_ns = p->max_ns; }
+    }
+    pthread_mutex_unlock( &profiles_lock );
+
+    for ( int c = 0; c < PROF_CLASS_COUNT; c++ ) { total += sum.ops[c]; }
+
+    fprintf( f, "{\n  \"instructions\": %llu,\n  \"classes\": {", total );
+    for ( int c = 0, first = 1; c < PROF_CLASS_COUNT; c++ ) {
+        if ( sum.ops[c] == 0 ) { continue; }
+        fprintf( f, "%s\n    \"%s\": %llu", first? "" : ",", class_names[c], sum.ops[c] );
+        first = 0;
+    }
+
+    fprintf( f, "\n  },\n  \"draws\": [" );
+    for ( int n = 0; n < 16; n++ ) {
+        fprintf( f, "%s%llu", n? ", " : "", sum.draws[n] );
+    }
+
+    /* addresses that executed anything, in address order */
+    fprintf( f, "],\n  \"pc\": {" );
+    for ( int a = 0, first = 1; a < CHIP8_MEMORY_CAPACITY; a++ ) {
+        if ( sum.pc[a] == 0 ) { continue; }
+        fprintf( f, "%s\n    \"0x%03X\": %llu", first? "" : ",", a, sum.pc[a] );
+        first = 0;
+    }
+
+    double mean = sum.frames? sum.total_ns / 1e3 / sum.frames : 0;
+    fprintf( f, "\n  },\n  \"frames\": {\n    \"count\": %llu,\n", sum.frames );
+    fprintf( f, "    \"total_ms\": %.3f,\n    \"mean_us\": %.3f,\n    \"max_us\": %.3f,\n",
+        sum.total_ns / 1e6, mean, sum.max_ns / 1e3 );
+
+    /* bucket b counts frames that took less than 2^(b+1) us */
+    fprintf( f, "    \"histogram_us\": {" );
+    for ( int b = 0, first = 1; b < CHIP8_PROFILE_FRAME_BUCKETS; b++ ) {
+        if ( sum.frame_hist[b] == 0 ) { continue; }
+        fprintf( f, "%s\n      \"%llu\": %llu", first? "" : ",", 2ull << b, sum.frame_hist[b] );
+        first = 0;
+    }
+    fprintf( f, "\n    }\n  }\n}\n" );
+
+    fclose(f);
+    return 1;
+}
+
+#endif
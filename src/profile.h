@@ -0,0 +1,93 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include "chip8.h"
+
+/* uncomment, or build with make PROFILE=1, to count executed instructions
+   by class and by address, sprite draws by height and time spent per frame.
+   the counts are written as JSON when the program exits, to the file named
+   by CHIP8_PROFILE or chip8-profile.json. without it every PROFILE_* macro
+   is empty and its arguments are never evaluated */
+/* #define CHIP8_PROFILE_ENABLE */
+
+#ifdef CHIP8_PROFILE_ENABLE
+
+#include <time.h>
+
+#define CHIP8_PROFILE_PATH "chip8-profile.json"
+
+/* frame times are histogrammed in power of two microsecond buckets */
+#define CHIP8_PROFILE_FRAME_BUCKETS 24
+
+enum chip8_profile_class {
+	PROF_CLS, PROF_RET, PROF_SYS, PROF_JP, PROF_CALL,
+	PROF_SE_VB, PROF_SNE_VB, PROF_SE_VV, PROF_LD_VB, PROF_ADD_VB,
+	PROF_LD_VV, PROF_OR, PROF_AND, PROF_XOR, PROF_ADD_VV, PROF_SUB, PROF_SHR,
+	PROF_SUBN, PROF_SHL, PROF_SNE_VV, PROF_LD_I, PROF_JP_V0, PROF_RND, PROF_DRW,
+	PROF_SKP, PROF_SKNP, PROF_LD_VDT, PROF_LD_VK, PROF_LD_DTV, PROF_LD_STV,
+	PROF_ADD_IV, PROF_LD_FV, PROF_LD_BV, PROF_LD_MEMV, PROF_LD_VMEM,
+	PROF_INVALID,
+	PROF_CLASS_COUNT
+};
+
+/* counters of one thread, threads never share one so no atomics are needed */
+struct chip8_profile {
+	unsigned long long ops[PROF_CLASS_COUNT];
+	unsigned long long pc[CHIP8_MEMORY_CAPACITY];
+	unsigned long long draws[16];  /* Dxyn by n */
+
+	unsigned long long frames;
+	unsigned long long frame_ns;   /* current frame so far */
+	unsigned long long total_ns;
+	unsigned long long max_ns;
+	unsigned long long frame_hist[CHIP8_PROFILE_FRAME_BUCKETS];
+
+	struct chip8_profile *next;
+};
+
+extern _Thread_local struct chip8_profile *chip8_profile_local;
+
+/* allocate and register the calling thread's counters */
+struct chip8_profile *chip8_profile_thread ( void );
+int  chip8_profile_class ( u16 opcode );
+void chip8_profile_frame ( unsigned long long start, int done );
+/* write every thread's counters summed up as JSON */
+int  chip8_profile_dump ( const char *path );
+
+static inline struct chip8_profile *
+chip8_profile_get ( void ) {
+	return chip8_profile_local? chip8_profile_local : chip8_profile_thread();
+}
+
+static inline unsigned long long
+chip8_profile_now ( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline void
+chip8_profile_op ( u16 pc, u16 opcode ) {
+	struct chip8_profile *p = chip8_profile_get();
+	int cls = chip8_profile_class( opcode );
+
+	p->ops[cls]++;
+	p->pc[pc]++;
+	if ( cls == PROF_DRW ) { p->draws[opcode & 0xF]++; }
+}
+
+/* an instruction at pc is about to execute */
+#define PROFILE_OP(pc, opcode)  chip8_profile_op( (pc), (opcode) )
+/* bracket a call that runs (part of) a frame, done is 1 once it completed */
+#define PROFILE_FRAME_BEGIN(t)  unsigned long long t = chip8_profile_now()
+#define PROFILE_FRAME_END(t, done) chip8_profile_frame( (t), (done) )
+
+#else
+
+#define PROFILE_OP(pc, opcode)     do { } while(0)
+#define PROFILE_FRAME_BEGIN(t)     do { } while(0)
+#define PROFILE_FRAME_END(t, done) do { } while(0)
+
+#endif
+
+#endif
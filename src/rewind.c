@@ -0,0 +1,171 @@
+#include "rewind.h"
+#include "state.h"
+#include "rle.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct snapshot {
+    uint32_t off;  /* position in data */
+    uint32_t len;
+    int key;       /* keyframe rather than a delta */
+};
+
+struct chip8_rewind {
+    u8 *data;
+    size_t size;
+    size_t used;           /* bytes held by live snapshots */
+
+    struct snapshot *snaps; /* ring, oldest at head */
+    int max, head, count;
+    int interval;
+    int since_key;         /* snapshots since the newest keyframe */
+
+    u8 cur[CHIP8_STATE_SIZE];   /* newest snapshot, uncompressed */
+    u8 next[CHIP8_STATE_SIZE];
+    u8 enc[RLE_BOUND(CHIP8_STATE_SIZE)];
+};
+
+static struct snapshot *
+nth ( struct chip8_rewind *r, int k ) {
+    return &r->snaps[(r->head + k) % r->max];
+}
+
+struct chip8_rewind *
+chip8_rewind_create ( size_t bytes, int max_snapshots, int keyframe_interval ) {
+    struct chip8_rewind *r;
+
+    if ( bytes < RLE_BOUND(CHIP8_STATE_SIZE) || max_snapshots < 2 ) { return NULL; }
+
+    r = calloc( 1, sizeof(struct chip8_rewind) );
+    if ( !r ) { return NULL; }
+
+    r->data = malloc( bytes );
+    r->snaps = calloc( max_snapshots, sizeof(struct snapshot) );
+    if ( !r->data || !r->snaps ) {
+        chip8_rewind_destroy( r );
+        return NULL;
+    }
+
+    r->size = bytes;
+    r->max = max_snapshots;
+    r->interval = (keyframe_interval > 0)? keyframe_interval : 1;
+
+    return r;
+}
+
+void
+chip8_rewind_destroy ( struct chip8_rewind *r ) {
+    if ( !r ) { return; }
+    free( r->data );
+    free( r->snaps );
+    free( r );
+}
+
+void
+chip8_rewind_clear ( struct chip8_rewind *r ) {
+    r->head = r->count = 0;
+    r->used = 0;
+    r->since_key = 0;
+}
+
+/* drop the oldest keyframe along with the deltas that depend on it */
+static void
+evict ( struct chip8_rewind *r ) {
+    do {
+        r->used -= nth( r, 0 )->len;
+        r->head = (r->head + 1) % r->max;
+        r->count--;
+    } while ( r->count > 0 && !nth( r, 0 )->key );
+}
+
+/* find room for len contiguous bytes after the newest snapshot, evicting
+   old ones as needed. returns the offset or -1 if everything had to go */
+static long
+reserve ( struct chip8_rewind *r, size_t len ) {
+    while ( r->count > 0 ) {
+        const struct snapshot *first = nth( r, 0 );
+        const struct snapshot *last = nth( r, r->count - 1 );
+        size_t wpos = last->off + last->len;
+
+        if ( r->count < r->max ) {
+            if ( last->off >= first->off ) {
+                /* free space after the newest and before the oldest */
+                if ( r->size - wpos >= len ) { return wpos; }
+                if ( first->off >= len ) { return 0; }
+            } else if ( first->off - wpos >= len ) {
+                /* wrapped, free space is between the two */
+                return wpos;
+            }
+        }
+        evict( r );
+    }
+    return -1;
+}
+
+void
+chip8_rewind_push ( struct chip8_rewind *r, const struct chip8 *c8 ) {
+    int key = r->count == 0 || r->since_key + 1 >= r->interval;
+    size_t len;
+    long off;
+
+    chip8_save_state( c8, r->next, sizeof(r->next) );
+    len = rle_encode_xor( r->next, key? NULL : r->cur, CHIP8_STATE_SIZE, r->enc );
+
+    off = reserve( r, len );
+    if ( off < 0 ) {
+        /* the snapshot this delta was against is gone, store it whole */
+        if ( !key ) {
+            key = 1;
+            len = rle_encode_xor( r->next, NULL, CHIP8_STATE_SIZE, r->enc );
+        }
+        off = 0;
+    }
+
+    memcpy( r->data + off, r->enc, len );
+    *nth( r, r->count ) = (struct snapshot) { off, len, key };
+    r->count++;
+    r->used += len;
+    r->since_key = key? 0 : r->since_key + 1;
+    memcpy( r->cur, r->next, CHIP8_STATE_SIZE );
+}
+
+int
+chip8_rewind_step ( struct chip8_rewind *r, struct chip8 *c8 ) {
+    if ( r->count < 2 ) { return 0; }
+
+    const struct snapshot *last = nth( r, r->count - 1 );
+
+    if ( !last->key ) {
+        /* the delta takes the newest snapshot back to the one before */
+        rle_decode_xor( r->data + last->off, last->len, r->cur, CHIP8_STATE_SIZE );
+    } else {
+        /* rebuild from the keyframe before it */
+        int k = r->count - 2;
+        while ( !nth( r, k )->key ) { k--; }
+
+        memset( r->cur, 0, CHIP8_STATE_SIZE );
+        for ( ; k < r->count - 1; k++ ) {
+            const struct snapshot *s = nth( r, k );
+            rle_decode_xor( r->data + s->off, s->len, r->cur, CHIP8_STATE_SIZE );
+        }
+    }
+
+    r->used -= last->len;
+    r->count--;
+
+    /* count back to the newest keyframe */
+    r->since_key = 0;
+    while ( !nth( r, r->count - 1 - r->since_key )->key ) { r->since_key++; }
+
+    return chip8_load_state( c8, r->cur, CHIP8_STATE_SIZE );
+}
+
+int
+chip8_rewind_count ( const struct chip8_rewind *r ) {
+    return r->count;
+}
+
+size_t
+chip8_rewind_used ( const struct chip8_rewind *r ) {
+    return r->used;
+}
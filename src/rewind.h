@@ -0,0 +1,32 @@
+#ifndef _REWIND_H_
+#define _REWIND_H_
+
+#include "chip8.h"
+#include <stddef.h>
+
+/* rewind history. every snapshot is a save state, stored either whole as a
+   keyframe or as the XOR against the snapshot before it, both run length
+   coded. the newest snapshot is also kept uncompressed, so stepping back
+   over a delta is one XOR pass and stepping back over a keyframe replays
+   at most one keyframe interval of deltas. when the buffer fills up the
+   oldest keyframe and its deltas are dropped */
+struct chip8_rewind;
+
+/* bytes of compressed history, most snapshots kept, and a keyframe every
+   keyframe_interval snapshots. returns NULL on failure */
+struct chip8_rewind *chip8_rewind_create ( size_t bytes, int max_snapshots, int keyframe_interval );
+void chip8_rewind_destroy ( struct chip8_rewind *rewind );
+void chip8_rewind_clear ( struct chip8_rewind *rewind );
+
+/* take a snapshot of chip8 */
+void chip8_rewind_push ( struct chip8_rewind *rewind, const struct chip8 *chip8 );
+
+/* drop the newest snapshot and restore chip8 to the one before it. returns
+   0 and leaves chip8 alone if there is nothing older to go back to */
+int chip8_rewind_step ( struct chip8_rewind *rewind, struct chip8 *chip8 );
+
+/* snapshots held and compressed bytes they take up */
+int    chip8_rewind_count ( const struct chip8_rewind *rewind );
+size_t chip8_rewind_used ( const struct chip8_rewind *rewind );
+
+#endif
@@ -0,0 +1,82 @@
+#include "rle.h"
+#include <string.h>
+
+#define RLE_MAX_RUN 128
+
+static u8
+at ( const u8 *a, const u8 *b, size_t i ) {
+    return b? a[i] ^ b[i] : a[i];
+}
+
+/* length of the zero run starting at i, stepping 8 bytes at a time */
+static size_t
+zeros ( const u8 *a, const u8 *b, size_t i, size_t n ) {
+    size_t start = i;
+
+    while ( i + 8 <= n ) {
+        uint64_t x, y = 0;
+        memcpy( &x, a + i, 8 );
+        if ( b ) { memcpy( &y, b + i, 8 ); }
+        if ( x != y ) { break; }
+        i += 8;
+    }
+    while ( i < n && at( a, b, i ) == 0 ) { i++; }
+
+    return i - start;
+}
+
+size_t
+rle_encode_xor ( const u8 *a, const u8 *b, size_t n, u8 *dst ) {
+    u8 *p = dst;
+    size_t i = 0;
+
+    while ( i < n ) {
+        size_t run = zeros( a, b, i, n );
+
+        /* a single zero is cheaper inside a literal */
+        if ( run >= 2 || (run == 1 && i + 1 == n) ) {
+            i += run;
+            while ( run > 0 ) {
+                size_t k = (run > RLE_MAX_RUN)? RLE_MAX_RUN : run;
+                *p++ = 0x7F + k;
+                run -= k;
+            }
+            continue;
+        }
+
+        /* literal up to the next pair of zeros */
+        u8 *ctl = p++;
+        size_t k = 0;
+        while ( i < n && k < RLE_MAX_RUN ) {
+            if ( at( a, b, i ) == 0 && i + 1 < n && at( a, b, i + 1 ) == 0 ) { break; }
+            *p++ = at( a, b, i++ );
+            k++;
+        }
+        *ctl = k - 1;
+    }
+
+    return p - dst;
+}
+
+int
+rle_decode_xor ( const u8 *src, size_t len, u8 *dst, size_t n ) {
+    const u8 *end = src + len;
+    size_t i = 0;
+
+    while ( src < end ) {
+        u8 c = *src++;
+
+        if ( c >= 0x80 ) {
+            i += c - 0x7F;
+            continue;
+        }
+
+        size_t k = c + 1;
+        if ( i + k > n || src + k > end ) { return 0; }
+        for ( size_t j = 0; j < k; j++ ) { dst[i + j] ^= src[j]; }
+        src += k;
+        i += k;
+    }
+
+    return i == n;
+}
@@ -0,0 +1,23 @@
+#ifndef _RLE_H_
+#define _RLE_H_
+
+#include "chip8.h"
+#include <stddef.h>
+
+/* run length coding for images that are mostly zero, such as the XOR of
+   two snapshots. a control byte c below 0x80 is followed by c + 1 literal
+   bytes, c from 0x80 up stands for a run of c - 0x7F zero bytes */
+
+/* worst case encoded size of n bytes */
+#define RLE_BOUND(n) ((n) + ((n) + 127) / 128)
+
+/* encode the n bytes a ^ b into dst, b may be NULL to encode a itself.
+   returns the encoded size, at most RLE_BOUND(n) */
+size_t rle_encode_xor ( const u8 *a, const u8 *b, size_t n, u8 *dst );
+
+/* decode len bytes of src and XOR the result into the n bytes at dst,
+   decode into a zeroed dst to get the plain bytes back. returns 0 if src
+   does not decode to exactly n bytes */
+int rle_decode_xor ( const u8 *src, size_t len, u8 *dst, size_t n );
+
+#endif
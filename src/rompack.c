@@ -0,0 +1,191 @@
+#include "rompack.h"
+#include "hash.h"
+#include "le.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const u8 magic[4] = { 'C', '8', 'P', 'K' };
+
+static const u8 *
+entry ( const struct chip8_rompack *pack, uint32_t i ) {
+    return pack->base + CHIP8_ROMPACK_HEADER + (size_t) i * CHIP8_ROMPACK_ENTRY;
+}
+
+/* the header, the index and every rom have to lie inside the file, with
+   the index sorted so it can be searched */
+static int
+valid ( const struct chip8_rompack *pack ) {
+    if ( pack->size < CHIP8_ROMPACK_HEADER ) { return 0; }
+    if ( memcmp( pack->base, magic, 4 ) != 0 ) { return 0; }
+    if ( get16( pack->base + 4 ) != CHIP8_ROMPACK_VERSION ) { return 0; }
+
+    uint32_t count = get32( pack->base + 8 );
+    if ( (pack->size - CHIP8_ROMPACK_HEADER) / CHIP8_ROMPACK_ENTRY < count ) { return 0; }
+
+    for ( uint32_t i = 0; i < count; i++ ) {
+        const u8 *e = entry( pack, i );
+        uint32_t offset = get32( e + 8 );
+        uint32_t len = get32( e + 12 );
+
+        if ( len > CHIP8_ROM_MAX || offset > pack->size || len > pack->size - offset ) { return 0; }
+        if ( i > 0 && get64( e - CHIP8_ROMPACK_ENTRY ) >= get64( e ) ) { return 0; }
+    }
+
+    return 1;
+}
+
+struct chip8_rompack *
+chip8_rompack_open ( const char *path ) {
+    struct chip8_rompack *pack;
+    struct stat st;
+    int fd = open( path, O_RDONLY );
+
+    if ( fd < 0 ) { return NULL; }
+    if ( fstat( fd, &st ) != 0 || st.st_size < CHIP8_ROMPACK_HEADER ) {
+        close( fd );
+        return NULL;
+    }
+
+    void *base = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( base == MAP_FAILED ) { return NULL; }
+#ifdef MADV_WILLNEED
+    /* it is all going to be read, start paging it in now */
+    madvise( base, st.st_size, MADV_WILLNEED );
+#endif
+
+    pack = malloc( sizeof(struct chip8_rompack) );
+    if ( !pack ) {
+        munmap( base, st.st_size );
+        return NULL;
+    }
+    pack->base = base;
+    pack->size = st.st_size;
+
+    if ( !valid( pack ) ) {
+        chip8_rompack_close( pack );
+        return NULL;
+    }
+    pack->count = get32( pack->base + 8 );
+    return pack;
+}
+
+void
+chip8_rompack_close ( struct chip8_rompack *pack ) {
+    munmap( (void *) pack->base, pack->size );
+    free( pack );
+}
+
+long
+chip8_rompack_find ( const struct chip8_rompack *pack, uint64_t hash ) {
+    uint32_t lo = 0, hi = pack->count;
+
+    while ( lo < hi ) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint64_t h = get64( entry( pack, mid ) );
+
+        if ( h == hash ) { return mid; }
+        if ( h < hash ) { lo = mid + 1; } else { hi = mid; }
+    }
+    return -1;
+}
+
+uint64_t
+chip8_rompack_rom ( const struct chip8_rompack *pack, uint32_t i,
+                    const u8 **rom, size_t *len ) {
+    const u8 *e = entry( pack, i );
+
+    *rom = pack->base + get32( e + 8 );
+    *len = get32( e + 12 );
+    return get64( e );
+}
+
+int
+chip8_rompack_load ( const struct chip8_rompack *pack, uint32_t i, struct chip8 *c8 ) {
+    const u8 *rom;
+    size_t len;
+
+    chip8_rompack_rom( pack, i, &rom, &len );
+    return chip8_load_mem( c8, rom, len );
+}
+
+struct pending {
+    uint64_t hash;
+    size_t rom;     /* index into the caller's arrays */
+};
+
+static int
+by_hash ( const void *a, const void *b ) {
+    uint64_t x = ((const struct pending *) a)->hash;
+    uint64_t y = ((const struct pending *) b)->hash;
+    return (x > y) - (x < y);
+}
+
+long
+chip8_rompack_write ( const char *path, const u8 *const *roms, const size_t *lens, size_t n ) {
+    struct pending *sorted = malloc( sizeof(struct pending) * (n? n : 1) );
+    u8 buf[CHIP8_ROMPACK_HEADER];
+    size_t count = 0;
+    FILE *f;
+
+    if ( !sorted ) { return -1; }
+
+    for ( size_t r = 0; r < n; r++ ) {
+        if ( lens[r] > CHIP8_ROM_MAX ) { free( sorted ); return -1; }
+        sorted[r].hash = fnv1a64( roms[r], lens[r], FNV1A64_INIT );
+        sorted[r].rom = r;
+    }
+    qsort( sorted, n, sizeof(struct pending), by_hash );
+
+    /* identical roms have identical hashes and end up next to each other.
+       different roms with the same hash cannot both be found by hash, so
+       the pack is not written */
+    for ( size_t r = 0; r < n; r++ ) {
+        if ( count > 0 && sorted[count - 1].hash == sorted[r].hash ) {
+            size_t kept = sorted[count - 1].rom, rom = sorted[r].rom;
+            if ( lens[kept] == lens[rom] && memcmp( roms[kept], roms[rom], lens[rom] ) == 0 ) { continue; }
+            free( sorted );
+            return CHIP8_ROMPACK_COLLISION;
+        }
+        sorted[count++] = sorted[r];
+    }
+
+    /* offsets are 32 bits */
+    size_t size = CHIP8_ROMPACK_HEADER + count * CHIP8_ROMPACK_ENTRY;
+    for ( size_t r = 0; r < count; r++ ) { size += lens[sorted[r].rom]; }
+    if ( size > UINT32_MAX || (f = fopen( path, "wb" )) == NULL ) {
+        free( sorted );
+        return -1;
+    }
+
+    u8 *p = buf;
+    memcpy( p, magic, 4 ); p += 4;
+    p = put16( p, CHIP8_ROMPACK_VERSION );
+    p = put16( p, 0 );
+    p = put32( p, count );
+    p = put32( p, 0 );
+    fwrite( buf, 1, CHIP8_ROMPACK_HEADER, f );
+
+    size_t offset = CHIP8_ROMPACK_HEADER + count * CHIP8_ROMPACK_ENTRY;
+    for ( size_t r = 0; r < count; r++ ) {
+        size_t len = lens[sorted[r].rom];
+
+        p = put64( buf, sorted[r].hash );
+        p = put32( p, offset );
+        p = put32( p, len );
+        fwrite( buf, 1, CHIP8_ROMPACK_ENTRY, f );
+        offset += len;
+    }
+    for ( size_t r = 0; r < count; r++ ) {
+        fwrite( roms[sorted[r].rom], 1, lens[sorted[r].rom], f );
+    }
+
+    free( sorted );
+    int error = ferror( f );
+    return (fclose( f ) == 0 && !error)? (long) count : -1;
+}
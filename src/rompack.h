@@ -0,0 +1,46 @@
+#ifndef _ROMPACK_H_
+#define _ROMPACK_H_
+
+#include "chip8.h"
+#include <stddef.h>
+
+/* rom packs, many roms in one file addressed by the FNV-1a hash of their
+   contents. a pack is mapped into memory once and loading a rom from it is
+   a memcpy, so a batch over tens of thousands of roms does no file i/o of
+   its own after opening the pack.
+
+   file layout, little endian: "C8PK", u16 version, u16 reserved, u32 rom
+   count, u32 reserved, then per rom, sorted by hash, u64 hash, u32 offset
+   of the rom from the start of the file, u32 length, then the roms */
+
+#define CHIP8_ROMPACK_VERSION 1
+#define CHIP8_ROMPACK_HEADER  16
+#define CHIP8_ROMPACK_ENTRY   16
+
+/* chip8_rompack_write result when two different roms share a hash */
+#define CHIP8_ROMPACK_COLLISION -2
+
+struct chip8_rompack {
+	const u8 *base;     /* the mapped file */
+	size_t size;
+	uint32_t count;
+};
+
+/* map a pack, NULL if it cannot be read or is not a valid pack */
+struct chip8_rompack *chip8_rompack_open ( const char *path );
+void chip8_rompack_close ( struct chip8_rompack *pack );
+
+/* index of the rom with that hash, -1 if there is none */
+long chip8_rompack_find ( const struct chip8_rompack *pack, uint64_t hash );
+/* hash, contents and length of rom i, 0 <= i < count */
+uint64_t chip8_rompack_rom ( const struct chip8_rompack *pack, uint32_t i,
+                             const u8 **rom, size_t *len );
+/* chip8_load_mem from rom i */
+int chip8_rompack_load ( const struct chip8_rompack *pack, uint32_t i, struct chip8 *chip8 );
+
+/* write n roms as a pack, identical roms are stored once. returns the
+   number stored, -1 if path could not be written or
+   CHIP8_ROMPACK_COLLISION if two different roms have the same hash */
+long chip8_rompack_write ( const char *path, const u8 *const *roms, const size_t *lens, size_t n );
+
+#endif
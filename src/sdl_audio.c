@@ -0,0 +1,69 @@
+#include "sdl_audio.h"
+
+#include <stdlib.h>
+
+static void
+callback ( void *arg, Uint8 *stream, int len ) {
+    struct audio *a = arg;
+    Sint16 *out = (Sint16 *) stream;
+    int n = len / sizeof(Sint16);
+
+    /* only the newest write matters, the countdown is done here */
+    unsigned tail = atomic_load_explicit( &a->tail, memory_order_relaxed );
+    unsigned head = atomic_load_explicit( &a->head, memory_order_acquire );
+    if ( tail != head ) {
+        a->remaining = a->ring[(head - 1) % AUDIO_RING] * a->samples_per_tick;
+        atomic_store_explicit( &a->tail, head, memory_order_release );
+    }
+
+    for ( int i = 0; i < n; i++ ) {
+        if ( a->remaining == 0 ) {
+            out[i] = 0;
+            continue;
+        }
+        a->remaining--;
+        out[i] = (a->phase < a->half_wave)? AUDIO_VOLUME : -AUDIO_VOLUME;
+        if ( ++a->phase == 2 * a->half_wave ) { a->phase = 0; }
+    }
+}
+
+struct audio *
+audio_open ( double rate ) {
+    struct audio *a = calloc( 1, sizeof(struct audio) );
+    SDL_AudioSpec want = { 0 }, have;
+
+    if ( !a ) { return NULL; }
+
+    want.freq = AUDIO_FREQ;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = AUDIO_SAMPLES;
+    want.callback = callback;
+    want.userdata = a;
+
+    a->device = SDL_OpenAudioDevice( NULL, 0, &want, &have, 0 );
+    if ( a->device == 0 ) {
+        free( a );
+        return NULL;
+    }
+
+    a->samples_per_tick = have.freq / rate;
+    a->half_wave = have.freq / AUDIO_TONE / 2;
+    SDL_PauseAudioDevice( a->device, 0 );
+    return a;
+}
+
+void
+audio_close ( struct audio *a ) {
+    SDL_CloseAudioDevice( a->device );
+    free( a );
+}
+
+void
+audio_sound ( struct audio *a, u8 st ) {
+    unsigned head = atomic_load_explicit( &a->head, memory_order_relaxed );
+
+    if ( head - atomic_load_explicit( &a->tail, memory_order_acquire ) == AUDIO_RING ) { return; }
+    a->ring[head % AUDIO_RING] = st;
+    atomic_store_explicit( &a->head, head + 1, memory_order_release );
+}
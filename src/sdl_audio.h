@@ -0,0 +1,46 @@
+#ifndef _SDL_AUDIO_H_
+#define _SDL_AUDIO_H_
+
+#include "chip8.h"
+
+#include <stdatomic.h>
+
+#include <SDL2/SDL.h>
+
+/* the beeper. the emulation thread reports every write to the sound timer
+   through a single producer, single consumer ring and the SDL audio
+   callback turns the newest into a square wave of st timer ticks, counting
+   it down by itself. the emulation thread never waits on the audio device,
+   and a sound starts at the latest one audio buffer after it was set */
+
+#define AUDIO_FREQ     48000
+#define AUDIO_SAMPLES  512     /* per callback, about 11 ms */
+#define AUDIO_TONE     440     /* Hz */
+#define AUDIO_VOLUME   4000
+#define AUDIO_RING     64      /* a power of two */
+
+struct audio {
+	SDL_AudioDeviceID device;
+
+	/* sound timer writes, emulation thread to audio callback */
+	u8 ring[AUDIO_RING];
+	atomic_uint head;
+	atomic_uint tail;
+
+	/* audio callback only */
+	Uint32 samples_per_tick;
+	Uint32 half_wave;        /* samples per half period of the tone */
+	Uint32 phase;
+	Uint32 remaining;        /* samples still to sound */
+};
+
+/* open the default device with a sound timer ticking rate times a second,
+   NULL if there is no audio */
+struct audio *audio_open ( double rate );
+void audio_close ( struct audio *a );
+
+/* the sound timer was set to st, 0 stops the sound. dropped if the
+   callback has fallen a whole ring behind */
+void audio_sound ( struct audio *a, u8 st );
+
+#endif
@@ -0,0 +1,66 @@
+#include "sdl_overlay.h"
+#include "chip8.h"
+
+#define GLYPH_W 4
+#define GLYPH_H 5
+
+static int
+digits ( unsigned value ) {
+    int n = 1;
+    while ( value >= 10 ) { value /= 10; n++; }
+    return n;
+}
+
+int
+overlay_number_width ( unsigned value ) {
+    /* a pixel of padding around the digits and between them */
+    return digits( value ) * (GLYPH_W + 1) + 1;
+}
+
+int
+overlay_number ( SDL_Renderer *renderer, int x, int y, unsigned value, Uint32 rgb ) {
+    int n = digits( value );
+    int w = overlay_number_width( value );
+    SDL_Rect box = { x, y, w, GLYPH_H + 2 };
+
+    SDL_SetRenderDrawBlendMode( renderer, SDL_BLENDMODE_BLEND );
+    SDL_SetRenderDrawColor( renderer, 0, 0, 0, 192 );
+    SDL_RenderFillRect( renderer, &box );
+    SDL_SetRenderDrawColor( renderer, rgb >> 16, rgb >> 8, rgb, 255 );
+
+    /* right to left, least significant digit first */
+    for ( int d = n - 1; d >= 0; d--, value /= 10 ) {
+        const u8 *glyph = chip8_fonts + (value % 10) * GLYPH_H;
+        int gx = x + 1 + d * (GLYPH_W + 1);
+
+        for ( int row = 0; row < GLYPH_H; row++ ) {
+            for ( int col = 0; col < GLYPH_W; col++ ) {
+                if ( glyph[row] & (0x80 >> col) ) {
+                    SDL_Rect px = { gx + col, y + 1 + row, 1, 1 };
+                    SDL_RenderFillRect( renderer, &px );
+                }
+            }
+        }
+    }
+
+    return w;
+}
+
+void
+overlay_graph ( SDL_Renderer *renderer, int x, int y, int h,
+                const unsigned *values, int n, unsigned full, Uint32 rgb ) {
+    SDL_Rect box = { x, y, n, h };
+
+    SDL_SetRenderDrawBlendMode( renderer, SDL_BLENDMODE_BLEND );
+    SDL_SetRenderDrawColor( renderer, 0, 0, 0, 192 );
+    SDL_RenderFillRect( renderer, &box );
+    SDL_SetRenderDrawColor( renderer, rgb >> 16, rgb >> 8, rgb, 255 );
+
+    for ( int i = 0; i < n; i++ ) {
+        int bar = (values[i] >= full)? h : (int) ((unsigned long long) values[i] * h / full);
+        if ( bar == 0 ) { continue; }
+
+        SDL_Rect px = { x + i, y + h - bar, 1, bar };
+        SDL_RenderFillRect( renderer, &px );
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef _SDL_OVERLAY_H_
+#define _SDL_OVERLAY_H_
+
+#include <SDL2/SDL.h>
+
+/* draws value in decimal with the chip-8 font digits over a dark box, top
+   left corner at x, y in renderer coordinates, one unit per font pixel.
+   returns the width drawn */
+int overlay_number ( SDL_Renderer *renderer, int x, int y, unsigned value, Uint32 rgb );
+
+/* width overlay_number takes for value */
+int overlay_number_width ( unsigned value );
+
+/* draws n values as one pixel wide bars over a dark box h high, top left
+   corner at x, y. a value of full or more fills the height */
+void overlay_graph ( SDL_Renderer *renderer, int x, int y, int h,
+                     const unsigned *values, int n, unsigned full, Uint32 rgb );
+
+#endif
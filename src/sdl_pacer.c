@@ -0,0 +1,155 @@
+#include "sdl_pacer.h"
+
+#include <limits.h>
+#include <memory.h>
+
+/* presents this close to a whole number of periods apart count as exactly
+   that many periods in vsync mode */
+#define VSYNC_SNAP 8    /* 1/8th of a period */
+
+void
+pacer_init ( struct pacer *p, double hz, int max_behind ) {
+    memset( p, 0, sizeof(struct pacer) );
+    p->freq = SDL_GetPerformanceFrequency();
+    p->period = p->freq / hz;
+    p->next = SDL_GetPerformanceCounter();
+    p->margin = p->freq / 500;  /* 2 ms until SDL_Delay has been measured */
+    p->max_behind = max_behind;
+}
+
+void
+pacer_wait ( struct pacer *p ) {
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    /* after a stall, e.g. in a debugger, catch up a few frames at most */
+    if ( now > p->next + p->period * p->max_behind ) {
+        p->next = now - p->period * p->max_behind;
+    }
+
+    /* sleep while that cannot overshoot the deadline. the margin jumps to
+       the latest wake-up seen and creeps back down as sleeps get better */
+    while ( now + p->margin < p->next ) {
+        Uint32 ms = (p->next - now - p->margin) * 1000 / p->freq;
+        if ( ms == 0 ) { break; }
+
+        SDL_Delay( ms );
+        Uint64 woke = SDL_GetPerformanceCounter();
+        Uint64 asked = (Uint64) ms * p->freq / 1000;
+        Uint64 late = (woke - now > asked)? woke - now - asked : 0;
+
+        if ( late > p->margin ) {
+            p->margin = (late < p->period)? late : p->period;
+        } else {
+            p->margin -= (p->margin - late) / 16;
+        }
+        now = woke;
+    }
+
+    /* and spin the rest of the way */
+    while ( now < p->next ) { now = SDL_GetPerformanceCounter(); }
+    p->next += p->period;
+}
+
+int
+pacer_vsync ( struct pacer *p, Uint64 now ) {
+    if ( p->last == 0 ) {
+        p->last = now;
+        return 1;
+    }
+
+    Uint64 elapsed = now - p->last;
+    Uint64 periods = (elapsed + p->period / 2) / p->period;
+    Uint64 exact = periods * p->period;
+    p->last = now;
+
+    /* presents jitter around the refresh, so a display running at the
+       target rate would otherwise now and then give two frames and then
+       none */
+    if ( periods > 0 && ((elapsed > exact)? elapsed - exact : exact - elapsed) < p->period / VSYNC_SNAP ) {
+        elapsed = exact;
+    }
+
+    p->owed += elapsed;
+    Uint64 due = p->owed / p->period;
+    p->owed -= due * p->period;
+    return (due > (Uint64) p->max_behind)? p->max_behind : (int) due;
+}
+
+/* durations below 2 * TIMES_SUB us get a bucket each, above that every
+   power of two is split in TIMES_SUB, so buckets are within 1.6% */
+static int
+bucket ( unsigned us ) {
+    int octave = TIMES_SUB_BITS + 1;
+
+    if ( us < 2 * TIMES_SUB ) { return us; }
+    while ( octave < 31 && (us >> (octave + 1)) ) { octave++; }
+    return (octave - TIMES_SUB_BITS) * TIMES_SUB + (us >> (octave - TIMES_SUB_BITS));
+}
+
+/* smallest duration in bucket b, in us */
+static unsigned long long
+bucket_low ( int b ) {
+    if ( b < 2 * TIMES_SUB ) { return b; }
+    return (unsigned long long) (TIMES_SUB + b % TIMES_SUB) << (b / TIMES_SUB - 1);
+}
+
+void
+times_init ( struct times *t, const char *name ) {
+    memset( t, 0, sizeof(struct times) );
+    t->name = name;
+}
+
+void
+times_add ( struct times *t, Uint64 ticks, Uint64 freq ) {
+    double d = ticks * 1e6 / freq;
+    unsigned us = (d < UINT_MAX)? d : UINT_MAX;
+    unsigned at = atomic_load_explicit( &t->at, memory_order_relaxed );
+
+    atomic_store_explicit( &t->window[at % TIMES_WINDOW], us, memory_order_relaxed );
+    atomic_store_explicit( &t->at, at + 1, memory_order_release );
+
+    t->hist[bucket( us )]++;
+    t->count++;
+    t->sum_us += us;
+    if ( us > t->max_us ) { t->max_us = us; }
+}
+
+void
+times_recent ( struct times *t, unsigned *us, int n ) {
+    unsigned at = atomic_load_explicit( &t->at, memory_order_acquire );
+
+    for ( int i = 0; i < n; i++ ) {
+        us[i] = atomic_load_explicit( &t->window[(at - n + i) % TIMES_WINDOW], memory_order_relaxed );
+    }
+}
+
+/* duration at most q of the samples take, in us, to bucket precision */
+static unsigned long long
+percentile ( const struct times *t, double q ) {
+    unsigned long long seen = 0;
+    int b;
+
+    for ( b = 0; b < TIMES_BUCKETS - 1; b++ ) {
+        seen += t->hist[b];
+        if ( seen >= q * t->count ) { break; }
+    }
+    return (bucket_low( b + 1 ) < t->max_us)? bucket_low( b + 1 ) : t->max_us;
+}
+
+void
+times_dump ( const struct times *t, FILE *f ) {
+    if ( t->count == 0 ) {
+        fprintf( f, "%s: no samples\n", t->name );
+        return;
+    }
+
+    fprintf( f, "%s: %llu samples, mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+        t->name, t->count, t->sum_us / 1e3 / t->count,
+        percentile( t, 0.5 ) / 1e3, percentile( t, 0.99 ) / 1e3, t->max_us / 1e3 );
+
+    for ( int b = 0; b < TIMES_BUCKETS; b++ ) {
+        if ( t->hist[b] == 0 ) { continue; }
+        fprintf( f, "  %9.3f - %9.3f ms %10llu\n",
+            bucket_low( b ) / 1e3, bucket_low( b + 1 ) / 1e3, t->hist[b] );
+    }
+}
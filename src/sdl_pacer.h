@@ -0,0 +1,66 @@
+#ifndef _SDL_PACER_H_
+#define _SDL_PACER_H_
+
+#include <stdio.h>
+#include <stdatomic.h>
+
+#include <SDL2/SDL.h>
+
+/* frame pacing on the performance counter. frames are due at fixed
+   multiples of the period from the start, so errors never accumulate.
+   waiting sleeps until shortly before a deadline and spins the rest of the
+   way, the margin left for spinning follows how late SDL_Delay has been
+   waking up recently */
+struct pacer {
+	Uint64 freq;        /* counter ticks per second */
+	Uint64 period;      /* counter ticks per frame */
+	Uint64 next;        /* when the next frame is due */
+	Uint64 margin;      /* sleeping stops this long before a deadline */
+	int max_behind;     /* frames caught up on at most after a stall */
+
+	/* vsync mode: presented time not yet emulated, and the last present */
+	Uint64 owed;
+	Uint64 last;
+};
+
+void pacer_init ( struct pacer *p, double hz, int max_behind );
+
+/* waits until the next frame is due, straight away if running behind */
+void pacer_wait ( struct pacer *p );
+
+/* vsync mode, the display's refresh is the clock instead. call once per
+   present with the time it returned, gives the frames that are due */
+int pacer_vsync ( struct pacer *p, Uint64 now );
+
+#define TIMES_WINDOW   64   /* samples kept for the overlay */
+#define TIMES_SUB_BITS 6
+#define TIMES_SUB      (1 << TIMES_SUB_BITS)
+#define TIMES_BUCKETS  (TIMES_SUB * (33 - TIMES_SUB_BITS))   /* up to 2^32 us */
+
+/* one kind of duration, e.g. time per frame. the owning thread adds
+   samples, the window is atomic so another thread can read it while
+   that happens. the histogram covers the whole run and is read once
+   the owner is done */
+struct times {
+	const char *name;
+	atomic_uint window[TIMES_WINDOW];   /* us, a ring */
+	atomic_uint at;                     /* next slot of the ring */
+
+	unsigned long long hist[TIMES_BUCKETS];
+	unsigned long long count;
+	unsigned long long sum_us;
+	unsigned max_us;
+};
+
+void times_init ( struct times *t, const char *name );
+
+/* add a duration of ticks performance counter ticks */
+void times_add ( struct times *t, Uint64 ticks, Uint64 freq );
+
+/* the last n samples in us, oldest first, n at most TIMES_WINDOW */
+void times_recent ( struct times *t, unsigned *us, int n );
+
+/* count, mean, percentiles and the non-empty buckets as text */
+void times_dump ( const struct times *t, FILE *f );
+
+#endif
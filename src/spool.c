@@ -0,0 +1,80 @@
+#include "spool.h"
+#include <stdlib.h>
+#include <time.h>
+
+static void
+nap ( void ) {
+    struct timespec ts = { 0, 100000 };
+    nanosleep( &ts, NULL );
+}
+
+static void *
+writer ( void *arg ) {
+    struct spool *s = arg;
+    size_t tail = atomic_load_explicit( &s->tail, memory_order_relaxed );
+
+    for ( ;; ) {
+        /* look at stop first, everything pushed before it was set is then
+           already visible in head */
+        int stop = atomic_load( &s->stop );
+        size_t head = atomic_load_explicit( &s->head, memory_order_acquire );
+
+        if ( head == tail ) {
+            if ( stop ) { break; }
+            nap();
+            continue;
+        }
+
+        tail += s->drain( s, tail, head );
+        atomic_store_explicit( &s->tail, tail, memory_order_release );
+    }
+
+    if ( s->flush ) { s->flush( s ); }
+    return NULL;
+}
+
+int
+spool_open ( struct spool *s, const char *path, size_t size, size_t capacity,
+             const void *header, size_t header_len ) {
+    s->size = size;
+    s->capacity = capacity;
+    atomic_init( &s->head, 0 );
+    atomic_init( &s->tail, 0 );
+    atomic_init( &s->stop, 0 );
+    s->limit = capacity;
+    s->error = 0;
+
+    s->slots = malloc( size * capacity );
+    s->f = fopen( path, "wb" );
+    if ( !s->slots || !s->f ) { goto fail; }
+    if ( fwrite( header, 1, header_len, s->f ) != header_len ) { goto fail; }
+    if ( pthread_create( &s->writer, NULL, writer, s ) != 0 ) { goto fail; }
+    return 1;
+
+fail:
+    if ( s->f ) { fclose( s->f ); }
+    free( s->slots );
+    return 0;
+}
+
+int
+spool_close ( struct spool *s ) {
+    atomic_store( &s->stop, 1 );
+    pthread_join( s->writer, NULL );
+
+    int ok = !s->error;
+    if ( fclose( s->f ) != 0 ) { ok = 0; }
+    free( s->slots );
+    return ok;
+}
+
+void
+spool_wait ( struct spool *s ) {
+    size_t head = atomic_load_explicit( &s->head, memory_order_relaxed );
+
+    for ( ;; ) {
+        s->limit = atomic_load_explicit( &s->tail, memory_order_acquire ) + s->capacity;
+        if ( s->limit != head ) { return; }
+        nap();
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef _SPOOL_H_
+#define _SPOOL_H_
+
+#include "chip8.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+/* a single producer, single consumer ring of fixed size slots that a
+   writer thread streams to a file, behind the instruction trace and the
+   frame log. the producer fills spool_slot and calls spool_push, which
+   costs a few stores unless the ring is full. the writer hands everything
+   queued to drain, which writes it out to f and says how much it took */
+
+struct spool {
+	u8 *slots;
+	size_t size;         /* bytes per slot */
+	size_t capacity;     /* slots in the ring, a power of two */
+	atomic_size_t head;  /* slots pushed by the producer */
+	atomic_size_t tail;  /* slots written out by the writer thread */
+	size_t limit;        /* head may run up to here without looking at tail */
+	atomic_int stop;
+
+	/* writer thread: write out slots tail up to head, at most up to the
+	   end of the ring if it wants them in one piece, and return how many
+	   it took. flush, if set, is called once after the last of them */
+	size_t (*drain) ( struct spool *s, size_t tail, size_t head );
+	void (*flush) ( struct spool *s );
+	void *ctx;
+
+	FILE *f;
+	int error;           /* set by drain and flush when writing fails */
+	pthread_t writer;
+};
+
+/* create path, write header to it and start the writer thread, 0 on
+   failure. drain, flush and ctx have to be set beforehand */
+int  spool_open ( struct spool *s, const char *path, size_t size, size_t capacity,
+                  const void *header, size_t header_len );
+/* write out what is still queued and close the file, 0 if writing failed */
+int  spool_close ( struct spool *s );
+/* block until the writer has made room in the ring */
+void spool_wait ( struct spool *s );
+
+/* slot i of the ring, i counting every slot ever pushed */
+static inline u8 *
+spool_at ( const struct spool *s, size_t i ) {
+	return s->slots + (i & (s->capacity - 1)) * s->size;
+}
+
+/* the slot to fill next, waiting for room if the ring is full */
+static inline u8 *
+spool_slot ( struct spool *s ) {
+	size_t head = atomic_load_explicit( &s->head, memory_order_relaxed );
+	if ( head == s->limit ) { spool_wait( s ); }
+	return spool_at( s, head );
+}
+
+/* hand the slot from spool_slot to the writer */
+static inline void
+spool_push ( struct spool *s ) {
+	size_t head = atomic_load_explicit( &s->head, memory_order_relaxed );
+	atomic_store_explicit( &s->head, head + 1, memory_order_release );
+}
+
+#endif
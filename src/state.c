@@ -0,0 +1,113 @@
+#include "state.h"
+#include "hash.h"
+#include "le.h"
+#include <stdio.h>
+#include <string.h>
+
+static const u8 magic[4] = { 'C', '8', 'S', 'T' };
+
+size_t
+chip8_save_state ( const struct chip8 *c8, u8 *buf, size_t len ) {
+    u8 *p = buf;
+
+    if ( len < CHIP8_STATE_SIZE ) { return 0; }
+
+    memcpy( p, magic, 4 ); p += 4;
+    p = put16( p, CHIP8_STATE_VERSION );
+    p = put16( p, 0 );
+    p = put32( p, CHIP8_STATE_PAYLOAD );
+
+    p = put16( p, c8->i );
+    p = put16( p, c8->pc );
+    memcpy( p, c8->v, 16 ); p += 16;
+    *p++ = c8->sp;
+    *p++ = c8->dt;
+    *p++ = c8->st;
+    *p++ = 0;
+    for ( int k = 0; k < 16; k++ ) { p = put16( p, c8->stack[k] ); }
+    p = put32( p, c8->ipf );
+    p = put32( p, c8->cycles_left );
+    p = put32( p, c8->rng );
+    p = put64( p, c8->frame );
+    memcpy( p, c8->mem, CHIP8_MEMORY_CAPACITY ); p += CHIP8_MEMORY_CAPACITY;
+    for ( int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++ ) { p = put64( p, c8->display[y] ); }
+
+    p = put64( p, fnv1a64( buf, p - buf, FNV1A64_INIT ) );
+
+    return p - buf;
+}
+
+int
+chip8_load_state ( struct chip8 *c8, const u8 *buf, size_t len ) {
+    const u8 *p = buf + CHIP8_STATE_HEADER;
+
+    if ( len < CHIP8_STATE_SIZE ) { return 0; }
+    if ( memcmp( buf, magic, 4 ) != 0 ) { return 0; }
+    if ( get16( buf + 4 ) != CHIP8_STATE_VERSION ) { return 0; }
+    if ( get32( buf + 8 ) != CHIP8_STATE_PAYLOAD ) { return 0; }
+    if ( get64( p + CHIP8_STATE_PAYLOAD ) !=
+         fnv1a64( buf, CHIP8_STATE_HEADER + CHIP8_STATE_PAYLOAD, FNV1A64_INIT ) ) {
+        return 0;
+    }
+
+    c8->i  = get16( p ); p += 2;
+    c8->pc = get16( p ) & CHIP8_ADDR_MASK; p += 2;
+    memcpy( c8->v, p, 16 ); p += 16;
+    c8->sp = *p++ & CHIP8_STACK_MASK;
+    c8->dt = *p++;
+    c8->st = *p++;
+    p++;
+    for ( int k = 0; k < 16; k++, p += 2 ) { c8->stack[k] = get16( p ); }
+    c8->ipf = get32( p ); p += 4;
+    c8->cycles_left = get32( p ); p += 4;
+    chip8_seed( c8, get32( p ) ); p += 4;
+    c8->frame = get64( p ); p += 8;
+    memcpy( c8->mem, p, CHIP8_MEMORY_CAPACITY ); p += CHIP8_MEMORY_CAPACITY;
+    for ( int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++, p += 8 ) { c8->display[y] = get64( p ); }
+
+    c8->yield = 0;
+
+    return 1;
+}
+
+int
+chip8_save_state_file ( const struct chip8 *c8, const char *path ) {
+    u8 buf[CHIP8_STATE_SIZE];
+    size_t len = chip8_save_state( c8, buf, sizeof(buf) );
+    FILE *f = fopen( path, "wb" );
+
+    if ( !f ) { return 0; }
+    int ok = fwrite( buf, 1, len, f ) == len;
+    return (fclose(f) == 0) && ok;
+}
+
+int
+chip8_load_state_file ( struct chip8 *c8, const char *path ) {
+    u8 buf[CHIP8_STATE_SIZE];
+    FILE *f = fopen( path, "rb" );
+
+    if ( !f ) { return 0; }
+    size_t len = fread( buf, 1, sizeof(buf), f );
+    fclose(f);
+
+    return chip8_load_state( c8, buf, len );
+}
+
+uint64_t
+chip8_state_hash ( const struct chip8 *c8 ) {
+    u8 regs[2 + 2 + 16 + 3 + 16 * 2 + 4];
+    u8 *p = regs;
+
+    p = put16( p, c8->i );
+    p = put16( p, c8->pc );
+    memcpy( p, c8->v, 16 ); p += 16;
+    *p++ = c8->sp;
+    *p++ = c8->dt;
+    *p++ = c8->st;
+    for ( int k = 0; k < 16; k++ ) { p = put16( p, c8->stack[k] ); }
+    p = put32( p, c8->rng );
+
+    uint64_t h = hash64_words( c8->mem, CHIP8_MEMORY_CAPACITY, FNV1A64_INIT );
+    h = hash64_words( c8->display, sizeof(c8->display), h );
+    return hash64_words( regs, p - regs, h );
+}
@@ -0,0 +1,39 @@
+#ifndef _STATE_H_
+#define _STATE_H_
+
+#include "chip8.h"
+#include <stddef.h>
+
+/* save states. a state is a little endian image of everything a program
+   can observe: registers, stack, memory, display, the frame position and
+   the random number generator.
+   the keyboard belongs to the host and is left alone by chip8_load_state.
+
+   layout: "C8ST", u16 version, u16 reserved, u32 payload size, payload,
+   u64 FNV-1a of everything before it */
+
+#define CHIP8_STATE_VERSION 2
+
+#define CHIP8_STATE_HEADER  12
+#define CHIP8_STATE_PAYLOAD (2 + 2 + 16 + 4 + 16 * 2 + 4 + 4 + 4 + 8 + \
+                             CHIP8_MEMORY_CAPACITY + CHIP8_DISPLAY_HEIGHT * 8)
+#define CHIP8_STATE_SIZE    (CHIP8_STATE_HEADER + CHIP8_STATE_PAYLOAD + 8)
+
+/* write the state of chip8 to buf, returns CHIP8_STATE_SIZE or 0 if len is
+   too small */
+size_t chip8_save_state ( const struct chip8 *chip8, u8 *buf, size_t len );
+/* restore a state written by chip8_save_state, returns 0 without touching
+   chip8 if buf is not a valid state of this version */
+int    chip8_load_state ( struct chip8 *chip8, const u8 *buf, size_t len );
+
+/* the same to and from a file, returning 1 on success */
+int chip8_save_state_file ( const struct chip8 *chip8, const char *path );
+int chip8_load_state_file ( struct chip8 *chip8, const char *path );
+
+/* hash of registers, stack, timers, memory, display and the random number
+   generator, everything that decides what the machine does next given the
+   same keys. the frame position is left out, so one state reached at two
+   different frames hashes the same. only comparable within one host */
+uint64_t chip8_state_hash ( const struct chip8 *chip8 );
+
+#endif
@@ -0,0 +1,214 @@
+/* the reference interpreter's chip8_step for one machine type, included
+   after ops_tmpl.h has been instantiated for it and after defining
+
+       STEP_NAME                    the name of the step function
+       STEP_TRACE(c8, pc, opcode)   run after every instruction, e.g. to
+                                    record it in a trace
+
+   there is no include guard on purpose */
+
+void
+STEP_NAME ( OPS_T *c8 ) {
+    /* fetch the next instruction and advance program counter */
+    u16 pc = c8->pc;
+    u16 opcode = OPS(fetch)( c8, pc );
+    PROFILE_OP(pc, opcode);
+    DEBUG(pc, opcode);
+    c8->pc = (pc + 2) & CHIP8_ADDR_MASK;
+
+    /* decode opcode and pull out all possible arguments */
+    u8  byte = opcode & 0xFF;
+    u16 word = opcode & 0xFFF;
+    u8  x    = (opcode >> 8) & 0xF;
+    u8  y    = (opcode >> 4) & 0xF;
+    u8  n    = (opcode >> 0) & 0xF;
+
+    switch ( opcode & 0xF000 ) {
+        case 0x0000:
+            switch ( opcode & 0x0FFF ) {
+                case 0x00E0: 
+                    /* clear the screen */
+                    OPS(clear)( c8 );
+                    break;
+                case 0x00EE: 
+                    /* return from subroutine */
+                    c8->sp = (c8->sp - 1) & CHIP8_STACK_MASK;
+                    c8->pc = c8->stack[c8->sp];
+                    break;
+                default:
+                    /* call program (typically not implemented) */
+                    c8->pc = word;
+                    break;
+            }
+            break;        
+        case 0x1000:
+            /* jump to address */
+            c8->pc = word; 
+            break;
+        case 0x2000:
+            /* call subroutine: backup pc on stack and then branch */
+            c8->stack[c8->sp] = c8->pc;
+            c8->sp = (c8->sp + 1) & CHIP8_STACK_MASK;
+            c8->pc = word;
+            break;
+        case 0x3000:
+            /* skip next instruction if Vx == byte */
+            if (c8->v[x] == byte) { CHIP8_SKIP(c8); }
+            break;
+        case 0x4000:
+            /* skip next instruction if Vx != byte */
+            if (c8->v[x] != byte) { CHIP8_SKIP(c8); }
+            break;
+        case 0x5000:
+            /* skip next instruction if Vx == Vy */
+            if (c8->v[x] == c8->v[y]) { CHIP8_SKIP(c8); }
+            break;
+        case 0x6000:
+            /* load byte into Vx */
+            c8->v[x] = byte;
+            break;
+        case 0x7000:
+            /* add byte to Vx and store the result in Vx */
+            c8->v[x] += byte;
+            break;
+        case 0x8000:
+            switch ( opcode & 0x000F ) {
+                case 0x0000:
+                    /* load Vy into Vx */
+                    c8->v[x] = c8->v[y];
+                    break;
+                case 0x0001:
+                    /* or the values in Vx and Vy. Store result in Vx */
+                    c8->v[x] |= c8->v[y];
+                    break;
+                case 0x0002:
+                    /* and the values in Vx and Vy. Store result in Vx */
+                    c8->v[x] &= c8->v[y];
+                    break;
+                case 0x0003:
+                    /* xor the values in Vx and Vy. Store result in Vx */
+                    c8->v[x] ^= c8->v[y];
+                    break;
+                case 0x0004:
+                    /* add the values in Vx and Vy. Store result in Vx */
+                    /* VF is set if overflow occurs */
+                    c8->v[0xF] = ((255 - c8->v[x]) < c8->v[y]);
+                    c8->v[x] += c8->v[y];
+                    break;
+                case 0x0005:
+                    /* subtract Vy from Vx and store result in Vx */
+                    /* VF is 0 if result is negative */
+                    c8->v[0xF] = c8->v[y] < c8->v[x];
+                    c8->v[x] -= c8->v[y];
+                    break;
+                case 0x0006:
+                    /* shift Vx right by one position */
+                    /* VF is set to value of least significant bit */
+                    c8->v[0xF] = c8->v[x] & 0x01;
+                    c8->v[x] >>= 1;
+                    break;
+                case 0x0007:
+                    /* subtract Vx from Vy and store result in Vx */
+                    /* VF is 0 if result is negative */
+                    c8->v[0xF] = c8->v[x] < c8->v[y];
+                    c8->v[x] = c8->v[y] - c8->v[x];
+                    break;
+                case 0x000E:
+                    /* shift Vx left by one position */
+                    /* VF is set to value of most significant bit */
+                    c8->v[0xF] = c8->v[x] & 0x80;
+                    c8->v[x] <<= 1;
+                    break;
+            }
+            break;
+        case 0x9000:
+            /* skip next instruction if Vx != Vy */
+            if (c8->v[x] != c8->v[y]) { CHIP8_SKIP(c8); }
+            break;
+        case 0xA000:
+            /* set value of I register to literal address */
+            c8->i = word;
+            break;
+        case 0xB000:
+            /* jump to literal address incremented by value of Vx */
+            c8->pc = (word + c8->v[0]) & CHIP8_ADDR_MASK;
+            break;
+        case 0xC000:
+            /* get random number anded with value of byte */
+            c8->v[x] = OPS(random)( c8 ) & byte;
+            break;
+        case 0xD000: {
+            /* draws a sprite to the screen and performs collision detection */
+            /* Vx and Vy are screen position of sprite */
+            /* register I is the memory location for the start of the sprite */
+            /* n is the number of bytes which must be read to retrieve sprite */
+            /* VF is 1 on collision i.e. sprite overlaps another sprite */
+
+            c8->v[0xF] = OPS(draw)( c8, c8->v[x], c8->v[y], n );
+            break;
+        }            
+        case 0xE000:
+            switch ( opcode & 0x00FF ) {                
+                case 0x009E: 
+                    /* skip the next instruction if key in Vx is pressed */
+                    if (c8->keyboard[c8->v[x] & 0xF] == CHIP8_KEY_DOWN) {
+                        CHIP8_SKIP(c8);
+                    }
+                    break;
+                case 0x00A1: 
+                    /* skip the next instruction if key in Vx is not pressed */
+                    if (c8->keyboard[c8->v[x] & 0xF] != CHIP8_KEY_DOWN) {
+                        CHIP8_SKIP(c8);
+                    }
+                    break;
+            }
+            break;
+        case 0xF000:
+            switch ( opcode & 0x00FF ) {
+                case 0x0007:
+                    /* load the value of the delay timer into Vx */
+                    c8->v[x] = c8->dt;
+                    break;
+                case 0x000A:
+                    /* pause for key press and store pressed key in Vx */
+                    if ( !OPS(key_wait)( c8, x ) ) {
+                        c8->pc = (c8->pc - 2) & CHIP8_ADDR_MASK;
+                    }
+                    break;
+                case 0x0015:
+                    /* set delay timer to value of Vx */
+                    c8->dt = c8->v[x];
+                    break;
+                case 0x0018:
+                    /* set sound timer to value of Vx */
+                    OPS(sound)( c8, c8->v[x] );
+                    break;
+                case 0x001E:
+                    /* increment I by value in Vx */
+                    c8->i += c8->v[x];
+                    break;
+                case 0x0029:
+                    /* point I to address of font for value in Vx */
+                    c8->i = (c8->v[x] % 0x10) * 5;
+                    break;
+                case 0x0033:
+                    /* store value of Vx in BCD at location pointed to by I */
+                    OPS(bcd)( c8, x );
+                    break;
+                case 0x0055:
+                    /* store registers V0-Vx at location pointed to by I */
+                    OPS(store)( c8, x );
+                    break;
+                case 0x0065:
+                    /* load registers V0-Vx from location pointed to by I */
+                    OPS(load)( c8, x );
+                    break;
+
+            } 
+            break;
+        default:
+            fprintf( stdout, "Opcode 0x%04X not implemented\n", opcode );
+    }
+
+    STEP_TRACE(c8, pc, opcode);
+}
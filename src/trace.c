@@ -0,0 +1,66 @@
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const u8 magic[4] = { 'C', '8', 'T', 'R' };
+
+/* the part of the queue up to the end of the ring in one write */
+static size_t
+drain ( struct spool *s, size_t tail, size_t head ) {
+    size_t at = tail & (s->capacity - 1);
+    size_t n = head - tail;
+    if ( n > s->capacity - at ) { n = s->capacity - at; }
+
+    if ( fwrite( spool_at( s, tail ), CHIP8_TRACE_RECORD, n, s->f ) != n ) { s->error = 1; }
+    return n;
+}
+
+struct chip8_trace *
+chip8_trace_open ( const char *path ) {
+    struct chip8_trace *t = calloc( 1, sizeof(struct chip8_trace) );
+    u8 header[CHIP8_TRACE_HEADER];
+
+    if ( !t ) { return NULL; }
+
+    memcpy( header, magic, 4 );
+    header[4] = CHIP8_TRACE_VERSION & 0xFF; header[5] = CHIP8_TRACE_VERSION >> 8;
+    header[6] = CHIP8_TRACE_RECORD & 0xFF;  header[7] = CHIP8_TRACE_RECORD >> 8;
+
+    t->spool.drain = drain;
+    if ( !spool_open( &t->spool, path, CHIP8_TRACE_RECORD, CHIP8_TRACE_RING,
+                      header, sizeof(header) ) ) {
+        free( t );
+        return NULL;
+    }
+    return t;
+}
+
+int
+chip8_trace_close ( struct chip8_trace *t ) {
+    int ok = spool_close( &t->spool );
+    free( t );
+    return ok;
+}
+
+int
+chip8_trace_read_header ( FILE *f ) {
+    u8 header[CHIP8_TRACE_HEADER];
+
+    if ( fread( header, 1, sizeof(header), f ) != sizeof(header) ) { return 0; }
+    if ( memcmp( header, magic, 4 ) != 0 ) { return 0; }
+    if ( (header[4] | (header[5] << 8)) != CHIP8_TRACE_VERSION ) { return 0; }
+    return (header[6] | (header[7] << 8)) == CHIP8_TRACE_RECORD;
+}
+
+int
+chip8_trace_read ( FILE *f, struct chip8_trace_record *r ) {
+    u8 b[CHIP8_TRACE_RECORD];
+
+    if ( fread( b, 1, sizeof(b), f ) != sizeof(b) ) { return 0; }
+    r->pc     = b[0] | (b[1] << 8);
+    r->opcode = b[2] | (b[3] << 8);
+    r->vx     = b[4];
+    r->vf     = b[5];
+    r->i      = b[6] | (b[7] << 8);
+    return 1;
+}
@@ -0,0 +1,66 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include "chip8.h"
+#include "spool.h"
+#include <stdio.h>
+#include <stddef.h>
+
+/* binary instruction trace. with chip8->trace set, chip8_step appends one
+   record per instruction to a spool.h ring and its writer thread streams
+   the ring to disk, so tracing costs a few stores
+   per instruction rather than formatted output. the engines run traced
+   machines through chip8_step so every instruction is recorded.
+
+   the file is an 8 byte header, "C8TR", version and record size as little
+   endian u16s, followed by records of CHIP8_TRACE_RECORD bytes, all little
+   endian:
+
+       u16 pc      address the instruction was fetched from
+       u16 opcode
+       u8  vx      Vx after the instruction, x being bits 8-11 of opcode
+       u8  vf      VF after the instruction
+       u16 i       I after the instruction */
+
+#define CHIP8_TRACE_VERSION 1
+#define CHIP8_TRACE_HEADER  8
+#define CHIP8_TRACE_RECORD  8
+
+/* ring capacity in records, a power of two */
+#define CHIP8_TRACE_RING (1 << 16)
+
+struct chip8_trace_record {
+	u16 pc;
+	u16 opcode;
+	u8  vx;
+	u8  vf;
+	u16 i;
+};
+
+struct chip8_trace {
+	struct spool spool;  /* of CHIP8_TRACE_RECORD byte slots */
+};
+
+/* create path and start the writer thread, NULL on failure */
+struct chip8_trace *chip8_trace_open ( const char *path );
+/* write out what is still queued and close the file, 0 if writing failed */
+int  chip8_trace_close ( struct chip8_trace *t );
+
+/* read the header of a trace file, 0 if it is not one */
+int  chip8_trace_read_header ( FILE *f );
+/* read the next record, 0 at the end of the file */
+int  chip8_trace_read ( FILE *f, struct chip8_trace_record *r );
+
+static inline void
+chip8_trace_put ( struct chip8_trace *t, u16 pc, u16 opcode, const struct chip8 *c8 ) {
+	u8 *r = spool_slot( &t->spool );
+	r[0] = pc;     r[1] = pc >> 8;
+	r[2] = opcode; r[3] = opcode >> 8;
+	r[4] = c8->v[(opcode >> 8) & 0xF];
+	r[5] = c8->v[0xF];
+	r[6] = c8->i;  r[7] = c8->i >> 8;
+
+	spool_push( &t->spool );
+}
+
+#endif
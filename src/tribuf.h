@@ -0,0 +1,60 @@
+#ifndef _TRIBUF_H_
+#define _TRIBUF_H_
+
+#include <stdatomic.h>
+
+/* lock-free triple buffer for handing whole frames from one producer thread
+   to one consumer thread. each side owns one slot and the third sits in the
+   middle. the producer fills its slot and swaps it with the middle one, the
+   consumer swaps its slot with the middle one when that holds a newer
+   frame. neither side ever waits and the consumer always gets the latest
+   frame, older ones are simply overwritten.
+
+   the slots themselves live with the caller, e.g. struct frame slots[3],
+   and are picked by the indices returned here */
+
+#define TRIBUF_FRESH 4 /* middle slot holds a frame the consumer has not seen */
+
+struct tribuf {
+	int back;             /* slot the producer writes, producer only */
+	atomic_int middle;    /* slot index | TRIBUF_FRESH */
+	int front;            /* slot the consumer reads, consumer only */
+};
+
+static inline void
+tribuf_init ( struct tribuf *t ) {
+	t->back = 0;
+	atomic_init( &t->middle, 1 );
+	t->front = 2;
+}
+
+/* slot the producer should write the next frame to */
+static inline int
+tribuf_back ( const struct tribuf *t ) {
+	return t->back;
+}
+
+/* publish the back slot, the producer gets a new one to write to */
+static inline void
+tribuf_publish ( struct tribuf *t ) {
+	t->back = atomic_exchange_explicit( &t->middle, t->back | TRIBUF_FRESH,
+		memory_order_acq_rel ) & ~TRIBUF_FRESH;
+}
+
+/* take the latest published frame if there is a new one. returns 1 and
+   updates the front slot if so, 0 if the front slot is still the latest */
+static inline int
+tribuf_acquire ( struct tribuf *t ) {
+	if ( !(atomic_load_explicit( &t->middle, memory_order_relaxed ) & TRIBUF_FRESH) ) { return 0; }
+	t->front = atomic_exchange_explicit( &t->middle, t->front,
+		memory_order_acq_rel ) & ~TRIBUF_FRESH;
+	return 1;
+}
+
+/* slot the consumer should read */
+static inline int
+tribuf_front ( const struct tribuf *t ) {
+	return t->front;
+}
+
+#endif
@@ -0,0 +1,447 @@
+#include "../src/chip8.h"
+#include "../src/engine.h"
+#include "../src/hash.h"
+#include "../src/lockstep.h"
+#include "../src/blit.h"
+#include "../src/trace.h"
+#include "../src/input.h"
+#include "../src/rompack.h"
+#include "../src/framelog.h"
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define DEFAULT_CYCLES  1000000
+#define MAX_COUNTERS    16
+
+struct job {
+	const char *romfile;     /* path, or the hash of a rom from a pack */
+	long packed;             /* index of the rom in the pack, -1 if a file */
+	const char *error;       /* why the rom was not run, NULL if it was */
+
+	unsigned long frames;
+	unsigned long long instructions; /* summed over all lanes */
+	double lockstep;                 /* share of them run in lockstep */
+	unsigned long long idle;         /* instructions skipped as idle */
+	double seconds;
+	uint64_t display_hash;
+	struct chip8 chip8;
+};
+
+struct state {
+	struct job *jobs;
+	int njobs;
+
+	unsigned long cycles;
+	unsigned long frames;
+	int ipf;
+	int nthreads;
+	const struct chip8_engine *engine;
+	int lanes;
+	const char *framedir;
+	const char *streamdir;
+	const char *tracefile;
+	uint32_t seed;
+	struct chip8_input *replay;
+	struct chip8_rompack *pack;
+	struct blitter blitter; /* argb8888 for frame dumps */
+
+	atomic_int next;
+	atomic_ullong counters[MAX_COUNTERS]; /* engine counters summed over roms */
+};
+
+static void
+usage ( const char *progname ) {
+	fprintf( stdout, "usage: %s [-c CYCLES | -f FRAMES] [-i IPF] [-j THREADS] [-e ENGINE | -n LANES] [-l LIST] [-r PACK] [-o DIR] [-d DIR] [-T FILE] [-s SEED] [-p LOG] ROM...\n", progname );
+	fprintf( stdout, "  -c CYCLES   instructions budget per ROM, run as whole frames (default %d)\n", DEFAULT_CYCLES );
+	fprintf( stdout, "  -f FRAMES   60 Hz frames to execute per ROM\n" );
+	fprintf( stdout, "  -i IPF      instructions per frame (default %d)\n", CHIP8_DEFAULT_IPF );
+	fprintf( stdout, "  -j THREADS  worker threads (default: one per core)\n" );
+	fprintf( stdout, "  -e ENGINE   execution engine:" );
+	for ( int i = 0; chip8_engines[i]; i++ ) {
+		fprintf( stdout, " %s", chip8_engines[i]->name );
+	}
+	fprintf( stdout, " (default %s)\n", chip8_engines[0]->name );
+	fprintf( stdout, "  -n LANES    run LANES copies of each ROM in SIMD lockstep, lane k holds key k %% 17\n" );
+	fprintf( stdout, "  -l LIST     read ROM paths from LIST, one per line\n" );
+	fprintf( stdout, "  -r PACK     run every ROM in the rom pack PACK, see chip8-rompack\n" );
+	fprintf( stdout, "  -o DIR      write the final frame of each ROM to DIR as a PPM image\n" );
+	fprintf( stdout, "  -d DIR      record the display after every frame of each ROM to DIR, see chip8-frames\n" );
+	fprintf( stdout, "  -T FILE     write a binary trace of every instruction to FILE, one ROM only\n" );
+	fprintf( stdout, "  -s SEED     seed for the random number generator\n" );
+	fprintf( stdout, "  -p LOG      replay an input log recorded by chip8 -r, one ROM only\n" );
+	exit(0);
+}
+
+static void
+add_job ( struct state *state, const char *romfile ) {
+	state->jobs = realloc( state->jobs, sizeof(struct job) * (state->njobs + 1) );
+	if ( !state->jobs ) { fprintf( stderr, "out of memory\n" ); exit(EXIT_FAILURE); }
+	memset( &state->jobs[state->njobs], 0, sizeof(struct job) );
+	state->jobs[state->njobs].packed = -1;
+	state->jobs[state->njobs++].romfile = romfile;
+}
+
+/* a job for every rom in a pack, named by its hash */
+static void
+add_pack ( struct state *state, const char *packfile ) {
+	if ( state->pack ) { fprintf( stderr, "only one rom pack can be given\n" ); exit(EXIT_FAILURE); }
+
+	state->pack = chip8_rompack_open( packfile );
+	if ( !state->pack ) { fprintf( stderr, "unable to open rom pack \"%s\"\n", packfile ); exit(EXIT_FAILURE); }
+
+	for ( uint32_t i = 0; i < state->pack->count; i++ ) {
+		const u8 *rom;
+		size_t len;
+		char name[17];
+
+		snprintf( name, sizeof(name), "%016llX",
+			(unsigned long long) chip8_rompack_rom( state->pack, i, &rom, &len ) );
+		add_job( state, strdup(name) );
+		state->jobs[state->njobs - 1].packed = i;
+	}
+}
+
+static void
+add_list ( struct state *state, const char *listfile ) {
+	char line[4096];
+	FILE *f = fopen( listfile, "r" );
+
+	if ( !f ) { fprintf( stderr, "unable to open list \"%s\"\n", listfile ); exit(EXIT_FAILURE); }
+
+	while ( fgets( line, sizeof(line), f ) ) {
+		line[strcspn( line, "\r\n" )] = '\0';
+		if ( line[0] != '\0' ) { add_job( state, strdup(line) ); }
+	}
+
+	fclose(f);
+}
+
+static void
+parse_args ( struct state *state, int argc, char *argv[] ) {
+	memset( state, 0, sizeof(struct state) );
+
+	state->cycles = DEFAULT_CYCLES;
+	state->ipf = CHIP8_DEFAULT_IPF;
+	state->nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	state->engine = chip8_engines[0];
+
+	for ( int i = 1; i < argc; i++ ) {
+		if ( strcmp( "-c", argv[i] ) == 0 && i + 1 < argc ) {
+			state->cycles = strtoul( argv[++i], NULL, 0 );
+		} else if ( strcmp( "-f", argv[i] ) == 0 && i + 1 < argc ) {
+			state->frames = strtoul( argv[++i], NULL, 0 );
+		} else if ( strcmp( "-i", argv[i] ) == 0 && i + 1 < argc ) {
+			state->ipf = atoi(argv[++i]);
+		} else if ( strcmp( "-j", argv[i] ) == 0 && i + 1 < argc ) {
+			state->nthreads = atoi(argv[++i]);
+		} else if ( strcmp( "-e", argv[i] ) == 0 && i + 1 < argc ) {
+			state->engine = chip8_engine_find( argv[++i] );
+			if ( !state->engine ) {
+				fprintf( stderr, "unknown engine \"%s\"\n", argv[i] );
+				exit(EXIT_FAILURE);
+			}
+		} else if ( strcmp( "-n", argv[i] ) == 0 && i + 1 < argc ) {
+			state->lanes = atoi(argv[++i]);
+		} else if ( strcmp( "-l", argv[i] ) == 0 && i + 1 < argc ) {
+			add_list( state, argv[++i] );
+		} else if ( strcmp( "-r", argv[i] ) == 0 && i + 1 < argc ) {
+			add_pack( state, argv[++i] );
+		} else if ( strcmp( "-o", argv[i] ) == 0 && i + 1 < argc ) {
+			state->framedir = argv[++i];
+		} else if ( strcmp( "-d", argv[i] ) == 0 && i + 1 < argc ) {
+			state->streamdir = argv[++i];
+		} else if ( strcmp( "-T", argv[i] ) == 0 && i + 1 < argc ) {
+			state->tracefile = argv[++i];
+		} else if ( strcmp( "-s", argv[i] ) == 0 && i + 1 < argc ) {
+			state->seed = strtoul( argv[++i], NULL, 0 );
+		} else if ( strcmp( "-p", argv[i] ) == 0 && i + 1 < argc ) {
+			state->replay = chip8_input_load( argv[++i] );
+			if ( !state->replay ) {
+				fprintf( stderr, "unable to load input log \"%s\"\n", argv[i] );
+				exit(EXIT_FAILURE);
+			}
+		} else if ( strcmp( "-h", argv[i] ) == 0 ) {
+			usage(argv[0]);
+		} else {
+			add_job( state, argv[i] );
+		}
+	}
+
+	if ( state->njobs == 0 ) { usage(argv[0]); }
+	if ( state->tracefile && (state->njobs > 1 || state->lanes > 0) ) {
+		fprintf( stderr, "-T traces a single ROM without -n\n" );
+		exit(EXIT_FAILURE);
+	}
+	if ( state->streamdir && state->lanes > 0 ) {
+		fprintf( stderr, "-d records without -n\n" );
+		exit(EXIT_FAILURE);
+	}
+	if ( state->replay && (state->njobs > 1 || state->lanes > 0) ) {
+		fprintf( stderr, "-p replays a single ROM without -n\n" );
+		exit(EXIT_FAILURE);
+	}
+	if ( state->replay ) { state->frames = state->replay->frames; }
+	if ( state->ipf < 1 ) { state->ipf = 1; }
+	if ( state->frames == 0 ) { state->frames = state->cycles / state->ipf; }
+	if ( state->framedir ) {
+		blit_init( &state->blitter, BLIT_ARGB8888, 0xFFFFFF, 0x000000, BLIT_IMPL_AUTO );
+	}
+	if ( state->nthreads < 1 ) { state->nthreads = 1; }
+	if ( state->nthreads > state->njobs ) { state->nthreads = state->njobs; }
+}
+
+static double
+now ( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t
+display_hash ( const struct chip8 *c8 ) {
+	u8 buf[CHIP8_DISPLAY_BUF_SIZE];
+	chip8_display_pack( c8, buf );
+	return fnv1a64( buf, sizeof(buf), FNV1A64_INIT );
+}
+
+/* dump the display as a binary PPM named after the rom */
+/* dir/ROM.ext, ROM being the file name of the job's rom */
+static void
+out_path ( char *path, size_t size, const char *dir, const struct job *job, const char *ext ) {
+	const char *base = strrchr( job->romfile, '/' );
+	snprintf( path, size, "%s/%s.%s", dir, base? base + 1 : job->romfile, ext );
+}
+
+static void
+write_frame ( struct state *state, struct job *job ) {
+	u8 display[CHIP8_DISPLAY_BUF_SIZE];
+	uint32_t argb[CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT];
+	u8 rgb[CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT * 3];
+	char path[4096];
+
+	chip8_display_pack( &job->chip8, display );
+	blit_rows( &state->blitter, display, 0, CHIP8_DISPLAY_HEIGHT,
+		argb, CHIP8_DISPLAY_WIDTH * sizeof(uint32_t) );
+
+	for ( int p = 0; p < CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT; p++ ) {
+		rgb[p * 3 + 0] = argb[p] >> 16;
+		rgb[p * 3 + 1] = argb[p] >> 8;
+		rgb[p * 3 + 2] = argb[p];
+	}
+
+	out_path( path, sizeof(path), state->framedir, job, "ppm" );
+
+	FILE *f = fopen( path, "wb" );
+	if ( !f ) { fprintf( stderr, "unable to write frame \"%s\"\n", path ); return; }
+	fprintf( f, "P6\n%d %d\n255\n", CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT );
+	fwrite( rgb, 1, sizeof(rgb), f );
+	fclose(f);
+}
+
+/* a fresh machine with the job's rom in it */
+static int
+load_job ( struct state *state, struct job *job ) {
+	chip8_init( &job->chip8 );
+	if ( job->packed >= 0 ) { return chip8_rompack_load( state->pack, job->packed, &job->chip8 ); }
+	return chip8_load( &job->chip8, job->romfile );
+}
+
+static void
+add_counters ( struct state *state, void *ctx ) {
+	unsigned long long value;
+	if ( !state->engine->counter ) { return; }
+	for ( int i = 0; i < MAX_COUNTERS && state->engine->counter( ctx, i, &value ); i++ ) {
+		atomic_fetch_add( &state->counters[i], value );
+	}
+}
+
+/* print the engine's counters summed over every rom, if it keeps any */
+static void
+report_counters ( struct state *state ) {
+	unsigned long long value;
+	const char *name;
+	void *ctx;
+
+	if ( !state->engine->counter || (ctx = state->engine->create()) == NULL ) { return; }
+	int i = 0;
+	for ( ; i < MAX_COUNTERS && (name = state->engine->counter( ctx, i, &value )); i++ ) {
+		fprintf( stderr, "%s%s=%llu", i? " " : "", name, (unsigned long long) state->counters[i] );
+	}
+	if ( i > 0 ) { fprintf( stderr, "\n" ); }
+	state->engine->destroy( ctx );
+}
+
+static void
+run_job ( struct state *state, struct job *job ) {
+	struct chip8_framelog *stream = NULL;
+	char path[4096];
+	void *ctx;
+
+	if ( load_job( state, job ) == 0 ) { job->error = "unable to load rom"; return; }
+	if ( (ctx = state->engine->create()) == NULL ) { job->error = "unable to create engine"; return; }
+	job->chip8.ipf = state->ipf;
+	if ( state->seed ) { chip8_seed( &job->chip8, state->seed ); }
+	if ( state->replay && !chip8_input_start( state->replay, &job->chip8 ) ) {
+		job->error = "input log was not recorded with this rom";
+		state->engine->destroy( ctx );
+		return;
+	}
+	if ( state->tracefile && (job->chip8.trace = chip8_trace_open( state->tracefile )) == NULL ) {
+		fprintf( stderr, "unable to write trace \"%s\"\n", state->tracefile );
+		job->error = "unable to write trace";
+		state->engine->destroy( ctx );
+		return;
+	}
+	if ( state->streamdir ) {
+		out_path( path, sizeof(path), state->streamdir, job, "c8fs" );
+		if ( (stream = chip8_framelog_open( path, CHIP8_FRAMELOG_INTERVAL )) == NULL ) {
+			fprintf( stderr, "unable to write frame log \"%s\"\n", path );
+		}
+	}
+
+	double start = now();
+	for ( unsigned long f = 0; f < state->frames; f++ ) {
+		if ( state->replay ) { chip8_input_apply( state->replay, &job->chip8 ); }
+		while ( !chip8_engine_run_frame( state->engine, ctx, &job->chip8 ) ) { }
+		if ( stream ) { chip8_framelog_put( stream, &job->chip8 ); }
+	}
+	if ( stream && !chip8_framelog_close( stream ) ) {
+		fprintf( stderr, "error writing frame log \"%s\"\n", path );
+	}
+	if ( job->chip8.trace && !chip8_trace_close( job->chip8.trace ) ) {
+		fprintf( stderr, "error writing trace \"%s\"\n", state->tracefile );
+	}
+	job->chip8.trace = NULL;
+	job->seconds = now() - start;
+	add_counters( state, ctx );
+	state->engine->destroy( ctx );
+	job->frames = state->frames;
+	job->instructions = job->chip8.instructions;
+	job->idle = job->chip8.idle;
+
+	job->display_hash = display_hash( &job->chip8 );
+	if ( state->framedir ) { write_frame( state, job ); }
+}
+
+/* same as run_job, but on a lockstep batch where lane k holds down key
+   k % 17, i.e. no key for every 17th lane. lane 0 is reported */
+static void
+run_job_lockstep ( struct state *state, struct job *job ) {
+	struct chip8_batch *batch;
+
+	if ( load_job( state, job ) == 0 ) { job->error = "unable to load rom"; return; }
+	if ( (batch = chip8_batch_create( state->lanes )) == NULL ) { job->error = "unable to create lockstep batch"; return; }
+	job->chip8.ipf = state->ipf;
+	if ( state->seed ) { chip8_seed( &job->chip8, state->seed ); }
+
+	chip8_batch_load( batch, &job->chip8 );
+	for ( int k = 0; k < state->lanes; k++ ) {
+		if ( k % 17 < 16 ) { chip8_batch_key_set_state( batch, k, k % 17, CHIP8_KEY_DOWN ); }
+	}
+
+	double start = now();
+	chip8_batch_run_frames( batch, state->frames );
+	job->seconds = now() - start;
+	job->frames = state->frames;
+	job->instructions = batch->lockstep_steps + batch->scalar_steps;
+	job->lockstep = (double) batch->lockstep_steps / job->instructions;
+
+	chip8_batch_get( batch, 0, &job->chip8 );
+	chip8_batch_destroy( batch );
+
+	job->display_hash = display_hash( &job->chip8 );
+	if ( state->framedir ) { write_frame( state, job ); }
+}
+
+static void *
+worker ( void *arg ) {
+	struct state *state = arg;
+	int idx;
+
+	/* pull ROMs off the shared queue until it is empty */
+	while ( (idx = atomic_fetch_add( &state->next, 1 )) < state->njobs ) {
+		if ( state->lanes > 0 ) {
+			run_job_lockstep( state, &state->jobs[idx] );
+		} else {
+			run_job( state, &state->jobs[idx] );
+		}
+	}
+
+	return NULL;
+}
+
+static void
+report ( struct job *job ) {
+	struct chip8 *c8 = &job->chip8;
+
+	if ( job->error ) {
+		fprintf( stdout, "%s\terror\t%s\n", job->romfile, job->error );
+		return;
+	}
+
+	double ips = (job->seconds > 0)? job->instructions / job->seconds : 0;
+
+	fprintf( stdout, "%s\t%lu\t%.0f\t%016llX\tpc=%03X i=%03X sp=%X dt=%02X st=%02X v=",
+		job->romfile, job->frames, ips, (unsigned long long) job->display_hash,
+		c8->pc, c8->i, c8->sp, c8->dt, c8->st
+	);
+	for ( int r = 0; r < 16; r++ ) { fprintf( stdout, "%02X", c8->v[r] ); }
+	if ( job->lockstep > 0 ) { fprintf( stdout, "\tlockstep=%.3f", job->lockstep ); }
+	if ( job->idle > 0 ) {
+		fprintf( stdout, "\tidle=%.3f", (double) job->idle / (job->idle + job->instructions) );
+	}
+	fprintf( stdout, "\n" );
+}
+
+int
+main ( int argc, char *argv[] ) {
+	struct state state;
+	pthread_t *threads;
+
+	parse_args( &state, argc, argv );
+
+	threads = malloc( sizeof(pthread_t) * state.nthreads );
+	if ( !threads ) { fprintf( stderr, "out of memory\n" ); return EXIT_FAILURE; }
+
+	double start = now();
+	for ( int t = 0; t < state.nthreads; t++ ) {
+		pthread_create( &threads[t], NULL, worker, &state );
+	}
+	for ( int t = 0; t < state.nthreads; t++ ) {
+		pthread_join( threads[t], NULL );
+	}
+	double elapsed = now() - start;
+
+	/* rom, frames, instructions/sec, display hash, registers */
+	unsigned long long total = 0;
+	for ( int j = 0; j < state.njobs; j++ ) {
+		report( &state.jobs[j] );
+		total += state.jobs[j].instructions;
+	}
+
+	if ( state.lanes > 0 ) {
+		fprintf( stderr, "%d roms x %d lanes, %llu instructions in %.3fs on %d threads with %s lockstep kernels (%.0f instructions/sec)\n",
+			state.njobs, state.lanes, total, elapsed, state.nthreads, chip8_batch_isa(),
+			(elapsed > 0)? total / elapsed : 0
+		);
+	} else {
+		fprintf( stderr, "%d roms, %llu instructions in %.3fs on %d threads with %s engine (%.0f instructions/sec)\n",
+			state.njobs, total, elapsed, state.nthreads, state.engine->name,
+			(elapsed > 0)? total / elapsed : 0
+		);
+		report_counters( &state );
+	}
+
+	free( threads );
+	free( state.jobs );
+	if ( state.replay ) { chip8_input_destroy( state.replay ); }
+	if ( state.pack ) { chip8_rompack_close( state.pack ); }
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,534 @@
+#include "../src/chip8.h"
+#include "../src/engine.h"
+#include "../src/paged.h"
+#include "../src/hash.h"
+
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_CYCLES  10000000ULL
+#define DEFAULT_REPEATS 5
+#define DEFAULT_IPF     500
+#define MAX_WORKLOADS   64
+#define MAX_REPEATS     64
+
+/* times every engine on synthetic roms that each stress one group of
+   opcodes, two small game-like roms and any roms given on the command
+   line. every run executes a fixed number of instructions, ticking the
+   timers every ipf of them, and prints one line per workload and engine
+   in a fixed order and format so two runs can be diffed. the state column
+   hashes the machine at the end, it has to be the same for every engine */
+
+struct workload {
+	const char *name;
+	u8 rom[CHIP8_ROM_MAX];
+	size_t len;
+};
+
+/* ---- a tiny assembler for the synthetic roms ---- */
+
+struct rom_asm {
+	u8 *rom;
+	size_t len;
+};
+
+static u16
+here ( const struct rom_asm *a ) {
+	return CHIP8_ROM_START + a->len;
+}
+
+static void
+op ( struct rom_asm *a, u16 opcode ) {
+	a->rom[a->len++] = opcode >> 8;
+	a->rom[a->len++] = opcode & 0xFF;
+}
+
+static void
+bytes ( struct rom_asm *a, const u8 *data, size_t n ) {
+	memcpy( a->rom + a->len, data, n );
+	a->len += n;
+}
+
+/* emit opcode with a 12 bit address filled in later by patch */
+static size_t
+forward ( struct rom_asm *a, u16 opcode ) {
+	size_t at = a->len;
+	op( a, opcode );
+	return at;
+}
+
+static void
+patch ( struct rom_asm *a, size_t at, u16 addr ) {
+	a->rom[at] = (a->rom[at] & 0xF0) | (addr >> 8);
+	a->rom[at + 1] = addr & 0xFF;
+}
+
+static const u8 sprite[8] = { 0x3C, 0x7E, 0xDB, 0xFF, 0xFF, 0xBD, 0xC3, 0x7E };
+
+/* 8xyN arithmetic and logic, plus 6xkk and 7xkk */
+static void
+gen_alu ( struct rom_asm *a ) {
+	for ( int x = 0; x < 8; x++ ) { op( a, 0x6000 | (x << 8) | (x * 37 + 1) ); }
+	u16 loop = here( a );
+	op( a, 0x8014 ); op( a, 0x8125 ); op( a, 0x8236 ); op( a, 0x8301 );
+	op( a, 0x8412 ); op( a, 0x8523 ); op( a, 0x863E ); op( a, 0x8707 );
+	op( a, 0x8074 ); op( a, 0x8165 ); op( a, 0x8240 ); op( a, 0x8356 );
+	op( a, 0x7011 ); op( a, 0x7123 ); op( a, 0x843E ); op( a, 0x8547 );
+	op( a, 0x1000 | loop );
+}
+
+/* conditional skips, calls, returns and jumps */
+static void
+gen_branch ( struct rom_asm *a ) {
+	size_t start = forward( a, 0x1000 );
+	u16 sub = here( a );
+	op( a, 0x7201 );
+	op( a, 0x00EE );
+	patch( a, start, here( a ) );
+
+	u16 loop = here( a );
+	op( a, 0x7001 );
+	op( a, 0x3000 ); op( a, 0x7101 );   /* skip while V0 == 0 */
+	op( a, 0x4080 ); op( a, 0x7102 );   /* skip while V0 != 0x80 */
+	op( a, 0x5010 ); op( a, 0x7103 );   /* skip while V0 == V1 */
+	op( a, 0x9010 ); op( a, 0x7104 );   /* skip while V0 != V1 */
+	op( a, 0x2000 | sub );
+	op( a, 0x3201 ); op( a, 0x8120 );
+	op( a, 0x2000 | sub );
+	op( a, 0x1000 | loop );
+}
+
+/* Dxyn sprites all over the screen, font digits and a clear per pass */
+static void
+gen_draw ( struct rom_asm *a ) {
+	size_t start = forward( a, 0x1000 );
+	u16 spr = here( a );
+	bytes( a, sprite, sizeof(sprite) );
+	patch( a, start, here( a ) );
+
+	u16 loop = here( a );
+	op( a, 0x00E0 );
+	op( a, 0x6000 ); op( a, 0x6100 );
+	u16 row = here( a );
+	op( a, 0xA000 | spr );
+	op( a, 0xD018 );
+	op( a, 0xF229 );
+	op( a, 0xD015 );
+	op( a, 0x7201 );
+	op( a, 0x7007 );
+	op( a, 0x3046 ); op( a, 0x1000 | row );
+	op( a, 0x6000 );
+	op( a, 0x7105 );
+	op( a, 0x3123 ); op( a, 0x1000 | row );
+	op( a, 0x7003 );
+	op( a, 0x1000 | loop );
+}
+
+/* Fx55 and Fx65 register file traffic, walking I with Fx1E through
+   0x800-0xBFF. VE counts the 63 steps, the stores must stay clear of the
+   code at 0x200 */
+static void
+gen_mem ( struct rom_asm *a ) {
+	for ( int x = 0; x < 16; x++ ) { op( a, 0x6000 | (x << 8) | (x * 11) ); }
+	u16 loop = here( a );
+	op( a, 0xA800 );
+	op( a, 0x6F10 );
+	op( a, 0x6E00 );
+	u16 walk = here( a );
+	op( a, 0xF755 );
+	op( a, 0xFF1E );
+	op( a, 0xF365 );
+	op( a, 0x7001 );
+	op( a, 0xFE55 );
+	op( a, 0xF765 );
+	op( a, 0x7E01 );
+	op( a, 0x3E3F ); op( a, 0x1000 | walk );
+	op( a, 0x1000 | loop );
+}
+
+/* Fx33 conversions read back with Fx65 */
+static void
+gen_bcd ( struct rom_asm *a ) {
+	u16 loop = here( a );
+	op( a, 0xA900 );
+	op( a, 0xF333 );
+	op( a, 0xF265 );
+	op( a, 0x7307 );
+	op( a, 0xF433 );
+	op( a, 0x7409 );
+	op( a, 0xF533 );
+	op( a, 0xF165 );
+	op( a, 0x8514 );
+	op( a, 0x1000 | loop );
+}
+
+/* a bouncing ball with a key driven paddle, a BCD score and a delay timer
+   wait for the next frame, the shape of most simple games */
+static void
+gen_pong ( struct rom_asm *a ) {
+	static const u8 ball[1] = { 0x80 };
+	static const u8 paddle[6] = { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 };
+	size_t start = forward( a, 0x1000 );
+	u16 spr_ball = here( a );
+	bytes( a, ball, sizeof(ball) );
+	u16 spr_paddle = here( a );
+	bytes( a, paddle, sizeof(paddle) );
+	bytes( a, ball, sizeof(ball) ); /* keep code word aligned */
+	patch( a, start, here( a ) );
+
+	op( a, 0x6008 ); op( a, 0x610A ); op( a, 0x6201 ); op( a, 0x6301 );
+	op( a, 0x6410 ); op( a, 0x6500 ); op( a, 0x6602 );
+	op( a, 0xA000 | spr_ball ); op( a, 0xD011 );
+	op( a, 0xA000 | spr_paddle ); op( a, 0xD646 );
+
+	u16 loop = here( a );
+	/* move the ball, bouncing off the edges and scoring on the left one */
+	op( a, 0xA000 | spr_ball ); op( a, 0xD011 );
+	op( a, 0x8024 ); op( a, 0x8134 );
+	op( a, 0x403F ); op( a, 0x62FF );
+	op( a, 0x4000 ); op( a, 0x6201 );
+	op( a, 0x4000 ); op( a, 0x7501 );
+	op( a, 0x411F ); op( a, 0x63FF );
+	op( a, 0x4100 ); op( a, 0x6301 );
+	op( a, 0xD011 );
+
+	/* move the paddle on keys 1 and 4 */
+	op( a, 0xA000 | spr_paddle ); op( a, 0xD646 );
+	op( a, 0x6701 ); op( a, 0xE7A1 ); op( a, 0x74FF );
+	op( a, 0x6704 ); op( a, 0xE7A1 ); op( a, 0x7401 );
+	op( a, 0xD646 );
+
+	/* draw and erase the score, keeping the ball in V0-V3 safe */
+	op( a, 0xAE00 ); op( a, 0xF355 );
+	op( a, 0xAE10 ); op( a, 0xF533 ); op( a, 0xF265 );
+	op( a, 0x6B30 ); op( a, 0x6C00 );
+	op( a, 0xF129 ); op( a, 0xDBC5 ); op( a, 0xDBC5 );
+	op( a, 0x7B05 );
+	op( a, 0xF229 ); op( a, 0xDBC5 ); op( a, 0xDBC5 );
+	op( a, 0xAE00 ); op( a, 0xF365 );
+
+	/* wait for the next frame */
+	op( a, 0x6D01 ); op( a, 0xFD15 );
+	u16 wait = here( a );
+	op( a, 0xFD07 ); op( a, 0x3D00 ); op( a, 0x1000 | wait );
+	op( a, 0x1000 | loop );
+}
+
+/* redraws a screen of random tiles every frame, checking collisions */
+static void
+gen_tiles ( struct rom_asm *a ) {
+	static const u8 tiles[32] = {
+		0xFF, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0xFF,
+		0x18, 0x3C, 0x7E, 0xFF, 0xFF, 0x7E, 0x3C, 0x18,
+		0xAA, 0x55, 0xAA, 0x55, 0xAA, 0x55, 0xAA, 0x55,
+		0x00, 0x3C, 0x24, 0x24, 0x24, 0x24, 0x3C, 0x00,
+	};
+	size_t start = forward( a, 0x1000 );
+	u16 spr = here( a );
+	bytes( a, tiles, sizeof(tiles) );
+	patch( a, start, here( a ) );
+
+	u16 loop = here( a );
+	op( a, 0x00E0 );
+	op( a, 0x6000 ); op( a, 0x6100 ); op( a, 0x6500 );
+	u16 cell = here( a );
+	op( a, 0xC203 );
+	op( a, 0x822E ); op( a, 0x822E ); op( a, 0x822E );
+	op( a, 0xA000 | spr ); op( a, 0xF21E );
+	op( a, 0xD018 );
+	op( a, 0x85F4 );
+	op( a, 0x7008 );
+	op( a, 0x3040 ); op( a, 0x1000 | cell );
+	op( a, 0x6000 );
+	op( a, 0x7108 );
+	op( a, 0x3120 ); op( a, 0x1000 | cell );
+	op( a, 0x6D02 ); op( a, 0xFD15 );
+	u16 wait = here( a );
+	op( a, 0xFD07 ); op( a, 0x3D00 ); op( a, 0x1000 | wait );
+	op( a, 0x1000 | loop );
+}
+
+/* ---- the opcodes each synthetic rom is meant to stress ---- */
+
+static int
+is_alu ( u16 opcode ) {
+	return (opcode >> 12) == 0x6 || (opcode >> 12) == 0x7 || (opcode >> 12) == 0x8;
+}
+
+static int
+is_branch ( u16 opcode ) {
+	switch ( opcode >> 12 ) {
+	case 0x1: case 0x2: case 0x3: case 0x4: case 0x5: case 0x9: return 1;
+	default: return opcode == 0x00EE;
+	}
+}
+
+static int
+is_draw ( u16 opcode ) {
+	return (opcode >> 12) == 0xD || opcode == 0x00E0 || (opcode & 0xF0FF) == 0xF029;
+}
+
+static int
+is_mem ( u16 opcode ) {
+	u16 f = opcode & 0xF0FF;
+	return f == 0xF055 || f == 0xF065 || f == 0xF01E;
+}
+
+static int
+is_bcd ( u16 opcode ) {
+	u16 f = opcode & 0xF0FF;
+	return f == 0xF033 || f == 0xF065;
+}
+
+/* mix is the share of executed instructions, in percent, that the rom has
+   to spend on the opcodes it is named after. the game-like roms have no
+   mix to check */
+static const struct {
+	const char *name;
+	void (*gen) ( struct rom_asm *a );
+	int (*stresses) ( u16 opcode );
+	int mix;
+} synthetic[] = {
+	{ "alu",    gen_alu,    is_alu,    90 },
+	{ "branch", gen_branch, is_branch, 50 },
+	{ "draw",   gen_draw,   is_draw,   30 },
+	{ "mem",    gen_mem,    is_mem,    50 },
+	{ "bcd",    gen_bcd,    is_bcd,    45 },
+	{ "pong",   gen_pong,   NULL,      0 },
+	{ "tiles",  gen_tiles,  NULL,      0 },
+};
+
+/* ---- timing ---- */
+
+static double
+now ( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t
+state_hash ( const struct chip8 *c8 ) {
+	uint64_t h = FNV1A64_INIT;
+	h = fnv1a64( c8->mem, sizeof(c8->mem), h );
+	h = fnv1a64( c8->display, sizeof(c8->display), h );
+	h = fnv1a64( c8->v, sizeof(c8->v), h );
+	h = fnv1a64( &c8->i, sizeof(c8->i), h );
+	h = fnv1a64( &c8->pc, sizeof(c8->pc), h );
+	return h;
+}
+
+static void
+load ( struct chip8 *c8, const struct workload *w ) {
+	chip8_init( c8 );
+	chip8_load_mem( c8, w->rom, w->len );
+}
+
+/* steps a synthetic rom on the reference interpreter and fails unless it
+   stays inside its own code, leaves that code alone and spends at least
+   mix percent of its instructions on the opcodes it stresses. a rom that
+   wanders off into data runs the same garbage on every engine, so the
+   state hashes would not catch it */
+static void
+check_mix ( const struct workload *w, int (*stresses) ( u16 opcode ), int mix ) {
+	static struct chip8 c8;
+	const unsigned long steps = 100000;
+	unsigned long hits = 0;
+
+	load( &c8, w );
+	for ( unsigned long n = 0; n < steps; n++ ) {
+		if ( c8.pc < CHIP8_ROM_START || c8.pc + 1 >= CHIP8_ROM_START + w->len ) {
+			fprintf( stderr, "%s: pc 0x%03X left the rom\n", w->name, c8.pc );
+			exit(EXIT_FAILURE);
+		}
+		if ( stresses && stresses( (c8.mem[c8.pc] << 8) | c8.mem[c8.pc + 1] ) ) { hits++; }
+		chip8_step( &c8 );
+	}
+	if ( memcmp( c8.mem + CHIP8_ROM_START, w->rom, w->len ) != 0 ) {
+		fprintf( stderr, "%s: overwrote its own code\n", w->name );
+		exit(EXIT_FAILURE);
+	}
+	if ( hits * 100 < steps * mix ) {
+		fprintf( stderr, "%s: only %lu%% of the mix is the opcodes it stresses, want %d%%\n",
+			w->name, hits * 100 / steps, mix );
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* cycles instructions on an engine with a timer tick every ipf, returns
+   the seconds it took */
+static double
+run_engine ( const struct chip8_engine *engine, const struct workload *w,
+             unsigned long long cycles, int ipf, uint64_t *hash ) {
+	static struct chip8 c8;
+	void *ctx = engine->create();
+
+	if ( !ctx ) { fprintf( stderr, "unable to create %s engine\n", engine->name ); exit(EXIT_FAILURE); }
+	load( &c8, w );
+	engine->flush( ctx );
+
+	double start = now();
+	for ( unsigned long long left = cycles; left > 0; ) {
+		unsigned long chunk = (left < (unsigned long) ipf)? left : ipf;
+		unsigned long done = 0, n;
+
+		while ( done < chunk && (n = engine->run( ctx, &c8, chunk - done )) > 0 ) { done += n; }
+		chip8_timer_tick( &c8 );
+		left -= chunk;
+	}
+	double elapsed = now() - start;
+
+	engine->destroy( ctx );
+	*hash = state_hash( &c8 );
+	return elapsed;
+}
+
+/* the same on a paged machine */
+static double
+run_paged ( const struct workload *w, unsigned long long cycles, int ipf, uint64_t *hash ) {
+	static struct chip8 c8;
+	struct chip8_paged p;
+
+	load( &c8, w );
+	struct chip8_image *image = chip8_image_create( &c8 );
+	if ( !image ) { fprintf( stderr, "out of memory\n" ); exit(EXIT_FAILURE); }
+	chip8_paged_load( &p, image, &c8 );
+
+	double start = now();
+	for ( unsigned long long left = cycles; left > 0; ) {
+		unsigned long chunk = (left < (unsigned long) ipf)? left : ipf;
+		unsigned long done = 0, n;
+
+		while ( done < chunk && (n = chip8_paged_run_cycles( &p, chunk - done )) > 0 ) { done += n; }
+		chip8_paged_timer_tick( &p );
+		left -= chunk;
+	}
+	double elapsed = now() - start;
+
+	chip8_paged_store( &p, &c8 );
+	chip8_paged_release( &p );
+	chip8_image_destroy( image );
+	*hash = state_hash( &c8 );
+	return elapsed;
+}
+
+static int
+by_value ( const void *a, const void *b ) {
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+/* ns per instruction as the median of the repeats, and their coefficient
+   of variation */
+static void
+report ( const char *workload, const char *engine, double *secs, int repeats,
+         unsigned long long cycles, uint64_t hash ) {
+	double mean = 0, var = 0;
+
+	for ( int r = 0; r < repeats; r++ ) { mean += secs[r]; }
+	mean /= repeats;
+	for ( int r = 0; r < repeats; r++ ) { var += (secs[r] - mean) * (secs[r] - mean); }
+	var /= repeats;
+
+	qsort( secs, repeats, sizeof(double), by_value );
+	double median = (repeats & 1)? secs[repeats / 2] : (secs[repeats / 2 - 1] + secs[repeats / 2]) / 2;
+	double ns = median * 1e9 / cycles;
+
+	fprintf( stdout, "%s\t%s\t%.3f\t%.1f\t%.1f\t%016llX\n", workload, engine,
+		ns, 1e3 / ns, 100 * sqrt( var ) / mean, (unsigned long long) hash );
+	fflush( stdout );
+}
+
+static void
+usage ( const char *progname ) {
+	fprintf( stdout, "usage: %s [-c CYCLES] [-r REPEATS] [-i IPF] [-e ENGINE] [-w WORKLOAD] [ROM...]\n", progname );
+	fprintf( stdout, "  -c CYCLES    instructions per run (default %llu)\n", DEFAULT_CYCLES );
+	fprintf( stdout, "  -r REPEATS   runs per workload and engine, the median is reported (default %d)\n", DEFAULT_REPEATS );
+	fprintf( stdout, "  -i IPF       instructions between timer ticks (default %d)\n", DEFAULT_IPF );
+	fprintf( stdout, "  -e ENGINE    only time ENGINE: paged" );
+	for ( int e = 0; chip8_engines[e]; e++ ) { fprintf( stdout, " %s", chip8_engines[e]->name ); }
+	fprintf( stdout, "\n  -w WORKLOAD  only time WORKLOAD:" );
+	for ( size_t s = 0; s < sizeof(synthetic) / sizeof(synthetic[0]); s++ ) { fprintf( stdout, " %s", synthetic[s].name ); }
+	fprintf( stdout, "\n  ROM          time ROM as well, named by its path\n" );
+	exit(0);
+}
+
+static void
+add_rom ( struct workload *w, const char *path ) {
+	FILE *f = fopen( path, "rb" );
+
+	if ( !f ) { fprintf( stderr, "unable to open rom \"%s\"\n", path ); exit(EXIT_FAILURE); }
+	w->name = path;
+	w->len = fread( w->rom, 1, CHIP8_ROM_MAX, f );
+	fclose(f);
+}
+
+int
+main ( int argc, char *argv[] ) {
+	static struct workload workloads[MAX_WORKLOADS];
+	unsigned long long cycles = DEFAULT_CYCLES;
+	int repeats = DEFAULT_REPEATS, ipf = DEFAULT_IPF, nworkloads = 0;
+	const char *only_engine = NULL, *only_workload = NULL;
+	double secs[MAX_REPEATS];
+
+	for ( size_t s = 0; s < sizeof(synthetic) / sizeof(synthetic[0]); s++ ) {
+		struct rom_asm a = { workloads[nworkloads].rom, 0 };
+		synthetic[s].gen( &a );
+		workloads[nworkloads].name = synthetic[s].name;
+		workloads[nworkloads].len = a.len;
+		check_mix( &workloads[nworkloads++], synthetic[s].stresses, synthetic[s].mix );
+	}
+
+	for ( int i = 1; i < argc; i++ ) {
+		if ( strcmp( "-c", argv[i] ) == 0 && i + 1 < argc ) {
+			cycles = strtoull( argv[++i], NULL, 0 );
+		} else if ( strcmp( "-r", argv[i] ) == 0 && i + 1 < argc ) {
+			repeats = atoi( argv[++i] );
+		} else if ( strcmp( "-i", argv[i] ) == 0 && i + 1 < argc ) {
+			ipf = atoi( argv[++i] );
+		} else if ( strcmp( "-e", argv[i] ) == 0 && i + 1 < argc ) {
+			only_engine = argv[++i];
+		} else if ( strcmp( "-w", argv[i] ) == 0 && i + 1 < argc ) {
+			only_workload = argv[++i];
+		} else if ( strcmp( "-h", argv[i] ) == 0 ) {
+			usage(argv[0]);
+		} else if ( nworkloads < MAX_WORKLOADS ) {
+			add_rom( &workloads[nworkloads++], argv[i] );
+		}
+	}
+	if ( cycles == 0 || ipf < 1 || repeats < 1 || repeats > MAX_REPEATS ) { usage(argv[0]); }
+	if ( only_engine && strcmp( only_engine, "paged" ) != 0 && !chip8_engine_find( only_engine ) ) {
+		fprintf( stderr, "unknown engine \"%s\"\n", only_engine );
+		return EXIT_FAILURE;
+	}
+
+	fprintf( stdout, "# cycles=%llu repeats=%d ipf=%d\n", cycles, repeats, ipf );
+	fprintf( stdout, "workload\tengine\tns/instr\tMinstr/s\tcv%%\tstate\n" );
+
+	for ( int w = 0; w < nworkloads; w++ ) {
+		uint64_t hash = 0;
+
+		if ( only_workload && strcmp( only_workload, workloads[w].name ) != 0 ) { continue; }
+
+		for ( int e = 0; chip8_engines[e]; e++ ) {
+			const struct chip8_engine *engine = chip8_engines[e];
+
+			if ( only_engine && strcmp( only_engine, engine->name ) != 0 ) { continue; }
+			/* the first run warms caches and the cpu clock and is not counted */
+			run_engine( engine, &workloads[w], cycles, ipf, &hash );
+			for ( int r = 0; r < repeats; r++ ) { secs[r] = run_engine( engine, &workloads[w], cycles, ipf, &hash ); }
+			report( workloads[w].name, engine->name, secs, repeats, cycles, hash );
+		}
+
+		if ( !only_engine || strcmp( only_engine, "paged" ) == 0 ) {
+			run_paged( &workloads[w], cycles, ipf, &hash );
+			for ( int r = 0; r < repeats; r++ ) { secs[r] = run_paged( &workloads[w], cycles, ipf, &hash ); }
+			report( workloads[w].name, "paged", secs, repeats, cycles, hash );
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
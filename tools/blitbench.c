@@ -0,0 +1,71 @@
+#include "../src/chip8.h"
+#include "../src/blit.h"
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_FRAMES 200000
+#define DISPLAYS       64
+
+/* times every blitter implementation in every pixel format expanding whole
+   random displays into a texture sized buffer */
+
+static double
+now ( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int
+main ( int argc, char *argv[] ) {
+	static u8 displays[DISPLAYS][CHIP8_DISPLAY_BUF_SIZE];
+	static u8 pixels[CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT * 4];
+	static struct blitter blitter;
+	long frames = DEFAULT_FRAMES;
+
+	if ( argc > 1 ) {
+		if ( strcmp( "-h", argv[1] ) == 0 ) {
+			fprintf( stdout, "usage: %s [FRAMES]\n", argv[0] );
+			fprintf( stdout, "  FRAMES  whole displays to expand per blitter (default %d)\n", DEFAULT_FRAMES );
+			return EXIT_SUCCESS;
+		}
+		frames = strtol( argv[1], NULL, 0 );
+	}
+
+	srand(1);
+	for ( int d = 0; d < DISPLAYS; d++ ) {
+		for ( int i = 0; i < CHIP8_DISPLAY_BUF_SIZE; i++ ) { displays[d][i] = rand(); }
+	}
+
+	fprintf( stdout, "format\tblitter\tns/frame\tMpixel/s\n" );
+
+	for ( int format = 0; format < BLIT_FORMAT_COUNT; format++ ) {
+		for ( int impl = BLIT_IMPL_TABLE; impl < BLIT_IMPL_COUNT; impl++ ) {
+			if ( blit_init( &blitter, format, 0xFFFFFF, 0x000000, impl ) == 0 ) {
+				fprintf( stdout, "%s\t%s\tunsupported\n", blit_format_name(format), blit_impl_name(impl) );
+				continue;
+			}
+
+			int pitch = CHIP8_DISPLAY_WIDTH * blitter.bpp;
+			double start = now();
+			for ( long f = 0; f < frames; f++ ) {
+				blit_rows( &blitter, displays[f % DISPLAYS], 0, CHIP8_DISPLAY_HEIGHT, pixels, pitch );
+			}
+			double elapsed = now() - start;
+
+			double ns = elapsed * 1e9 / frames;
+			double mpix = frames * (double) (CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT) / elapsed / 1e6;
+			fprintf( stdout, "%s\t%s\t%.1f\t%.0f\n", blit_format_name(format), blitter.name, ns, mpix );
+		}
+	}
+
+	/* keep the stores from being optimised away */
+	u8 sum = 0;
+	for ( size_t i = 0; i < sizeof(pixels); i++ ) { sum += pixels[i]; }
+	fprintf( stderr, "checksum %02X\n", sum );
+
+	return EXIT_SUCCESS;
+}
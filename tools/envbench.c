@@ -0,0 +1,115 @@
+#include "../src/chip8.h"
+#include "../src/env.h"
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_ENVS  4096
+#define DEFAULT_STEPS 1000
+
+/* steps vectorized environments running one rom with random actions and
+   reports environment frames per second, the way a training loop would
+   drive them */
+
+static double
+now ( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+usage ( const char *progname ) {
+	fprintf( stdout, "usage: %s [-n ENVS] [-j THREADS] [-k SKIP] [-s STEPS] [-m FRAMES] [-p] ROM\n", progname );
+	fprintf( stdout, "  -n ENVS     environments (default %d)\n", DEFAULT_ENVS );
+	fprintf( stdout, "  -j THREADS  threads stepping them (default: one per core)\n" );
+	fprintf( stdout, "  -k SKIP     frames per step (default 4)\n" );
+	fprintf( stdout, "  -s STEPS    steps to time (default %d)\n", DEFAULT_STEPS );
+	fprintf( stdout, "  -m FRAMES   end episodes after FRAMES frames\n" );
+	fprintf( stdout, "  -p          packed 1 bit per pixel observations instead of bytes\n" );
+	exit(0);
+}
+
+int
+main ( int argc, char *argv[] ) {
+	int n = DEFAULT_ENVS, threads = 0, skip = 4, packed = 0;
+	long steps = DEFAULT_STEPS;
+	unsigned long long max_frames = 0;
+	const char *romfile = NULL;
+	struct chip8 c8;
+
+	for ( int i = 1; i < argc; i++ ) {
+		if ( strcmp( "-n", argv[i] ) == 0 && i + 1 < argc ) {
+			n = atoi( argv[++i] );
+		} else if ( strcmp( "-j", argv[i] ) == 0 && i + 1 < argc ) {
+			threads = atoi( argv[++i] );
+		} else if ( strcmp( "-k", argv[i] ) == 0 && i + 1 < argc ) {
+			skip = atoi( argv[++i] );
+		} else if ( strcmp( "-s", argv[i] ) == 0 && i + 1 < argc ) {
+			steps = strtol( argv[++i], NULL, 0 );
+		} else if ( strcmp( "-m", argv[i] ) == 0 && i + 1 < argc ) {
+			max_frames = strtoull( argv[++i], NULL, 0 );
+		} else if ( strcmp( "-p", argv[i] ) == 0 ) {
+			packed = 1;
+		} else if ( strcmp( "-h", argv[i] ) == 0 ) {
+			usage(argv[0]);
+		} else {
+			romfile = argv[i];
+		}
+	}
+	if ( !romfile || n < 1 || skip < 1 ) { usage(argv[0]); }
+
+	chip8_init( &c8 );
+	if ( !chip8_load( &c8, romfile ) ) {
+		fprintf( stderr, "unable to load rom \"%s\"\n", romfile );
+		return EXIT_FAILURE;
+	}
+
+	struct chip8_env *env = chip8_env_create( &c8, n, threads );
+	if ( !env ) { fprintf( stderr, "out of memory\n" ); return EXIT_FAILURE; }
+	env->skip = skip;
+	env->max_frames = max_frames;
+	env->obs = packed? CHIP8_ENV_OBS_PACKED : CHIP8_ENV_OBS_PIXELS;
+
+	u8 *obs = malloc( chip8_env_obs_size( env ) * n );
+	u16 *actions = malloc( sizeof(u16) * n );
+	float *rewards = malloc( sizeof(float) * n );
+	u8 *dones = malloc( n );
+	if ( !obs || !actions || !rewards || !dones ) { fprintf( stderr, "out of memory\n" ); return EXIT_FAILURE; }
+
+	chip8_env_reset( env, obs );
+
+	uint32_t r = 1;
+	unsigned long long episodes = 0;
+	double start = now();
+	for ( long s = 0; s < steps; s++ ) {
+		/* one random key, or none, per environment */
+		for ( int e = 0; e < n; e++ ) {
+			r ^= r << 13; r ^= r >> 17; r ^= r << 5;
+			actions[e] = (r % 17 < 16)? 1 << (r % 17) : 0;
+		}
+		chip8_env_step( env, actions, obs, rewards, dones );
+		for ( int e = 0; e < n; e++ ) { episodes += dones[e]; }
+	}
+	double elapsed = now() - start;
+
+	long written = 0;
+	for ( int e = 0; e < n; e++ ) { written += chip8_paged_written( &env->machines[e] ); }
+	double frames = (double) steps * n * skip;
+
+	fprintf( stdout, "%d envs, %ld steps of %d frames in %.3fs on %d threads\n",
+		n, steps, skip, elapsed, env->threads );
+	fprintf( stdout, "%.0f env steps/sec, %.0f env frames/sec\n",
+		steps * n / elapsed, frames / elapsed );
+	fprintf( stdout, "%llu episodes ended, %.2f written pages per env\n",
+		episodes, (double) written / n );
+
+	chip8_env_destroy( env );
+	free( obs );
+	free( actions );
+	free( rewards );
+	free( dones );
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,210 @@
+#include "../src/chip8.h"
+#include "../src/framelog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* reads a frame log written by chip8-batch -d. prints how well it
+   compressed, and writes a range of frames as PNG images or prints them
+   as text */
+
+#define MAX_SCALE 32
+
+static void
+usage ( const char *progname ) {
+	fprintf( stdout, "usage: %s [-o DIR] [-t] [-f FIRST] [-n COUNT] [-x SCALE] LOG\n", progname );
+	fprintf( stdout, "  -o DIR      write frames to DIR as 1 bit PNG images, DIR/000000.png on\n" );
+	fprintf( stdout, "  -t          print frames as text\n" );
+	fprintf( stdout, "  -f FIRST    first frame to write or print (default 0)\n" );
+	fprintf( stdout, "  -n COUNT    frames to write or print (default all)\n" );
+	fprintf( stdout, "  -x SCALE    pixels per CHIP-8 pixel in the images (default 1)\n" );
+	exit(0);
+}
+
+/* ---- png ---- */
+
+static uint32_t crc_table[256];
+
+static void
+init_crc ( void ) {
+	for ( uint32_t n = 0; n < 256; n++ ) {
+		uint32_t c = n;
+		for ( int k = 0; k < 8; k++ ) { c = (c & 1)? 0xEDB88320u ^ (c >> 1) : c >> 1; }
+		crc_table[n] = c;
+	}
+}
+
+static uint32_t
+crc32 ( uint32_t crc, const u8 *p, size_t n ) {
+	crc = ~crc;
+	for ( size_t i = 0; i < n; i++ ) { crc = crc_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8); }
+	return ~crc;
+}
+
+static u8 *
+put32be ( u8 *p, uint32_t v ) {
+	p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+	return p + 4;
+}
+
+static int
+write_chunk ( FILE *f, const char *type, const u8 *data, size_t len ) {
+	u8 head[8], tail[4];
+
+	put32be( head, len );
+	memcpy( head + 4, type, 4 );
+	put32be( tail, crc32( crc32( 0, head + 4, 4 ), data, len ) );
+	return fwrite( head, 1, 8, f ) == 8 && fwrite( data, 1, len, f ) == len && fwrite( tail, 1, 4, f ) == 4;
+}
+
+/* 1 bit grayscale, white pixels on black. the scanlines go into zlib
+   stored blocks, at these sizes compressing them is not worth the code */
+static int
+write_png ( const char *path, const u8 *display, int scale ) {
+	static const u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	int w = CHIP8_DISPLAY_WIDTH * scale, h = CHIP8_DISPLAY_HEIGHT * scale;
+	size_t stride = 1 + (w + 7) / 8;
+	size_t raw_len = stride * h;
+	u8 *raw = calloc( 1, raw_len );
+	/* zlib header, a 5 byte header per 65535 byte block and the adler32 */
+	u8 *z = malloc( 2 + raw_len + 5 * (raw_len / 0xFFFF + 1) + 4 );
+	u8 ihdr[13];
+	FILE *f = NULL;
+	int ok = 0;
+
+	if ( !raw || !z ) { goto done; }
+
+	for ( int y = 0; y < h; y++ ) {
+		const u8 *src = display + (y / scale) * CHIP8_DISPLAY_BUF_WIDTH;
+		u8 *row = raw + y * stride + 1;  /* filter byte 0, none */
+		for ( int x = 0; x < w; x++ ) {
+			int px = x / scale;
+			if ( (src[px / 8] >> (7 - px % 8)) & 1 ) { row[x / 8] |= 0x80 >> (x % 8); }
+		}
+	}
+
+	u8 *p = z;
+	*p++ = 0x78; *p++ = 0x01;
+	uint32_t a = 1, b = 0;
+	for ( size_t i = 0; i < raw_len; i++ ) {
+		a = (a + raw[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	for ( size_t at = 0, n; at < raw_len; at += n ) {
+		n = (raw_len - at > 0xFFFF)? 0xFFFF : raw_len - at;
+		*p++ = (at + n == raw_len);  /* last block */
+		*p++ = n; *p++ = n >> 8;
+		*p++ = ~n; *p++ = ~n >> 8;
+		memcpy( p, raw + at, n );
+		p += n;
+	}
+	p = put32be( p, (b << 16) | a );
+
+	put32be( ihdr, w );
+	put32be( ihdr + 4, h );
+	ihdr[8] = 1;   /* bit depth */
+	ihdr[9] = 0;   /* grayscale */
+	ihdr[10] = ihdr[11] = ihdr[12] = 0;
+
+	if ( (f = fopen( path, "wb" )) == NULL ) { goto done; }
+	ok = fwrite( signature, 1, sizeof(signature), f ) == sizeof(signature) &&
+	     write_chunk( f, "IHDR", ihdr, sizeof(ihdr) ) &&
+	     write_chunk( f, "IDAT", z, p - z ) &&
+	     write_chunk( f, "IEND", NULL, 0 );
+	if ( fclose( f ) != 0 ) { ok = 0; }
+
+done:
+	free( raw );
+	free( z );
+	return ok;
+}
+
+static void
+print_frame ( unsigned long index, const u8 *display ) {
+	fprintf( stdout, "frame %lu\n", index );
+	for ( int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++ ) {
+		char line[CHIP8_DISPLAY_WIDTH + 1];
+		for ( int x = 0; x < CHIP8_DISPLAY_WIDTH; x++ ) {
+			line[x] = ((display[y * CHIP8_DISPLAY_BUF_WIDTH + x / 8] >> (7 - x % 8)) & 1)? '#' : '.';
+		}
+		line[CHIP8_DISPLAY_WIDTH] = 0;
+		fprintf( stdout, "%s\n", line );
+	}
+}
+
+int
+main ( int argc, char *argv[] ) {
+	const char *logfile = NULL, *dir = NULL;
+	unsigned long first = 0, count = (unsigned long) -1;
+	int text = 0, scale = 1, interval;
+
+	for ( int i = 1; i < argc; i++ ) {
+		if ( strcmp( "-o", argv[i] ) == 0 && i + 1 < argc ) {
+			dir = argv[++i];
+		} else if ( strcmp( "-t", argv[i] ) == 0 ) {
+			text = 1;
+		} else if ( strcmp( "-f", argv[i] ) == 0 && i + 1 < argc ) {
+			first = strtoul( argv[++i], NULL, 0 );
+		} else if ( strcmp( "-n", argv[i] ) == 0 && i + 1 < argc ) {
+			count = strtoul( argv[++i], NULL, 0 );
+		} else if ( strcmp( "-x", argv[i] ) == 0 && i + 1 < argc ) {
+			scale = atoi( argv[++i] );
+		} else if ( strcmp( "-h", argv[i] ) == 0 ) {
+			usage(argv[0]);
+		} else {
+			logfile = argv[i];
+		}
+	}
+	if ( !logfile || scale < 1 || scale > MAX_SCALE ) { usage(argv[0]); }
+
+	FILE *f = fopen( logfile, "rb" );
+	if ( !f ) { fprintf( stderr, "unable to open \"%s\"\n", logfile ); return EXIT_FAILURE; }
+	if ( !chip8_framelog_read_header( f, &interval ) ) {
+		fprintf( stderr, "\"%s\" is not a frame log\n", logfile );
+		return EXIT_FAILURE;
+	}
+	init_crc();
+
+	u8 display[CHIP8_DISPLAY_BUF_SIZE], prev[CHIP8_DISPLAY_BUF_SIZE];
+	unsigned long frames = 0, changed = 0, written = 0;
+	int status = EXIT_SUCCESS, r;
+
+	memset( prev, 0, sizeof(prev) );
+	memset( display, 0, sizeof(display) );
+	while ( (r = chip8_framelog_read( f, interval, frames, display )) == 1 ) {
+		if ( frames > 0 && memcmp( display, prev, sizeof(display) ) != 0 ) { changed++; }
+		memcpy( prev, display, sizeof(prev) );
+
+		if ( frames >= first && frames - first < count ) {
+			if ( text ) { print_frame( frames, display ); }
+			if ( dir ) {
+				char path[4096];
+				snprintf( path, sizeof(path), "%s/%06lu.png", dir, frames );
+				if ( !write_png( path, display, scale ) ) {
+					fprintf( stderr, "unable to write \"%s\"\n", path );
+					status = EXIT_FAILURE;
+					break;
+				}
+				written++;
+			}
+		}
+		frames++;
+	}
+	if ( r < 0 ) {
+		fprintf( stderr, "frame %lu is damaged, stopping there\n", frames );
+		status = EXIT_FAILURE;
+	}
+
+	long size = ftell( f );
+	fclose( f );
+
+	fprintf( stderr, "%lu frames, %lu changed, keyframe every %d, %ld bytes (%.1f bytes/frame, %.0fx smaller than raw)",
+		frames, changed, interval, size,
+		frames? (double) (size - CHIP8_FRAMELOG_HEADER) / frames : 0,
+		(size > CHIP8_FRAMELOG_HEADER)? (double) frames * CHIP8_DISPLAY_BUF_SIZE / (size - CHIP8_FRAMELOG_HEADER) : 0
+	);
+	if ( dir ) { fprintf( stderr, ", %lu images written", written ); }
+	fprintf( stderr, "\n" );
+	return status;
+}
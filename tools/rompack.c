@@ -0,0 +1,131 @@
+#include "../src/chip8.h"
+#include "../src/rompack.h"
+#include "../src/hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* builds a rom pack from rom files, or lists what is in one */
+
+struct roms {
+	const u8 **data;
+	size_t *lens;
+	size_t n, cap;
+};
+
+static void
+usage ( const char *progname ) {
+	fprintf( stdout, "usage: %s -o PACK [-l LIST] ROM...\n", progname );
+	fprintf( stdout, "       %s -t PACK\n", progname );
+	fprintf( stdout, "  -o PACK  write the roms given to PACK, printing the hash of each\n" );
+	fprintf( stdout, "  -l LIST  read ROM paths from LIST, one per line\n" );
+	fprintf( stdout, "  -t PACK  list the hash and length of every rom in PACK\n" );
+	exit(0);
+}
+
+/* read a rom into memory, skipping it with a warning if that fails */
+static void
+add_rom ( struct roms *roms, const char *path ) {
+	u8 *rom = malloc( CHIP8_ROM_MAX + 1 );
+	FILE *f = fopen( path, "rb" );
+
+	if ( !rom ) { fprintf( stderr, "out of memory\n" ); exit(EXIT_FAILURE); }
+	if ( !f ) {
+		fprintf( stderr, "unable to open rom \"%s\"\n", path );
+		free( rom );
+		return;
+	}
+
+	size_t len = fread( rom, 1, CHIP8_ROM_MAX + 1, f );
+	int error = ferror( f );
+	fclose(f);
+	if ( error || len > CHIP8_ROM_MAX ) {
+		fprintf( stderr, "%s rom \"%s\"\n", error? "unable to read" : "skipping oversized", path );
+		free( rom );
+		return;
+	}
+
+	if ( roms->n == roms->cap ) {
+		roms->cap = roms->cap? roms->cap * 2 : 256;
+		roms->data = realloc( roms->data, sizeof(*roms->data) * roms->cap );
+		roms->lens = realloc( roms->lens, sizeof(*roms->lens) * roms->cap );
+		if ( !roms->data || !roms->lens ) { fprintf( stderr, "out of memory\n" ); exit(EXIT_FAILURE); }
+	}
+	roms->data[roms->n] = rom;
+	roms->lens[roms->n++] = len;
+	fprintf( stdout, "%016llX\t%s\n",
+		(unsigned long long) fnv1a64( rom, len, FNV1A64_INIT ), path );
+}
+
+static void
+add_list ( struct roms *roms, const char *listfile ) {
+	char line[4096];
+	FILE *f = fopen( listfile, "r" );
+
+	if ( !f ) { fprintf( stderr, "unable to open list \"%s\"\n", listfile ); exit(EXIT_FAILURE); }
+
+	while ( fgets( line, sizeof(line), f ) ) {
+		line[strcspn( line, "\r\n" )] = '\0';
+		if ( line[0] != '\0' ) { add_rom( roms, line ); }
+	}
+
+	fclose(f);
+}
+
+static int
+list ( const char *path ) {
+	struct chip8_rompack *pack = chip8_rompack_open( path );
+
+	if ( !pack ) {
+		fprintf( stderr, "\"%s\" is not a rom pack\n", path );
+		return EXIT_FAILURE;
+	}
+
+	for ( uint32_t i = 0; i < pack->count; i++ ) {
+		const u8 *rom;
+		size_t len;
+		uint64_t hash = chip8_rompack_rom( pack, i, &rom, &len );
+		fprintf( stdout, "%016llX\t%zu\n", (unsigned long long) hash, len );
+	}
+
+	chip8_rompack_close( pack );
+	return EXIT_SUCCESS;
+}
+
+int
+main ( int argc, char *argv[] ) {
+	struct roms roms = { 0 };
+	const char *out = NULL;
+
+	for ( int i = 1; i < argc; i++ ) {
+		if ( strcmp( "-o", argv[i] ) == 0 && i + 1 < argc ) {
+			out = argv[++i];
+		} else if ( strcmp( "-l", argv[i] ) == 0 && i + 1 < argc ) {
+			add_list( &roms, argv[++i] );
+		} else if ( strcmp( "-t", argv[i] ) == 0 && i + 1 < argc ) {
+			return list( argv[++i] );
+		} else if ( strcmp( "-h", argv[i] ) == 0 ) {
+			usage(argv[0]);
+		} else {
+			add_rom( &roms, argv[i] );
+		}
+	}
+	if ( !out ) { usage(argv[0]); }
+
+	long stored = chip8_rompack_write( out, roms.data, roms.lens, roms.n );
+	if ( stored == CHIP8_ROMPACK_COLLISION ) {
+		fprintf( stderr, "two different roms have the same hash, not writing \"%s\"\n", out );
+		return EXIT_FAILURE;
+	}
+	if ( stored < 0 ) {
+		fprintf( stderr, "unable to write rom pack \"%s\"\n", out );
+		return EXIT_FAILURE;
+	}
+	fprintf( stderr, "%zu roms, %ld unique, written to %s\n", roms.n, stored, out );
+
+	for ( size_t r = 0; r < roms.n; r++ ) { free( (void *) roms.data[r] ); }
+	free( roms.data );
+	free( roms.lens );
+	return EXIT_SUCCESS;
+}
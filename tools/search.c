@@ -0,0 +1,634 @@
+#include "../src/chip8.h"
+#include "../src/paged.h"
+#include "../src/input.h"
+#include "../src/hash.h"
+
+#include <time.h>
+#include <ctype.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define DEFAULT_DEPTH  12
+#define DEFAULT_HOLD   4
+#define DEFAULT_STATES (1 << 22)
+#define DEFAULT_SEED   1
+#define MAX_DEPTH      255
+#define MAX_TARGETS    8
+#define MAX_ACTIONS    17
+
+/* searches for key presses that take a rom to a target state. every node
+   is a paged machine at a frame boundary plus the presses that led there.
+   expanding it forks one child per action (no key, or one key held down),
+   runs each child for -f frames and keeps the children whose state was
+   not seen before, or not at a depth this shallow. states are told apart
+   by chip8_paged_hash in a lock-free open addressing table.
+
+   each thread works depth first on its own Chase-Lev deque, taking from
+   the bottom, and idle threads steal the oldest, shallowest nodes from
+   the top of the others'. a found sequence is replayed on a struct chip8
+   through chip8_step to check it and can be written as an input log. it is
+   within the depth limit but not necessarily the shortest */
+
+enum { T_V, T_MEM, T_BCD, T_I, T_PC, T_DISPLAY };
+enum { CMP_EQ, CMP_NE, CMP_LE, CMP_GE, CMP_LT, CMP_GT };
+
+struct target {
+	int what;
+	int addr;     /* register for T_V, address for T_MEM and T_BCD */
+	int cmp;
+	uint64_t value;
+};
+
+struct node {
+	struct chip8_paged m;
+	struct node *next;   /* on a worker's free list */
+	int depth;
+	u8 path[MAX_DEPTH];  /* index into actions of each step */
+};
+
+/* top is taken by thieves and bottom by the owner, kept on separate cache
+   lines */
+struct deque {
+	atomic_long top;
+	char pad[64 - sizeof(atomic_long)];
+	atomic_long bottom;
+	_Atomic(struct node *) *buf;
+	long mask;
+};
+
+struct worker {
+	struct deque deque;
+	struct node *free;
+	struct search *search;
+	int id;
+	uint32_t rng;  /* picks steal victims */
+
+	unsigned long long states;
+	unsigned long long steals;
+};
+
+struct search {
+	struct chip8_image *image;
+	struct target targets[MAX_TARGETS];
+	int ntargets;
+	u16 actions[MAX_ACTIONS];
+	int nactions;
+	int depth;
+	int hold;
+
+	/* visited states and the shallowest depth each was reached at. key 0
+	   marks an empty slot */
+	_Atomic uint64_t *keys;
+	_Atomic u16 *depths;
+	size_t mask;
+	atomic_ullong unique;
+	unsigned long long limit;
+
+	atomic_long pending;  /* nodes pushed and not yet expanded */
+	atomic_int stop;
+	_Atomic(struct node *) found;
+
+	struct worker *workers;
+	int nthreads;
+};
+
+static double
+now ( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+usage ( const char *progname ) {
+	fprintf( stdout, "usage: %s -t TARGET... [-d DEPTH] [-f FRAMES] [-K KEYS] [-i IPF] [-s SEED] [-m STATES] [-j THREADS] [-o LOG] ROM\n", progname );
+	fprintf( stdout, "  -t TARGET   state to reach, all of them when given several:\n" );
+	fprintf( stdout, "              vX, mem[ADDR], bcd[ADDR], i or pc compared with =, !=, <, <=, >, >= to a\n" );
+	fprintf( stdout, "              number, or display=HASH as printed by chip8-batch\n" );
+	fprintf( stdout, "  -d DEPTH    most key presses in a sequence (default %d)\n", DEFAULT_DEPTH );
+	fprintf( stdout, "  -f FRAMES   frames each press is held for (default %d)\n", DEFAULT_HOLD );
+	fprintf( stdout, "  -K KEYS     hex digits of the keys to try (default all 16), no key is always tried\n" );
+	fprintf( stdout, "  -i IPF      instructions per frame (default %d)\n", CHIP8_DEFAULT_IPF );
+	fprintf( stdout, "  -s SEED     rng seed (default %d)\n", DEFAULT_SEED );
+	fprintf( stdout, "  -m STATES   most distinct states to visit (default %d)\n", DEFAULT_STATES );
+	fprintf( stdout, "  -j THREADS  worker threads (default: one per core)\n" );
+	fprintf( stdout, "  -o LOG      write the sequence found as an input log for chip8 -p\n" );
+	exit(0);
+}
+
+/* ---- targets ---- */
+
+static int
+hexdigit ( char c ) {
+	return isdigit( (unsigned char) c )? c - '0' : toupper( (unsigned char) c ) - 'A' + 10;
+}
+
+static int
+parse_target ( const char *s, struct target *t ) {
+	static const struct { const char *text; int cmp; } cmps[] = {
+		{ "==", CMP_EQ }, { "!=", CMP_NE }, { "<=", CMP_LE }, { ">=", CMP_GE },
+		{ "=", CMP_EQ }, { "<", CMP_LT }, { ">", CMP_GT }
+	};
+	char *end;
+
+	memset( t, 0, sizeof(*t) );
+	if ( (s[0] == 'v' || s[0] == 'V') && isxdigit( (unsigned char) s[1] ) ) {
+		t->what = T_V;
+		t->addr = hexdigit( s[1] );
+		s += 2;
+	} else if ( strncmp( s, "mem[", 4 ) == 0 || strncmp( s, "bcd[", 4 ) == 0 ) {
+		t->what = (s[0] == 'm')? T_MEM : T_BCD;
+		t->addr = strtol( s + 4, &end, 0 ) & CHIP8_ADDR_MASK;
+		if ( end == s + 4 || *end != ']' ) { return 0; }
+		s = end + 1;
+	} else if ( strncmp( s, "display", 7 ) == 0 ) {
+		t->what = T_DISPLAY;
+		s += 7;
+	} else if ( strncmp( s, "pc", 2 ) == 0 ) {
+		t->what = T_PC;
+		s += 2;
+	} else if ( s[0] == 'i' || s[0] == 'I' ) {
+		t->what = T_I;
+		s += 1;
+	} else {
+		return 0;
+	}
+
+	size_t c = 0;
+	while ( c < sizeof(cmps) / sizeof(cmps[0]) && strncmp( s, cmps[c].text, strlen( cmps[c].text ) ) != 0 ) { c++; }
+	if ( c == sizeof(cmps) / sizeof(cmps[0]) ) { return 0; }
+	t->cmp = cmps[c].cmp;
+	s += strlen( cmps[c].text );
+
+	/* display hashes are printed in hex without a prefix */
+	t->value = strtoull( s, &end, (t->what == T_DISPLAY)? 16 : 0 );
+	if ( end == s || *end ) { return 0; }
+	return t->what != T_DISPLAY || t->cmp == CMP_EQ || t->cmp == CMP_NE;
+}
+
+static uint64_t
+target_value ( const struct target *t, const struct chip8_paged *m ) {
+	u8 buf[CHIP8_DISPLAY_BUF_SIZE];
+
+	switch ( t->what ) {
+		case T_V:   return m->v[t->addr];
+		case T_MEM: return chip8_paged_read( m, t->addr );
+		case T_BCD:
+			return chip8_paged_read( m, t->addr ) * 100 +
+			       chip8_paged_read( m, t->addr + 1 ) * 10 +
+			       chip8_paged_read( m, t->addr + 2 );
+		case T_I:   return m->i;
+		case T_PC:  return m->pc;
+		case T_DISPLAY:
+			chip8_display_pack_rows( m->display, buf );
+			return fnv1a64( buf, sizeof(buf), FNV1A64_INIT );
+	}
+	return 0;
+}
+
+static int
+reached ( const struct search *s, const struct chip8_paged *m ) {
+	for ( int k = 0; k < s->ntargets; k++ ) {
+		const struct target *t = &s->targets[k];
+		uint64_t v = target_value( t, m );
+		int ok = 0;
+
+		switch ( t->cmp ) {
+			case CMP_EQ: ok = v == t->value; break;
+			case CMP_NE: ok = v != t->value; break;
+			case CMP_LE: ok = v <= t->value; break;
+			case CMP_GE: ok = v >= t->value; break;
+			case CMP_LT: ok = v <  t->value; break;
+			case CMP_GT: ok = v >  t->value; break;
+		}
+		if ( !ok ) { return 0; }
+	}
+	return 1;
+}
+
+/* ---- visited states ---- */
+
+/* 1 if the state was not seen before or only at a greater depth */
+static int
+visit ( struct search *s, uint64_t key, int depth ) {
+	if ( key == 0 ) { key = 1; }
+
+	for ( size_t i = key & s->mask; ; i = (i + 1) & s->mask ) {
+		uint64_t k = atomic_load_explicit( &s->keys[i], memory_order_relaxed );
+
+		if ( k == 0 && atomic_compare_exchange_strong( &s->keys[i], &k, key ) ) {
+			if ( atomic_fetch_add( &s->unique, 1 ) + 1 >= s->limit ) { atomic_store( &s->stop, 1 ); }
+			k = key;
+		}
+		if ( k != key ) { continue; }
+
+		u16 d = atomic_load_explicit( &s->depths[i], memory_order_relaxed );
+		while ( depth < d ) {
+			if ( atomic_compare_exchange_weak( &s->depths[i], &d, depth ) ) { return 1; }
+		}
+		return 0;
+	}
+}
+
+/* ---- work stealing ---- */
+
+static int
+push ( struct deque *d, struct node *n ) {
+	long b = atomic_load_explicit( &d->bottom, memory_order_relaxed );
+	long t = atomic_load_explicit( &d->top, memory_order_acquire );
+
+	if ( b - t > d->mask ) { return 0; }
+	atomic_store_explicit( &d->buf[b & d->mask], n, memory_order_relaxed );
+	atomic_thread_fence( memory_order_release );
+	atomic_store_explicit( &d->bottom, b + 1, memory_order_relaxed );
+	return 1;
+}
+
+/* the newest node, by the owner */
+static struct node *
+take ( struct deque *d ) {
+	long b = atomic_load_explicit( &d->bottom, memory_order_relaxed ) - 1;
+	struct node *n = NULL;
+
+	atomic_store_explicit( &d->bottom, b, memory_order_relaxed );
+	atomic_thread_fence( memory_order_seq_cst );
+	long t = atomic_load_explicit( &d->top, memory_order_relaxed );
+
+	if ( t <= b ) {
+		n = atomic_load_explicit( &d->buf[b & d->mask], memory_order_relaxed );
+		if ( t == b ) {
+			/* the last one, thieves may be after it too */
+			if ( !atomic_compare_exchange_strong_explicit( &d->top, &t, t + 1,
+			                                               memory_order_seq_cst, memory_order_relaxed ) ) {
+				n = NULL;
+			}
+			atomic_store_explicit( &d->bottom, b + 1, memory_order_relaxed );
+		}
+	} else {
+		atomic_store_explicit( &d->bottom, b + 1, memory_order_relaxed );
+	}
+	return n;
+}
+
+/* the oldest node, by any other thread */
+static struct node *
+steal ( struct deque *d ) {
+	long t = atomic_load_explicit( &d->top, memory_order_acquire );
+	atomic_thread_fence( memory_order_seq_cst );
+	long b = atomic_load_explicit( &d->bottom, memory_order_acquire );
+
+	if ( t >= b ) { return NULL; }
+	struct node *n = atomic_load_explicit( &d->buf[t & d->mask], memory_order_relaxed );
+	if ( !atomic_compare_exchange_strong_explicit( &d->top, &t, t + 1,
+	                                               memory_order_seq_cst, memory_order_relaxed ) ) {
+		return NULL;
+	}
+	return n;
+}
+
+static struct node *
+steal_any ( struct worker *w ) {
+	struct search *s = w->search;
+
+	w->rng ^= w->rng << 13; w->rng ^= w->rng >> 17; w->rng ^= w->rng << 5;
+	for ( int k = 0; k < s->nthreads; k++ ) {
+		struct worker *victim = &s->workers[(w->rng + k) % s->nthreads];
+		struct node *n;
+
+		if ( victim != w && (n = steal( &victim->deque )) != NULL ) {
+			w->steals++;
+			return n;
+		}
+	}
+	return NULL;
+}
+
+/* ---- expanding nodes ---- */
+
+static struct node *
+alloc_node ( struct worker *w ) {
+	struct node *n = w->free;
+
+	if ( n ) {
+		w->free = n->next;
+		return n;
+	}
+	if ( (n = malloc( sizeof(struct node) )) == NULL ) {
+		fprintf( stderr, "out of memory\n" );
+		exit(EXIT_FAILURE);
+	}
+	return n;
+}
+
+/* nodes go back on the list of whichever worker is done with them */
+static void
+free_node ( struct worker *w, struct node *n ) {
+	chip8_paged_release( &n->m );
+	n->next = w->free;
+	w->free = n;
+}
+
+static void
+set_keys ( struct chip8_paged *m, u16 mask ) {
+	for ( int k = 0; k < 16; k++ ) {
+		chip8_paged_key_set_state( m, k, ((mask >> k) & 1)? CHIP8_KEY_DOWN : CHIP8_KEY_UP );
+	}
+}
+
+static void expand ( struct worker *w, struct node *n );
+
+static void
+add_child ( struct worker *w, struct node *c ) {
+	struct search *s = w->search;
+
+	if ( !visit( s, chip8_paged_hash( &c->m ), c->depth ) ) {
+		free_node( w, c );
+		return;
+	}
+	if ( reached( s, &c->m ) ) {
+		struct node *none = NULL;
+		if ( atomic_compare_exchange_strong( &s->found, &none, c ) ) {
+			atomic_store( &s->stop, 1 );
+			return;
+		}
+		free_node( w, c );
+		return;
+	}
+	if ( c->depth >= s->depth ) {
+		free_node( w, c );
+		return;
+	}
+
+	atomic_fetch_add( &s->pending, 1 );
+	if ( !push( &w->deque, c ) ) {
+		/* the deque is sized for the depth limit, but stay correct */
+		expand( w, c );
+		free_node( w, c );
+		atomic_fetch_sub( &s->pending, 1 );
+	}
+}
+
+static void
+expand ( struct worker *w, struct node *n ) {
+	struct search *s = w->search;
+
+	for ( int a = 0; a < s->nactions; a++ ) {
+		if ( atomic_load_explicit( &s->stop, memory_order_relaxed ) ) { return; }
+
+		struct node *c = alloc_node( w );
+		chip8_paged_fork( &c->m, &n->m );
+		set_keys( &c->m, s->actions[a] );
+		for ( int f = 0; f < s->hold; f++ ) {
+			while ( !chip8_paged_run_frame( &c->m ) ) { }
+		}
+		w->states++;
+
+		c->depth = n->depth + 1;
+		memcpy( c->path, n->path, n->depth );
+		c->path[n->depth] = a;
+		add_child( w, c );
+	}
+}
+
+static void *
+work ( void *arg ) {
+	struct worker *w = arg;
+	struct search *s = w->search;
+
+	while ( !atomic_load_explicit( &s->stop, memory_order_relaxed ) ) {
+		struct node *n = take( &w->deque );
+
+		if ( !n && (n = steal_any( w )) == NULL ) {
+			if ( atomic_load( &s->pending ) == 0 ) { break; }
+			sched_yield();
+			continue;
+		}
+		expand( w, n );
+		free_node( w, n );
+		atomic_fetch_sub( &s->pending, 1 );
+	}
+	return NULL;
+}
+
+/* ---- replaying what was found ---- */
+
+static void
+print_keys ( FILE *f, u16 mask ) {
+	if ( !mask ) { fprintf( f, "-" ); }
+	for ( int k = 0; k < 16; k++ ) {
+		if ( (mask >> k) & 1 ) { fprintf( f, "%X", k ); }
+	}
+}
+
+/* run the sequence on c8 through chip8_step, recording it into log if
+   given. 1 if it reaches the targets there too */
+static int
+replay ( const struct search *s, const struct node *found, struct chip8 *c8, struct chip8_input *log ) {
+	u16 held = 0;
+
+	c8->input = log;
+	for ( int d = 0; d < found->depth; d++ ) {
+		u16 mask = s->actions[found->path[d]];
+		for ( int k = 0; k < 16; k++ ) {
+			if ( ((mask ^ held) >> k) & 1 ) {
+				chip8_key_set_state( c8, k, ((mask >> k) & 1)? CHIP8_KEY_DOWN : CHIP8_KEY_UP );
+			}
+		}
+		held = mask;
+		for ( int f = 0; f < s->hold; f++ ) {
+			while ( !chip8_run_frame( c8 ) ) { }
+		}
+	}
+	if ( log ) { chip8_input_end( log, c8 ); }
+	c8->input = NULL;
+
+	struct chip8_paged m;
+	chip8_paged_load( &m, s->image, c8 );
+	int ok = reached( s, &m );
+	chip8_paged_release( &m );
+	return ok;
+}
+
+static void
+print_path ( const struct search *s, const struct node *found ) {
+	fprintf( stdout, "step\tframe\tkeys\n" );
+	for ( int d = 0; d < found->depth; d++ ) {
+		fprintf( stdout, "%d\t%d\t", d + 1, d * s->hold );
+		print_keys( stdout, s->actions[found->path[d]] );
+		fprintf( stdout, "\n" );
+	}
+}
+
+int
+main ( int argc, char *argv[] ) {
+	static struct search s;
+	const char *romfile = NULL, *logfile = NULL;
+	const char *keys = "0123456789ABCDEF";
+	unsigned long long states = DEFAULT_STATES;
+	uint32_t seed = DEFAULT_SEED;
+	int ipf = CHIP8_DEFAULT_IPF;
+	struct chip8 c8;
+
+	s.depth = DEFAULT_DEPTH;
+	s.hold = DEFAULT_HOLD;
+	s.nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	for ( int i = 1; i < argc; i++ ) {
+		if ( strcmp( "-t", argv[i] ) == 0 && i + 1 < argc ) {
+			if ( s.ntargets == MAX_TARGETS ) { fprintf( stderr, "at most %d targets\n", MAX_TARGETS ); return EXIT_FAILURE; }
+			if ( !parse_target( argv[++i], &s.targets[s.ntargets++] ) ) {
+				fprintf( stderr, "bad target \"%s\"\n", argv[i] );
+				return EXIT_FAILURE;
+			}
+		} else if ( strcmp( "-d", argv[i] ) == 0 && i + 1 < argc ) {
+			s.depth = atoi( argv[++i] );
+		} else if ( strcmp( "-f", argv[i] ) == 0 && i + 1 < argc ) {
+			s.hold = atoi( argv[++i] );
+		} else if ( strcmp( "-K", argv[i] ) == 0 && i + 1 < argc ) {
+			keys = argv[++i];
+		} else if ( strcmp( "-i", argv[i] ) == 0 && i + 1 < argc ) {
+			ipf = atoi( argv[++i] );
+		} else if ( strcmp( "-s", argv[i] ) == 0 && i + 1 < argc ) {
+			seed = strtoul( argv[++i], NULL, 0 );
+		} else if ( strcmp( "-m", argv[i] ) == 0 && i + 1 < argc ) {
+			states = strtoull( argv[++i], NULL, 0 );
+		} else if ( strcmp( "-j", argv[i] ) == 0 && i + 1 < argc ) {
+			s.nthreads = atoi( argv[++i] );
+		} else if ( strcmp( "-o", argv[i] ) == 0 && i + 1 < argc ) {
+			logfile = argv[++i];
+		} else if ( strcmp( "-h", argv[i] ) == 0 ) {
+			usage(argv[0]);
+		} else {
+			romfile = argv[i];
+		}
+	}
+	if ( !romfile || s.ntargets == 0 || s.depth < 1 || s.depth > MAX_DEPTH ||
+	     s.hold < 1 || ipf < 1 || states < 1 || s.nthreads < 1 ) {
+		usage(argv[0]);
+	}
+
+	/* no key first, then each key named once */
+	s.actions[s.nactions++] = 0;
+	for ( const char *k = keys; *k; k++ ) {
+		if ( !isxdigit( (unsigned char) *k ) ) { fprintf( stderr, "bad key '%c'\n", *k ); return EXIT_FAILURE; }
+		u16 mask = 1 << hexdigit( *k );
+		int dup = 0;
+		for ( int a = 0; a < s.nactions; a++ ) { dup |= s.actions[a] == mask; }
+		if ( !dup ) { s.actions[s.nactions++] = mask; }
+	}
+
+	chip8_init( &c8 );
+	if ( !chip8_load( &c8, romfile ) ) {
+		fprintf( stderr, "unable to load rom \"%s\"\n", romfile );
+		return EXIT_FAILURE;
+	}
+	c8.ipf = ipf;
+	chip8_seed( &c8, seed );
+	struct chip8 start = c8;
+
+	/* keep the table at most three quarters full */
+	size_t slots = 1;
+	while ( slots < states + states / 3 + 1 ) { slots <<= 1; }
+	s.mask = slots - 1;
+	s.limit = states;
+	s.keys = calloc( slots, sizeof(*s.keys) );
+	s.depths = malloc( slots * sizeof(*s.depths) );
+	s.workers = calloc( s.nthreads, sizeof(struct worker) );
+	s.image = chip8_image_create( &c8 );
+	if ( !s.keys || !s.depths || !s.workers || !s.image ) { fprintf( stderr, "out of memory\n" ); return EXIT_FAILURE; }
+	memset( s.depths, 0xFF, slots * sizeof(*s.depths) );
+
+	/* depth first, a deque holds at most the untried siblings on the way
+	   down from where its owner started */
+	long cap = 1;
+	while ( cap < (long) (s.depth + 1) * s.nactions ) { cap <<= 1; }
+	for ( int t = 0; t < s.nthreads; t++ ) {
+		struct worker *w = &s.workers[t];
+		w->search = &s;
+		w->id = t;
+		w->rng = 0x9E3779B9u * (t + 1);
+		w->deque.mask = cap - 1;
+		w->deque.buf = calloc( cap, sizeof(*w->deque.buf) );
+		if ( !w->deque.buf ) { fprintf( stderr, "out of memory\n" ); return EXIT_FAILURE; }
+	}
+
+	struct node *root = alloc_node( &s.workers[0] );
+	chip8_paged_load( &root->m, s.image, &c8 );
+	root->depth = 0;
+	visit( &s, chip8_paged_hash( &root->m ), 0 );
+	if ( reached( &s, &root->m ) ) {
+		atomic_store( &s.found, root );
+	} else {
+		atomic_store( &s.pending, 1 );
+		push( &s.workers[0].deque, root );
+	}
+
+	pthread_t *threads = malloc( sizeof(pthread_t) * s.nthreads );
+	if ( !threads ) { fprintf( stderr, "out of memory\n" ); return EXIT_FAILURE; }
+	double t0 = now();
+	for ( int t = 0; t < s.nthreads; t++ ) { pthread_create( &threads[t], NULL, work, &s.workers[t] ); }
+	for ( int t = 0; t < s.nthreads; t++ ) { pthread_join( threads[t], NULL ); }
+	double elapsed = now() - t0;
+
+	unsigned long long total = 0, steals = 0;
+	for ( int t = 0; t < s.nthreads; t++ ) {
+		total += s.workers[t].states;
+		steals += s.workers[t].steals;
+	}
+	unsigned long long unique = atomic_load( &s.unique );
+	fprintf( stderr, "%llu states (%llu distinct) in %.3fs on %d threads, %.0f states/sec, %.0f frames/sec, %llu steals\n",
+		total, unique, elapsed, s.nthreads,
+		(elapsed > 0)? total / elapsed : 0, (elapsed > 0)? total * s.hold / elapsed : 0, steals
+	);
+
+	int status = EXIT_SUCCESS;
+	struct node *found = atomic_load( &s.found );
+	if ( !found ) {
+		if ( unique >= s.limit ) {
+			fprintf( stdout, "not found, stopped after %llu distinct states (-m)\n", unique );
+		} else {
+			fprintf( stdout, "not found within %d presses\n", s.depth );
+		}
+		status = EXIT_FAILURE;
+	} else {
+		struct chip8_input *log = logfile? chip8_input_create( &start ) : NULL;
+		fprintf( stdout, "found after %d presses of %d frames\n", found->depth, s.hold );
+		print_path( &s, found );
+		if ( !replay( &s, found, &start, log ) ) {
+			fprintf( stderr, "replaying the presses through chip8_step does not reach the target\n" );
+			status = EXIT_FAILURE;
+		}
+		if ( log ) {
+			if ( log->error ) {
+				fprintf( stderr, "out of memory recording input, not writing \"%s\"\n", logfile );
+				status = EXIT_FAILURE;
+			} else if ( !chip8_input_save( log, logfile ) ) {
+				fprintf( stderr, "unable to write input log \"%s\"\n", logfile );
+				status = EXIT_FAILURE;
+			}
+			chip8_input_destroy( log );
+		}
+		chip8_paged_release( &found->m );
+		free( found );
+	}
+
+	/* whatever was left when the search stopped */
+	for ( int t = 0; t < s.nthreads; t++ ) {
+		struct worker *w = &s.workers[t];
+		struct node *n;
+		while ( (n = take( &w->deque )) != NULL ) { free_node( w, n ); }
+		while ( (n = w->free) != NULL ) { w->free = n->next; free( n ); }
+		free( w->deque.buf );
+	}
+	free( threads );
+	free( s.workers );
+	free( (void *) s.keys );
+	free( (void *) s.depths );
+	chip8_image_destroy( s.image );
+	return status;
+}
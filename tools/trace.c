@@ -0,0 +1,123 @@
+#include "../src/chip8.h"
+#include "../src/disasm.h"
+#include "../src/trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* disassembles a binary trace written by chip8 -T or chip8-batch -T,
+   optionally keeping only some addresses or instructions */
+
+struct filter {
+	unsigned lo, hi;            /* pc range, inclusive */
+	const char *mnemonic;       /* e.g. DRW, NULL for any */
+	unsigned long long skip;    /* matching records to skip */
+	unsigned long long count;   /* matching records to print, 0 for all */
+	int summary;                /* count per mnemonic instead of listing */
+};
+
+static void
+usage ( const char *progname ) {
+	fprintf( stdout, "usage: %s [-p LO[-HI]] [-m MNEMONIC] [-s SKIP] [-n COUNT] [-c] TRACE\n", progname );
+	fprintf( stdout, "  -p LO[-HI]   only instructions at addresses LO to HI\n" );
+	fprintf( stdout, "  -m MNEMONIC  only instructions with this mnemonic, e.g. DRW\n" );
+	fprintf( stdout, "  -s SKIP      skip the first SKIP matching instructions\n" );
+	fprintf( stdout, "  -n COUNT     stop after COUNT matching instructions\n" );
+	fprintf( stdout, "  -c           print how often each mnemonic matched instead\n" );
+	exit(0);
+}
+
+/* length of the mnemonic at the start of text */
+static size_t
+mnemonic_len ( const char *text ) {
+	return strcspn( text, " " );
+}
+
+static int
+matches ( const struct filter *f, const struct chip8_trace_record *r, const char *text ) {
+	if ( r->pc < f->lo || r->pc > f->hi ) { return 0; }
+	if ( f->mnemonic ) {
+		size_t len = mnemonic_len( text );
+		if ( len != strlen( f->mnemonic ) || strncasecmp( text, f->mnemonic, len ) != 0 ) { return 0; }
+	}
+	return 1;
+}
+
+int
+main ( int argc, char *argv[] ) {
+	struct filter filter = { 0, CHIP8_ADDR_MASK, NULL, 0, 0, 0 };
+	const char *path = NULL;
+
+	for ( int i = 1; i < argc; i++ ) {
+		if ( strcmp( "-p", argv[i] ) == 0 && i + 1 < argc ) {
+			char *end;
+			filter.lo = filter.hi = strtoul( argv[++i], &end, 0 );
+			if ( *end == '-' ) { filter.hi = strtoul( end + 1, NULL, 0 ); }
+		} else if ( strcmp( "-m", argv[i] ) == 0 && i + 1 < argc ) {
+			filter.mnemonic = argv[++i];
+		} else if ( strcmp( "-s", argv[i] ) == 0 && i + 1 < argc ) {
+			filter.skip = strtoull( argv[++i], NULL, 0 );
+		} else if ( strcmp( "-n", argv[i] ) == 0 && i + 1 < argc ) {
+			filter.count = strtoull( argv[++i], NULL, 0 );
+		} else if ( strcmp( "-c", argv[i] ) == 0 ) {
+			filter.summary = 1;
+		} else if ( strcmp( "-h", argv[i] ) == 0 ) {
+			usage(argv[0]);
+		} else {
+			path = argv[i];
+		}
+	}
+	if ( !path ) { usage(argv[0]); }
+
+	FILE *f = fopen( path, "rb" );
+	if ( !f ) { fprintf( stderr, "unable to open \"%s\"\n", path ); return EXIT_FAILURE; }
+	if ( !chip8_trace_read_header( f ) ) {
+		fprintf( stderr, "\"%s\" is not a chip-8 trace\n", path );
+		fclose(f);
+		return EXIT_FAILURE;
+	}
+
+	/* summary counts, one per distinct mnemonic */
+	struct { char name[8]; unsigned long long n; } counts[64];
+	int ncounts = 0;
+
+	struct chip8_trace_record r;
+	char text[CHIP8_DISASM_MAX];
+	unsigned long long index = 0, matched = 0, shown = 0;
+
+	for ( ; chip8_trace_read( f, &r ); index++ ) {
+		chip8_disasm( r.opcode, text, sizeof(text) );
+		if ( !matches( &filter, &r, text ) ) { continue; }
+		if ( matched++ < filter.skip ) { continue; }
+		if ( filter.count && shown == filter.count ) { break; }
+		shown++;
+
+		if ( filter.summary ) {
+			size_t len = mnemonic_len( text );
+			int c = 0;
+			while ( c < ncounts && (strlen( counts[c].name ) != len || strncmp( counts[c].name, text, len ) != 0) ) { c++; }
+			if ( c == ncounts ) {
+				snprintf( counts[c].name, sizeof(counts[c].name), "%.*s", (int) len, text );
+				counts[c].n = 0;
+				ncounts++;
+			}
+			counts[c].n++;
+			continue;
+		}
+
+		/* same layout as the DEBUG output, then the registers it left */
+		fprintf( stdout, "%llu\t0x%04X : 0x%04X : %-16s V%X=%02X VF=%02X I=%03X\n",
+			index, r.pc, r.opcode, text, (r.opcode >> 8) & 0xF, r.vx, r.vf, r.i );
+	}
+
+	if ( filter.summary ) {
+		for ( int c = 0; c < ncounts; c++ ) {
+			fprintf( stdout, "%s\t%llu\t%.2f%%\n", counts[c].name, counts[c].n, 100.0 * counts[c].n / shown );
+		}
+	}
+
+	fclose(f);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,842 @@
+#include "../src/chip8.h"
+#include "../src/engine.h"
+#include "../src/paged.h"
+#include "../src/lockstep.h"
+#include "../src/state.h"
+#include "../src/input.h"
+#include "../src/rompack.h"
+#include "../src/disasm.h"
+#include "../src/hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define DEFAULT_CASES  100000
+#define DEFAULT_FRAMES 60
+#define DEFAULT_IPF    20
+#define DEFAULT_LANES  8
+#define MAX_LANES      64
+#define MEMRUN_IPF     1000  /* enough for gen_memrun to fill a code buffer */
+
+/* runs a candidate engine next to chip8_step on the same programs and
+   input and reports the first instruction after which they disagree.
+
+   cases are either generated rom fragments, mostly valid instructions with
+   jumps kept inside the fragment, now and then code that rewrites itself or
+   long runs of Fx65, or roms given on the command line or in
+   a pack. every lane of a case gets its own random keys, or with -p lane 0
+   replays a recorded input log. machines run frames of ipf instructions
+   with a timer tick after each, and every interval frames each lane's
+   chip8_state_hash is compared. on a mismatch the case is run again from
+   the start with the same budgets, bisecting on the instructions run into
+   the first frame that differs, to find the exact instruction. everything about a case follows from the seed and
+   its number, so -x CASE -n 1 repeats it */
+
+/* ---- candidates, all with the same exact instruction budget semantics ---- */
+
+struct candidate {
+	const char *name;
+	void *(*create) ( const struct candidate *cand, int lanes );
+	void  (*destroy) ( void *c );
+	/* start every lane as start */
+	void  (*load) ( void *c, const struct chip8 *start );
+	void  (*key) ( void *c, int lane, int key, int state );
+	/* exactly cycles instructions on every lane */
+	void  (*run) ( void *c, unsigned long cycles );
+	void  (*tick) ( void *c );
+	void  (*get) ( void *c, int lane, struct chip8 *out );
+	const struct chip8_engine *engine;
+};
+
+/* an engine, one machine and context per lane */
+struct engine_lanes {
+	const struct chip8_engine *engine;
+	int n;
+	struct chip8 *lanes;
+	void *ctx[MAX_LANES];
+};
+
+static void *
+engine_create ( const struct candidate *cand, int n ) {
+	struct engine_lanes *e = calloc( 1, sizeof(struct engine_lanes) );
+
+	if ( !e ) { return NULL; }
+	e->engine = cand->engine;
+	e->n = n;
+	e->lanes = malloc( sizeof(struct chip8) * n );
+	if ( !e->lanes ) { free( e ); return NULL; }
+	for ( int l = 0; l < n; l++ ) {
+		e->ctx[l] = e->engine->create();
+		if ( !e->ctx[l] ) { fprintf( stderr, "unable to create %s engine\n", e->engine->name ); exit(EXIT_FAILURE); }
+	}
+	return e;
+}
+
+static void
+engine_destroy ( void *c ) {
+	struct engine_lanes *e = c;
+	for ( int l = 0; l < e->n; l++ ) { e->engine->destroy( e->ctx[l] ); }
+	free( e->lanes );
+	free( e );
+}
+
+static void
+engine_load ( void *c, const struct chip8 *start ) {
+	struct engine_lanes *e = c;
+	for ( int l = 0; l < e->n; l++ ) {
+		e->lanes[l] = *start;
+		e->engine->flush( e->ctx[l] );
+	}
+}
+
+static void
+engine_key ( void *c, int lane, int key, int state ) {
+	struct engine_lanes *e = c;
+	chip8_key_set_state( &e->lanes[lane], key, state );
+}
+
+static void
+engine_run ( void *c, unsigned long cycles ) {
+	struct engine_lanes *e = c;
+	for ( int l = 0; l < e->n; l++ ) {
+		unsigned long done = 0;
+		while ( done < cycles ) { done += e->engine->run( e->ctx[l], &e->lanes[l], cycles - done ); }
+	}
+}
+
+static void
+engine_tick ( void *c ) {
+	struct engine_lanes *e = c;
+	for ( int l = 0; l < e->n; l++ ) { chip8_timer_tick( &e->lanes[l] ); }
+}
+
+static void
+engine_get ( void *c, int lane, struct chip8 *out ) {
+	struct engine_lanes *e = c;
+	*out = e->lanes[lane];
+}
+
+/* paged machines sharing one image per case */
+struct paged_lanes {
+	int n;
+	struct chip8_image *image;
+	struct chip8_paged lanes[MAX_LANES];
+};
+
+static void *
+paged_create ( const struct candidate *cand, int n ) {
+	struct paged_lanes *p = calloc( 1, sizeof(struct paged_lanes) );
+	if ( p ) { p->n = n; }
+	return p;
+}
+
+static void
+paged_release ( struct paged_lanes *p ) {
+	for ( int l = 0; l < p->n; l++ ) { chip8_paged_release( &p->lanes[l] ); }
+	if ( p->image ) { chip8_image_destroy( p->image ); }
+	p->image = NULL;
+}
+
+static void
+paged_destroy ( void *c ) {
+	paged_release( c );
+	free( c );
+}
+
+static void
+paged_load ( void *c, const struct chip8 *start ) {
+	struct paged_lanes *p = c;
+
+	paged_release( p );
+	p->image = chip8_image_create( start );
+	if ( !p->image ) { fprintf( stderr, "out of memory\n" ); exit(EXIT_FAILURE); }
+	chip8_paged_load( &p->lanes[0], p->image, start );
+	for ( int l = 1; l < p->n; l++ ) { chip8_paged_fork( &p->lanes[l], &p->lanes[0] ); }
+}
+
+static void
+paged_key ( void *c, int lane, int key, int state ) {
+	struct paged_lanes *p = c;
+	chip8_paged_key_set_state( &p->lanes[lane], key, state );
+}
+
+static void
+paged_run ( void *c, unsigned long cycles ) {
+	struct paged_lanes *p = c;
+	for ( int l = 0; l < p->n; l++ ) {
+		unsigned long done = 0;
+		while ( done < cycles ) { done += chip8_paged_run_cycles( &p->lanes[l], cycles - done ); }
+	}
+}
+
+static void
+paged_tick ( void *c ) {
+	struct paged_lanes *p = c;
+	for ( int l = 0; l < p->n; l++ ) { chip8_paged_timer_tick( &p->lanes[l] ); }
+}
+
+static void
+paged_get ( void *c, int lane, struct chip8 *out ) {
+	struct paged_lanes *p = c;
+	chip8_paged_store( &p->lanes[lane], out );
+}
+
+/* SIMD lockstep batches */
+static void *
+batch_create ( const struct candidate *cand, int n ) {
+	return chip8_batch_create( n );
+}
+
+static void
+batch_destroy ( void *c ) {
+	chip8_batch_destroy( c );
+}
+
+static void
+batch_load ( void *c, const struct chip8 *start ) {
+	chip8_batch_load( c, start );
+}
+
+static void
+batch_key ( void *c, int lane, int key, int state ) {
+	chip8_batch_key_set_state( c, lane, key, state );
+}
+
+static void
+batch_run ( void *c, unsigned long cycles ) {
+	chip8_batch_run( c, cycles );
+}
+
+static void
+batch_tick ( void *c ) {
+	chip8_batch_tick( c );
+}
+
+static void
+batch_get ( void *c, int lane, struct chip8 *out ) {
+	chip8_batch_get( c, lane, out );
+}
+
+static const struct candidate paged_candidate = {
+	"paged", paged_create, paged_destroy, paged_load, paged_key, paged_run, paged_tick, paged_get, NULL
+};
+
+static const struct candidate lockstep_candidate = {
+	"lockstep", batch_create, batch_destroy, batch_load, batch_key, batch_run, batch_tick, batch_get, NULL
+};
+
+/* ---- cases ---- */
+
+struct rom {
+	const u8 *data;
+	size_t len;
+	int owned;  /* read from a file rather than mapped from a pack */
+};
+
+struct state {
+	struct candidate cand;
+	int lanes;
+	int frames;
+	int ipf;
+	int interval;
+	uint32_t seed;
+	unsigned long long first;
+	unsigned long long cases;
+	int nthreads;
+	int verbose;
+
+	struct rom *roms;
+	size_t nroms;
+	struct chip8_input *replay;
+
+	atomic_ullong next;
+	atomic_int failed;
+	atomic_ullong instructions;
+	pthread_mutex_t report;
+};
+
+/* what a worker needs to run one case */
+struct runner {
+	struct state *state;
+	void *cand;
+	struct chip8 ref[MAX_LANES];
+	struct chip8 out;
+	struct chip8 start;
+	u16 held[MAX_LANES];
+	size_t cursor;         /* next event of the replayed log */
+	int ipf;               /* instructions per frame of this case */
+	u8 rom[CHIP8_ROM_MAX];
+};
+
+static uint64_t
+mix ( uint64_t a, uint64_t b, uint64_t c, uint64_t d ) {
+	uint64_t key[4] = { a, b, c, d };
+	return fnv1a64( key, sizeof(key), FNV1A64_INIT );
+}
+
+/* a target inside the fragment most of the time, anywhere otherwise */
+static u16
+gen_addr ( uint64_t *r, int len ) {
+	*r = mix( *r, 1, 2, 3 );
+	if ( (*r & 7) != 0 ) { return CHIP8_ROM_START + 2 * ((*r >> 8) % len); }
+	return (*r >> 8) & CHIP8_ADDR_MASK;
+}
+
+/* a fragment of len instructions, biased towards valid ones */
+static size_t
+gen_fragment ( u8 *rom, uint64_t r, int len ) {
+	for ( int k = 0; k < len; k++ ) {
+		r = mix( r, k, 0, 0 );
+		u16 x = (r >> 8) & 0xF, y = (r >> 12) & 0xF, kk = (r >> 16) & 0xFF;
+		u16 opcode;
+
+		switch ( (r >> 24) % 24 ) {
+			case 0:  opcode = ((r >> 32) & 1)? 0x00E0 : 0x00EE; break;
+			case 1:  opcode = 0x1000 | gen_addr( &r, len ); break;
+			case 2:  opcode = 0x2000 | gen_addr( &r, len ); break;
+			case 3:  opcode = 0x3000 | (x << 8) | kk; break;
+			case 4:  opcode = 0x4000 | (x << 8) | kk; break;
+			case 5:  opcode = 0x5000 | (x << 8) | (y << 4); break;
+			case 6:
+			case 7:  opcode = 0x6000 | (x << 8) | kk; break;
+			case 8:
+			case 9:  opcode = 0x7000 | (x << 8) | kk; break;
+			case 10:
+			case 11: {
+				static const u8 alu[9] = { 0, 1, 2, 3, 4, 5, 6, 7, 0xE };
+				opcode = 0x8000 | (x << 8) | (y << 4) | alu[(r >> 32) % 9];
+				break;
+			}
+			case 12: opcode = 0x9000 | (x << 8) | (y << 4); break;
+			case 13: opcode = 0xA000 | gen_addr( &r, len ); break;
+			case 14: opcode = 0xB000 | gen_addr( &r, len ); break;
+			case 15: opcode = 0xC000 | (x << 8) | kk; break;
+			case 16:
+			case 17: opcode = 0xD000 | (x << 8) | (y << 4) | ((r >> 32) & 0xF); break;
+			case 18: opcode = 0xE000 | (x << 8) | (((r >> 32) & 1)? 0x9E : 0xA1); break;
+			case 19:
+			case 20:
+			case 21: {
+				static const u8 misc[9] = { 0x07, 0x0A, 0x15, 0x18, 0x1E, 0x29, 0x33, 0x55, 0x65 };
+				opcode = 0xF000 | (x << 8) | misc[(r >> 32) % 9];
+				break;
+			}
+			default: opcode = r >> 40; break;
+		}
+		rom[2 * k] = opcode >> 8;
+		rom[2 * k + 1] = opcode & 0xFF;
+	}
+	return 2 * (size_t) len;
+}
+
+static void
+put_op ( u8 *rom, size_t *len, u16 opcode ) {
+	rom[(*len)++] = opcode >> 8;
+	rom[(*len)++] = opcode & 0xFF;
+}
+
+/* code that rewrites itself after it has run: a subroutine of ALU
+   instructions is called, an LD B or LD [I] lands on the second byte of
+   one of them and it is called again, in a loop. catches translation
+   caches that miss writes to code they have already translated */
+static size_t
+gen_selfmod ( u8 *rom, uint64_t r ) {
+	size_t len = 0;
+	int n = 2 + (r >> 8) % 7;
+	u16 sub = CHIP8_ROM_START + 2;
+
+	put_op( rom, &len, 0x1000 | (sub + 2 * (n + 1)) );
+	for ( int k = 0; k < n; k++ ) {
+		r = mix( r, k, 1, 0 );
+		u16 x = (r >> 8) & 0xF, y = (r >> 12) & 0xF, kk = (r >> 16) & 0xFF;
+		switch ( (r >> 24) % 3 ) {
+			case 0:  put_op( rom, &len, 0x6000 | (x << 8) | kk ); break;
+			case 1:  put_op( rom, &len, 0x7000 | (x << 8) | kk ); break;
+			default: put_op( rom, &len, 0x8000 | (x << 8) | (y << 4) | ((r >> 32) % 5) ); break;
+		}
+	}
+	put_op( rom, &len, 0x00EE );
+
+	u16 loop = CHIP8_ROM_START + len;
+	r = mix( r, n, 2, 0 );
+	for ( int x = 0; x < 4; x++ ) { put_op( rom, &len, 0x6000 | (x << 8) | ((r >> (8 * x)) & 0xFF) ); }
+	put_op( rom, &len, 0x2000 | sub );
+	put_op( rom, &len, 0xA000 | (sub + 2 * ((r >> 32) % n) + 1) );
+	put_op( rom, &len, 0xF000 | (((r >> 40) & 3) << 8) | (((r >> 48) & 1)? 0x33 : 0x55) );
+	put_op( rom, &len, 0x2000 | sub );
+	put_op( rom, &len, 0x1000 | loop );
+	return len;
+}
+
+/* a long straight run of LD Vx, [I], the most native code per instruction
+   a translator emits, with now and then an LD [I], Vx to the data past the
+   code. every
+   pass jumps into the run two bytes further on with JP V0, so blocks keep
+   starting at new addresses and fill a translation cache's code buffer.
+   x stays below B, which counts the passes */
+static size_t
+gen_memrun ( u8 *rom, uint64_t r ) {
+	size_t len = 0;
+	int n = 192 + (r >> 8) % 300;
+	u16 body = CHIP8_ROM_START + 8;
+
+	put_op( rom, &len, 0x7B02 );
+	put_op( rom, &len, 0x80B0 );
+	put_op( rom, &len, 0xA800 | ((r >> 20) & 0x3FF) );
+	put_op( rom, &len, 0xB000 | body );
+	for ( int k = 0; k < n; k++ ) {
+		r = mix( r, k, 3, 0 );
+		u16 x = 4 + ((r >> 8) % 7);
+		put_op( rom, &len, 0xF000 | (x << 8) | (((r >> 16) % 32 == 0)? 0x55 : 0x65) );
+	}
+	put_op( rom, &len, 0x1000 | CHIP8_ROM_START );
+	return len;
+}
+
+/* the machine case id starts from */
+static int
+load_case ( struct runner *run, unsigned long long id ) {
+	struct state *state = run->state;
+
+	chip8_init( &run->start );
+	run->ipf = run->start.ipf = state->ipf;
+	chip8_seed( &run->start, mix( state->seed, id, 0, 1 ) );
+
+	if ( state->nroms == 0 ) {
+		uint64_t r = mix( state->seed, id, 0, 2 );
+		size_t len;
+		switch ( (r >> 56) % 8 ) {
+			case 0:  len = gen_selfmod( run->rom, r ); break;
+			case 1:
+				len = gen_memrun( run->rom, r );
+				if ( run->ipf < MEMRUN_IPF ) { run->ipf = run->start.ipf = MEMRUN_IPF; }
+				break;
+			default: len = gen_fragment( run->rom, r, 8 + (r >> 40) % 121 ); break;
+		}
+		return chip8_load_mem( &run->start, run->rom, len );
+	}
+
+	const struct rom *rom = &state->roms[id % state->nroms];
+	if ( !chip8_load_mem( &run->start, rom->data, rom->len ) ) { return 0; }
+	/* main checked the log was recorded with this rom */
+	if ( state->replay ) { chip8_seed( &run->start, state->replay->seed ); }
+	return 1;
+}
+
+/* keys held during frame of lane: the replayed log for lane 0 with -p,
+   otherwise mostly the keys of the previous frame and now and then one
+   key, several or none */
+static u16
+keys_for ( struct runner *run, unsigned long long id, int lane, int frame ) {
+	struct state *state = run->state;
+	u16 held = run->held[lane];
+
+	if ( state->replay && lane == 0 ) {
+		const struct chip8_input *log = state->replay;
+		while ( run->cursor < log->count && log->events[run->cursor].frame <= (uint32_t) frame ) {
+			const struct chip8_input_event *ev = &log->events[run->cursor++];
+			if ( ev->state == CHIP8_KEY_DOWN ) { held |= 1 << ev->key; } else { held &= ~(1 << ev->key); }
+		}
+		return held;
+	}
+
+	uint64_t r = mix( state->seed, id, lane, frame + 3 );
+	switch ( r & 7 ) {
+		case 0: return 0;
+		case 1: return 1 << ((r >> 8) & 0xF);
+		case 2: return r >> 16;
+		default: return held;
+	}
+}
+
+static void
+set_keys ( struct runner *run, unsigned long long id, int frame ) {
+	for ( int l = 0; l < run->state->lanes; l++ ) {
+		u16 keys = keys_for( run, id, l, frame );
+		u16 changed = keys ^ run->held[l];
+
+		for ( int k = 0; k < 16; k++ ) {
+			if ( !((changed >> k) & 1) ) { continue; }
+			int st = ((keys >> k) & 1)? CHIP8_KEY_DOWN : CHIP8_KEY_UP;
+			chip8_key_set_state( &run->ref[l], k, st );
+			run->state->cand.key( run->cand, l, k, st );
+		}
+		run->held[l] = keys;
+	}
+}
+
+static void
+restart ( struct runner *run ) {
+	for ( int l = 0; l < run->state->lanes; l++ ) {
+		run->ref[l] = run->start;
+		run->held[l] = 0;
+	}
+	run->cursor = 0;
+	run->state->cand.load( run->cand, &run->start );
+}
+
+static void
+ref_run ( struct runner *run, unsigned long cycles ) {
+	for ( int l = 0; l < run->state->lanes; l++ ) {
+		unsigned long done = 0;
+		while ( done < cycles ) { done += chip8_run_cycles( &run->ref[l], cycles - done ); }
+	}
+}
+
+static void
+ref_tick ( struct runner *run ) {
+	for ( int l = 0; l < run->state->lanes; l++ ) { chip8_timer_tick( &run->ref[l] ); }
+}
+
+/* describes the first difference between the reference and candidate,
+   returns 0 if there is none */
+static int
+diff ( const struct chip8 *ref, const struct chip8 *cand, char *buf, size_t len ) {
+	if ( ref->pc != cand->pc ) { return snprintf( buf, len, "pc 0x%03X != 0x%03X", ref->pc, cand->pc ); }
+	if ( ref->i != cand->i ) { return snprintf( buf, len, "I 0x%03X != 0x%03X", ref->i, cand->i ); }
+	for ( int k = 0; k < 16; k++ ) {
+		if ( ref->v[k] != cand->v[k] ) { return snprintf( buf, len, "V%X 0x%02X != 0x%02X", k, ref->v[k], cand->v[k] ); }
+	}
+	if ( ref->sp != cand->sp ) { return snprintf( buf, len, "SP %d != %d", ref->sp, cand->sp ); }
+	for ( int k = 0; k < 16; k++ ) {
+		if ( ref->stack[k] != cand->stack[k] ) {
+			return snprintf( buf, len, "stack[%d] 0x%03X != 0x%03X", k, ref->stack[k], cand->stack[k] );
+		}
+	}
+	if ( ref->dt != cand->dt ) { return snprintf( buf, len, "DT %d != %d", ref->dt, cand->dt ); }
+	if ( ref->st != cand->st ) { return snprintf( buf, len, "ST %d != %d", ref->st, cand->st ); }
+	if ( ref->rng != cand->rng ) { return snprintf( buf, len, "rng 0x%08X != 0x%08X", ref->rng, cand->rng ); }
+	for ( int a = 0; a < CHIP8_MEMORY_CAPACITY; a++ ) {
+		if ( ref->mem[a] != cand->mem[a] ) {
+			return snprintf( buf, len, "mem[0x%03X] 0x%02X != 0x%02X", a, ref->mem[a], cand->mem[a] );
+		}
+	}
+	for ( int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++ ) {
+		if ( ref->display[y] != cand->display[y] ) {
+			return snprintf( buf, len, "display row %d %016llX != %016llX", y,
+				(unsigned long long) ref->display[y], (unsigned long long) cand->display[y] );
+		}
+	}
+	return 0;
+}
+
+/* the first lane where the candidate differs from the reference, with the
+   difference in what, -1 if every lane matches */
+static int
+first_diff ( struct runner *run, char *what, size_t len ) {
+	for ( int l = 0; l < run->state->lanes; l++ ) {
+		run->state->cand.get( run->cand, l, &run->out );
+		if ( diff( &run->ref[l], &run->out, what, len ) ) { return l; }
+	}
+	return -1;
+}
+
+/* run case id again from the start with the budgets of the original run up
+   to frame, then cycles instructions into it. pc gets the address of the
+   last instruction each reference lane ran. returns first_diff */
+static int
+replay_to ( struct runner *run, unsigned long long id, int frame, int cycles,
+            u16 *pc, char *what, size_t len ) {
+	struct state *state = run->state;
+
+	restart( run );
+	for ( int f = 0; f < frame; f++ ) {
+		set_keys( run, id, f );
+		ref_run( run, run->ipf );
+		state->cand.run( run->cand, run->ipf );
+		ref_tick( run );
+		state->cand.tick( run->cand );
+	}
+	set_keys( run, id, frame );
+	ref_run( run, cycles - 1 );
+	for ( int l = 0; l < state->lanes; l++ ) { pc[l] = run->ref[l].pc; }
+	ref_run( run, 1 );
+	state->cand.run( run->cand, cycles );
+	return first_diff( run, what, len );
+}
+
+/* run case id again to find the first frame after good, the last one that
+   matched, where some lane differs. then bisect on the instructions run
+   into that frame, replaying from the start each time, so the candidate
+   always runs with the same budgets as when it diverged and a translated
+   block is not broken up into single steps */
+static void
+localize ( struct runner *run, unsigned long long id, int good ) {
+	struct state *state = run->state;
+	u16 pc[MAX_LANES];
+	char what[96];
+	int frame = -1, lane;
+
+	restart( run );
+	for ( int f = 0; f < state->frames; f++ ) {
+		set_keys( run, id, f );
+		ref_run( run, run->ipf );
+		state->cand.run( run->cand, run->ipf );
+		if ( f >= good && first_diff( run, what, sizeof(what) ) >= 0 ) { frame = f; break; }
+		ref_tick( run );
+		state->cand.tick( run->cand );
+		if ( f >= good && (lane = first_diff( run, what, sizeof(what) )) >= 0 ) {
+			fprintf( stdout, "case %llu lane %d frame %d: %s differs after the timer tick: %s\n",
+				id, lane, f, state->cand.name, what );
+			return;
+		}
+	}
+	if ( frame < 0 ) {
+		fprintf( stdout, "case %llu: hashes differed but replaying found no difference\n", id );
+		return;
+	}
+
+	/* the frame starts out matching and ends differing */
+	int lo = 0, hi = run->ipf;
+	while ( hi - lo > 1 ) {
+		int mid = lo + (hi - lo) / 2;
+		if ( replay_to( run, id, frame, mid, pc, what, sizeof(what) ) >= 0 ) { hi = mid; } else { lo = mid; }
+	}
+	lane = replay_to( run, id, frame, hi, pc, what, sizeof(what) );
+	if ( lane < 0 ) {
+		fprintf( stdout, "case %llu: hashes differed but replaying found no difference\n", id );
+		return;
+	}
+
+	/* the instruction just run, as the reference fetched it */
+	char text[CHIP8_DISASM_MAX];
+	u16 opcode = (run->ref[lane].mem[pc[lane]] << 8) | run->ref[lane].mem[(pc[lane] + 1) & CHIP8_ADDR_MASK];
+	fprintf( stdout, "case %llu lane %d frame %d instruction %d: %s differs after\n",
+		id, lane, frame, hi - 1, state->cand.name );
+	fprintf( stdout, "  0x%03X  %04X  %s\n", pc[lane], opcode, chip8_disasm( opcode, text, sizeof(text) ) );
+	fprintf( stdout, "  reference vs %s: %s\n", state->cand.name, what );
+	fprintf( stdout, "  repeat with -e %s -s %u -x %llu -n 1 -f %d -i %d -L %d\n",
+		state->cand.name, state->seed, id, state->frames, state->ipf, state->lanes );
+	fflush( stdout );
+}
+
+/* returns 0 once a case diverged */
+static int
+run_case ( struct runner *run, unsigned long long id ) {
+	struct state *state = run->state;
+	uint64_t rolling = FNV1A64_INIT;
+	int good = 0;
+
+	if ( !load_case( run, id ) ) {
+		fprintf( stderr, "case %llu: unable to load\n", id );
+		return 1;
+	}
+	restart( run );
+
+	for ( int f = 0; f < state->frames; f++ ) {
+		set_keys( run, id, f );
+		ref_run( run, run->ipf );
+		state->cand.run( run->cand, run->ipf );
+		ref_tick( run );
+		state->cand.tick( run->cand );
+
+		if ( (f + 1) % state->interval != 0 && f + 1 < state->frames ) { continue; }
+		for ( int l = 0; l < state->lanes; l++ ) {
+			uint64_t h = chip8_state_hash( &run->ref[l] );
+
+			state->cand.get( run->cand, l, &run->out );
+			if ( h != chip8_state_hash( &run->out ) ) {
+				pthread_mutex_lock( &state->report );
+				if ( !atomic_exchange( &state->failed, 1 ) ) { localize( run, id, good ); }
+				pthread_mutex_unlock( &state->report );
+				return 0;
+			}
+			rolling = hash64_words( &h, sizeof(h), rolling );
+		}
+		good = f + 1;
+	}
+
+	atomic_fetch_add( &state->instructions, (unsigned long long) state->frames * run->ipf * state->lanes );
+	if ( state->verbose ) {
+		pthread_mutex_lock( &state->report );
+		fprintf( stdout, "case %llu %016llX\n", id, (unsigned long long) rolling );
+		pthread_mutex_unlock( &state->report );
+	}
+	return 1;
+}
+
+static void *
+worker ( void *arg ) {
+	struct state *state = arg;
+	struct runner *run = calloc( 1, sizeof(struct runner) );
+	unsigned long long n;
+
+	if ( !run ) { fprintf( stderr, "out of memory\n" ); exit(EXIT_FAILURE); }
+	run->state = state;
+	run->cand = state->cand.create( &state->cand, state->lanes );
+	if ( !run->cand ) { fprintf( stderr, "out of memory\n" ); exit(EXIT_FAILURE); }
+
+	while ( !atomic_load( &state->failed ) &&
+	        (n = atomic_fetch_add( &state->next, 1 )) < state->cases ) {
+		if ( !run_case( run, state->first + n ) ) { break; }
+	}
+
+	state->cand.destroy( run->cand );
+	free( run );
+	return NULL;
+}
+
+static void
+usage ( const char *progname ) {
+	fprintf( stdout, "usage: %s -e ENGINE [-n CASES] [-x FIRST] [-f FRAMES] [-i IPF] [-k FRAMES] [-L LANES] [-j THREADS] [-s SEED] [-r PACK] [-p LOG] [-v] [ROM...]\n", progname );
+	fprintf( stdout, "  -e ENGINE   candidate to check against chip8_step:" );
+	for ( int e = 0; chip8_engines[e]; e++ ) { fprintf( stdout, " %s", chip8_engines[e]->name ); }
+	fprintf( stdout, " paged lockstep\n" );
+	fprintf( stdout, "  -n CASES    cases to run (default %d, or one per rom)\n", DEFAULT_CASES );
+	fprintf( stdout, "  -x FIRST    number of the first case (default 0)\n" );
+	fprintf( stdout, "  -f FRAMES   frames per case (default %d, or the length of the -p log)\n", DEFAULT_FRAMES );
+	fprintf( stdout, "  -i IPF      instructions per frame (default %d)\n", DEFAULT_IPF );
+	fprintf( stdout, "  -k FRAMES   frames between state comparisons (default 1)\n" );
+	fprintf( stdout, "  -L LANES    machines per case, each with its own keys (default 1, %d for lockstep)\n", DEFAULT_LANES );
+	fprintf( stdout, "  -j THREADS  worker threads (default: one per core)\n" );
+	fprintf( stdout, "  -s SEED     seed for generated fragments and keys (default 1)\n" );
+	fprintf( stdout, "  -r PACK     run the roms in PACK instead of generated fragments\n" );
+	fprintf( stdout, "  -p LOG      lane 0 replays an input log recorded by chip8 -r, one ROM only\n" );
+	fprintf( stdout, "  -v          print the rolling state hash of every case\n" );
+	fprintf( stdout, "  ROM         run ROM instead of generated fragments\n" );
+	exit(0);
+}
+
+static void
+add_rom ( struct state *state, const u8 *data, size_t len, int owned ) {
+	state->roms = realloc( state->roms, sizeof(struct rom) * (state->nroms + 1) );
+	if ( !state->roms ) { fprintf( stderr, "out of memory\n" ); exit(EXIT_FAILURE); }
+	state->roms[state->nroms].data = data;
+	state->roms[state->nroms].len = len;
+	state->roms[state->nroms++].owned = owned;
+}
+
+static void
+add_rom_file ( struct state *state, const char *path ) {
+	u8 *rom = malloc( CHIP8_ROM_MAX + 1 );
+	FILE *f = fopen( path, "rb" );
+
+	if ( !rom || !f ) { fprintf( stderr, "unable to open rom \"%s\"\n", path ); exit(EXIT_FAILURE); }
+	size_t len = fread( rom, 1, CHIP8_ROM_MAX + 1, f );
+	fclose(f);
+	if ( len > CHIP8_ROM_MAX ) { fprintf( stderr, "rom \"%s\" is too large\n", path ); exit(EXIT_FAILURE); }
+	add_rom( state, rom, len, 1 );
+}
+
+static double
+now ( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int
+main ( int argc, char *argv[] ) {
+	static struct state state;
+	const char *engine = NULL;
+	struct chip8_rompack *pack = NULL;
+	long long cases = -1;
+	int frames = -1;
+
+	state.ipf = DEFAULT_IPF;
+	state.interval = 1;
+	state.seed = 1;
+	state.nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	for ( int i = 1; i < argc; i++ ) {
+		if ( strcmp( "-e", argv[i] ) == 0 && i + 1 < argc ) {
+			engine = argv[++i];
+		} else if ( strcmp( "-n", argv[i] ) == 0 && i + 1 < argc ) {
+			cases = strtoll( argv[++i], NULL, 0 );
+		} else if ( strcmp( "-x", argv[i] ) == 0 && i + 1 < argc ) {
+			state.first = strtoull( argv[++i], NULL, 0 );
+		} else if ( strcmp( "-f", argv[i] ) == 0 && i + 1 < argc ) {
+			frames = atoi( argv[++i] );
+		} else if ( strcmp( "-i", argv[i] ) == 0 && i + 1 < argc ) {
+			state.ipf = atoi( argv[++i] );
+		} else if ( strcmp( "-k", argv[i] ) == 0 && i + 1 < argc ) {
+			state.interval = atoi( argv[++i] );
+		} else if ( strcmp( "-L", argv[i] ) == 0 && i + 1 < argc ) {
+			state.lanes = atoi( argv[++i] );
+		} else if ( strcmp( "-j", argv[i] ) == 0 && i + 1 < argc ) {
+			state.nthreads = atoi( argv[++i] );
+		} else if ( strcmp( "-s", argv[i] ) == 0 && i + 1 < argc ) {
+			state.seed = strtoul( argv[++i], NULL, 0 );
+		} else if ( strcmp( "-r", argv[i] ) == 0 && i + 1 < argc ) {
+			pack = chip8_rompack_open( argv[++i] );
+			if ( !pack ) { fprintf( stderr, "\"%s\" is not a rom pack\n", argv[i] ); return EXIT_FAILURE; }
+			for ( uint32_t r = 0; r < pack->count; r++ ) {
+				const u8 *rom;
+				size_t len;
+				chip8_rompack_rom( pack, r, &rom, &len );
+				add_rom( &state, rom, len, 0 );
+			}
+		} else if ( strcmp( "-p", argv[i] ) == 0 && i + 1 < argc ) {
+			state.replay = chip8_input_load( argv[++i] );
+			if ( !state.replay ) { fprintf( stderr, "unable to load input log \"%s\"\n", argv[i] ); return EXIT_FAILURE; }
+		} else if ( strcmp( "-v", argv[i] ) == 0 ) {
+			state.verbose = 1;
+		} else if ( strcmp( "-h", argv[i] ) == 0 ) {
+			usage(argv[0]);
+		} else {
+			add_rom_file( &state, argv[i] );
+		}
+	}
+
+	if ( !engine ) { usage(argv[0]); }
+	if ( strcmp( engine, "paged" ) == 0 ) {
+		state.cand = paged_candidate;
+	} else if ( strcmp( engine, "lockstep" ) == 0 ) {
+		state.cand = lockstep_candidate;
+		if ( state.lanes == 0 ) { state.lanes = DEFAULT_LANES; }
+	} else {
+		const struct chip8_engine *e = chip8_engine_find( engine );
+		if ( !e ) { fprintf( stderr, "unknown engine \"%s\"\n", engine ); return EXIT_FAILURE; }
+		state.cand = (struct candidate) {
+			e->name, engine_create, engine_destroy, engine_load, engine_key, engine_run, engine_tick, engine_get, e
+		};
+	}
+	if ( state.lanes == 0 ) { state.lanes = 1; }
+	if ( state.lanes < 1 || state.lanes > MAX_LANES || state.ipf < 1 || state.interval < 1 || state.nthreads < 1 ) {
+		usage(argv[0]);
+	}
+	if ( state.replay ) {
+		struct chip8 c8;
+
+		if ( state.nroms != 1 ) { fprintf( stderr, "-p replays a single ROM\n" ); return EXIT_FAILURE; }
+		chip8_init( &c8 );
+		if ( !chip8_load_mem( &c8, state.roms[0].data, state.roms[0].len ) ||
+		     !chip8_input_start( state.replay, &c8 ) ) {
+			fprintf( stderr, "input log was not recorded with this ROM\n" );
+			return EXIT_FAILURE;
+		}
+		state.ipf = state.replay->ipf;
+		if ( frames < 0 ) { frames = state.replay->frames; }
+	}
+	state.frames = (frames < 0)? DEFAULT_FRAMES : frames;
+	state.cases = (cases >= 0)? (unsigned long long) cases : (state.nroms? state.nroms : DEFAULT_CASES);
+	pthread_mutex_init( &state.report, NULL );
+
+	pthread_t *threads = malloc( sizeof(pthread_t) * state.nthreads );
+	if ( !threads ) { fprintf( stderr, "out of memory\n" ); return EXIT_FAILURE; }
+	double start = now();
+	for ( int t = 0; t < state.nthreads; t++ ) { pthread_create( &threads[t], NULL, worker, &state ); }
+	for ( int t = 0; t < state.nthreads; t++ ) { pthread_join( threads[t], NULL ); }
+	double elapsed = now() - start;
+
+	unsigned long long done = atomic_load( &state.next );
+	if ( done > state.cases ) { done = state.cases; }
+	unsigned long long instructions = atomic_load( &state.instructions );
+	fprintf( stderr, "%llu cases, %llu instructions in %.3fs on %d threads: %s %s chip8_step\n",
+		done, instructions, elapsed, state.nthreads, state.cand.name,
+		atomic_load( &state.failed )? "diverges from" : "matches" );
+
+	for ( size_t r = 0; r < state.nroms; r++ ) {
+		if ( state.roms[r].owned ) { free( (void *) state.roms[r].data ); }
+	}
+	if ( pack ) { chip8_rompack_close( pack ); }
+	free( state.roms );
+	free( threads );
+	if ( state.replay ) { chip8_input_destroy( state.replay ); }
+	return atomic_load( &state.failed )? EXIT_FAILURE : EXIT_SUCCESS;
+}